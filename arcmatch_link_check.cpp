@@ -0,0 +1,47 @@
+/*
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+RI is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Link check of the headers: compile.sh builds this file twice, with and
+ * without LINK_CHECK_MAIN, and links the two objects. A function defined in a
+ * header without inline then shows up as a multiple definition.
+ */
+
+#include "PreprocessorControl.h"
+
+#include "fr_textdb_driver.h"
+#include "query_list.h"
+
+#include "engine.h"
+#include "profile.h"
+#include "server_channel.h"
+#include "thread_pool.h"
+#include "timer.h"
+
+#ifdef LINK_CHECK_MAIN
+int main(int argc, char* argv[]){
+	return 0;
+}
+#endif
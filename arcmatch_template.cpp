@@ -69,11 +69,13 @@ RE|NRE  (reduce or not edge domains)				REDUCE_EDGES is on for RE
 //#define MAMA_NS //the real original order with node sets for flags
 //#define MAMA_NSL //the real original order with node sets for flags, with disjoint leafs at the end of the ordering
 //#define MAMA_CC //ordering by taking into account core compatibility
+//#define MAMA_CE //ordering by the estimated size of the search tree
 
 //#define SOLVER_0 //simple solver with edge domains
 //#define SOLVER_ED //simple solver which exploits edge domains
 //#define SOLVER_DP //solver with dynamic parent selection
 //#define SOLVER_LF //solver with dynamic parent selection and leafs
+//#define SOLVER_FF //solver with dynamic fail-first node selection
 
 //#define PATH_LENGTH 6
 //#define PATH_LENGTH 9
@@ -84,31 +86,20 @@ RE|NRE  (reduce or not edge domains)				REDUCE_EDGES is on for RE
 #include <string>
 #include <cstdlib>
 #include <ctime>
+#include <sstream>
+#include <vector>
 
 
 
 #include "fr_textdb_driver.h"
+#include "query_list.h"
+#include "server_channel.h"
+#include "thread_pool.h"
 #include "timer.h"
 
 
-#include "AttributeComparator.h"
-#include "Graph.h"
-#include "MatchingMachine.h"
-#include "MaMaConstrFirstDs.h"
-#include "MaMaConstrFirstEDs.h"
-#include "MaMaFloodCore.h"
-#include "MaMaAngularCoefficient.h"
-#include "MaMaConstrFirstNodeSets.h"
-#include "MaMaConstrFirstNodeSetsLeafs.h"
-#include "MaMaConstrFirstNSCC.h"
-
-
-#include "MatchListener.h"
-
-#include "Solver.h"
-#include "SubGISolver.h"
-#include "InducedSubGISolver.h"
-#include "Domains.h"
+#include "engine.h"
+#include "profile.h"
 
 /*#include <unordered_set>
 #include <tuple>
@@ -125,20 +116,33 @@ typedef std::unordered_set< std::pair<int,int>, pair_hash> unordered_edge_set;
 
 using namespace rilib;
 
-enum MATCH_TYPE {
-	MT_ISO,		//isomprhism
-	MT_INDSUB, //induced sub-isomorphism
-	MT_MONO		//monomorphism
+//run time options, given after the positional arguments
+struct DriverOptions : public MatchOptions {
+	int threads;		//nof worker threads matching the reference graphs (the queries in batch mode)
+	bool batch;			//the query argument is a directory or a list of query files
+	bool print_matches;	//print the found matches
+	std::string socket_path;	//server mode: listen on this Unix domain socket instead of stdin/stdout
+	DriverOptions(){
+		threads = 1;
+		batch = false;
+#ifdef PRINT_MATCHES
+		print_matches = true;
+#else
+		print_matches = false;
+#endif
+	}
 };
 
 void usage(char* args0);
-int match(MATCH_TYPE matchtype, GRAPH_FILE_TYPE filetype,	std::string& referencefile,	std::string& queryfile);
+bool parse_options(int argc, char* argv[], int first, DriverOptions& options);
+int match(MATCH_TYPE matchtype, GRAPH_FILE_TYPE filetype,	std::string& referencefile,	std::string& queryfile, DriverOptions& options);
+int match_batch(MATCH_TYPE matchtype, GRAPH_FILE_TYPE filetype, std::string& referencefile, std::string& querylist, DriverOptions& options);
+#ifndef _WIN32
+int serve(GRAPH_FILE_TYPE filetype, std::vector<std::string>& referencefiles, DriverOptions& options);
+#endif
 
 
 int main(int argc, char* argv[]){
-#ifdef PRINT_MATCHES
-	std::cout<<"DIRECTIVE PRINT_MATCHES is on\n";
-#endif
 
 	/*
 	unordered_edge_set* domains;
@@ -146,7 +150,29 @@ int main(int argc, char* argv[]){
 	domains[0].insert( std::pair<int,int>(0,1) );
 	*/
 
-	if(argc!=5){
+#ifndef _WIN32
+	//server mode: arcmatch serve format reference [reference ...] [options]
+	if(argc>=4 && std::string(argv[1])=="serve"){
+		GRAPH_FILE_TYPE filetype;
+		if(!parse_file_type(argv[2], filetype)){
+			usage(argv[0]);
+			return -1;
+		}
+		std::vector<std::string> references;
+		int ai = 3;
+		for(; ai<argc && argv[ai][0]!='-'; ai++){
+			references.push_back(argv[ai]);
+		}
+		DriverOptions options;
+		if(references.empty() || !parse_options(argc, argv, ai, options)){
+			usage(argv[0]);
+			return -1;
+		}
+		return serve(filetype, references, options);
+	}
+#endif
+
+	if(argc<5){
 			usage(argv[0]);
 			return -1;
 		}
@@ -156,58 +182,173 @@ int main(int argc, char* argv[]){
 	std::string reference;
 	std::string query;
 
-	std::string par = argv[1];
-	if(par=="iso"){
-		matchtype = MT_ISO;
-	}
-	else if(par=="ind"){
-		matchtype = MT_INDSUB;
-	}
-	else
-	if(par=="mono"){
-		matchtype = MT_MONO;
-	}
-	else{
+	if(!parse_match_type(argv[1], matchtype) || !parse_file_type(argv[2], filetype)){
 		usage(argv[0]);
 		return -1;
 	}
 
-	par = argv[2];
-	if(par=="gfu"){
-		filetype = GFT_GFU;		//undirected type
-	}
-	else if(par=="gfd"){
-		filetype = GFT_GFD;		//directed type
-	}
-	else if(par=="geu"){
-		filetype = GFT_EGFU;	//undirect type with labels on edges
-	}
-	else if(par=="ged"){
-		filetype = GFT_EGFD;	//direct type with labels on edges
-	}
-	//if no labels, domains are unuseful
-//	else if(par=="vfu"){
-//		filetype = GFT_VFU;
-//	}
-	else{
+	reference = argv[3];
+	query = argv[4];
+
+	DriverOptions options;
+	if(!parse_options(argc, argv, 5, options)){
 		usage(argv[0]);
 		return -1;
 	}
 
-	reference = argv[3];
-	query = argv[4];
+	if(options.batch)
+		return match_batch(matchtype, filetype, reference, query, options);
+	return match(matchtype, filetype, reference, query, options);
+};
 
-	return match(matchtype, filetype, reference, query);
+
+bool parse_options(int argc, char* argv[], int first, DriverOptions& options){
+	for(int i=first; i<argc; i++){
+		std::string par = argv[i];
+		if(par=="-index"){
+			options.use_index = true;
+		}
+		else if(par=="-paths" && i+1<argc){
+			options.path_length = atoi(argv[++i]);
+			if(options.path_length <= 0)
+				return false;
+			//graph offsets come from the summary index
+			options.use_index = true;
+		}
+		else if(par=="-config" && i+1<argc){
+			if(!options.strategy.set_config(atoi(argv[++i])))
+				return false;
+		}
+		else if(par=="-mama" && i+1<argc){
+			if(!parse_mama_kind(argv[++i], options.strategy.mama))
+				return false;
+		}
+		else if(par=="-solver" && i+1<argc){
+			if(!parse_solver_kind(argv[++i], options.strategy.solver))
+				return false;
+		}
+		else if(par=="-nodeconv" && i+1<argc){
+			options.strategy.node_d_conv = (atoi(argv[++i]) != 0);
+		}
+		else if(par=="-nlf"){
+			options.strategy.nlf = true;
+		}
+		else if(par=="-neighbours" && i+1<argc){
+			options.strategy.neighbour_rounds = atoi(argv[++i]);
+			if(options.strategy.neighbour_rounds < 0)
+				return false;
+		}
+		else if(par=="-edgeconv" && i+1<argc){
+			options.strategy.edge_d_conv = (atoi(argv[++i]) != 0);
+		}
+		else if(par=="-reduce" && i+1<argc){
+			options.strategy.reduce_path_length = atoi(argv[++i]);
+			if(options.strategy.reduce_path_length < 0)
+				return false;
+		}
+		else if(par=="-limit" && i+1<argc){
+			options.strategy.match_limit = atol(argv[++i]);
+			if(options.strategy.match_limit < 0)
+				return false;
+		}
+		else if(par=="-first"){
+			options.strategy.match_limit = 1;
+		}
+		else if(par=="-auto"){
+			options.strategy.auto_select = true;
+		}
+		else if(par=="-backjump"){
+			options.strategy.backjump = true;
+		}
+		else if(par=="-forward"){
+			options.strategy.forward = true;
+		}
+		else if(par=="-cache" && i+1<argc){
+			options.strategy.cache_mb = atoi(argv[++i]);
+			if(options.strategy.cache_mb < 0)
+				return false;
+		}
+		else if(par=="-probes" && i+1<argc){
+			options.strategy.probes = atoi(argv[++i]);
+			if(options.strategy.probes < 0)
+				return false;
+		}
+		else if(par=="-symmetry" && i+1<argc){
+			if(!parse_symmetry_mode(argv[++i], options.strategy.symmetry))
+				return false;
+		}
+		else if(par=="-profile" && i+1<argc){
+			int ret = read_profile(argv[++i], options.strategy);
+			if(ret != 0){
+				std::cout<<"unable to read the profile "<<argv[i];
+				if(ret > 0)
+					std::cout<<", bad line "<<ret;
+				std::cout<<"\n";
+				return false;
+			}
+		}
+		else if(par=="-print"){
+			options.print_matches = true;
+		}
+		else if(par=="-socket" && i+1<argc){
+			options.socket_path = argv[++i];
+		}
+		else if(par=="-batch"){
+			options.batch = true;
+		}
+		else if(par=="-threads" && i+1<argc){
+			options.threads = atoi(argv[++i]);
+			if(options.threads == 0)
+				options.threads = ThreadPool::hardware_threads();
+			if(options.threads < 0)
+				return false;
+		}
+		else{
+			std::cout<<"unknown option "<<par<<"\n";
+			return false;
+		}
+	}
+	return true;
 };
 
 
 
 
 
+void print_strategy(std::ostream& out, Strategy& strategy){
+	out<<"mama "<<mama_kind_name(strategy.mama)<<", solver "<<solver_kind_name(strategy.solver);
+	out<<", nodeconv "<<strategy.node_d_conv<<", edgeconv "<<strategy.edge_d_conv<<", reduce "<<strategy.reduce_path_length;
+	if(strategy.nlf)
+		out<<", nlf";
+	if(strategy.neighbour_rounds > 0)
+		out<<", neighbours "<<strategy.neighbour_rounds;
+	if(strategy.auto_select)
+		out<<", auto";
+	if(strategy.probes > 0)
+		out<<", probes "<<strategy.probes;
+	if(strategy.symmetry != SY_OFF)
+		out<<", symmetry "<<symmetry_mode_name(strategy.symmetry);
+	if(strategy.backjump)
+		out<<", backjump";
+	if(strategy.forward)
+		out<<", forward";
+	if(strategy.cache_mb > 0)
+		out<<", cache "<<strategy.cache_mb<<" MB";
+};
+
+
+//prints the matches on out if requested, otherwise they are just counted
+MatchListener* make_listener(DriverOptions& options, std::ostream& out){
+	if(options.print_matches)
+		return new ConsoleMatchListener(out);
+	return new EmptyMatchListener();
+};
+
+
 void usage(char* args0){
-	std::cout<<"usage "<<args0<<" [iso ind mono] [gfu gfd geu ged] reference query\n";
+	std::cout<<"usage "<<args0<<" [iso ind mono] [gfu gfd geu ged] reference query [options]\n";
 	std::cout<<"\tmatch type:\n";
-	std::cout<<"\t\tiso = isomorphism\n";
+	std::cout<<"\t\tiso = isomorphism, by colour refinement, without the ordering and solver options\n";
 	std::cout<<"\t\tind = induced subisomorphism\n";
 	std::cout<<"\t\tmono = monomorphism\n";
 	std::cout<<"\tgraph input format:\n";
@@ -217,7 +358,110 @@ void usage(char* args0){
 	std::cout<<"\t\tged = direct graphs with labels both on nodes and edges\n";
 	std::cout<<"\treference file contains one ormore reference graphs\n";
 	std::cout<<"\tquery contains the query graph (just one)\n";
+	std::cout<<"\toptions:\n";
+	std::cout<<"\t\t-index = skip reference graphs by a summary index stored in reference"<<DBINDEX_SUFFIX<<" (built if missing)\n";
+	std::cout<<"\t\t-paths k = preselect reference graphs by the labelled paths of at most k edges, indexed in reference"<<PATHINDEX_SUFFIX<<" (implies -index)\n";
+	std::cout<<"\t\t-batch = query is a directory of query files, or a file listing them one per line. The reference file is loaded once and each query is reported on its own\n";
+	std::cout<<"\t\t-threads n = match the reference graphs with n threads, 0 for one per hardware thread (default 1)\n";
+	std::cout<<"\t\t-print = print the found matches\n";
+	std::cout<<"\t\t-first = stop each reference graph at the first match, -limit n at the first n matches\n";
+	std::cout<<"\tmatching strategy options (defaults: the compile time selection, currently ";
+	Strategy defaults;
+	print_strategy(std::cout, defaults);
+	std::cout<<"):\n";
+	std::cout<<"\t\t-config n = one of the numbered configurations 1..16 of compile.sh\n";
+	std::cout<<"\t\t-mama [1 0 fc ac ns nsl cc ce nst] = matching machine (search order), ce minimises the estimated search\n";
+	std::cout<<"\t\t\ttree exactly up to 12 query nodes, by a beam search up to 512 (narrowed above 128) and greedily above\n";
+	std::cout<<"\t\t-solver [0 ed dp lf ff td cs] = search method, td counts the trees of nst by dynamic programming and cs\n";
+	std::cout<<"\t\t\tcounts the components left by the first states apart (mono only, the matches are enumerated with -print)\n";
+	std::cout<<"\t\t-nodeconv [0 1] = refine node domains until convergence\n";
+	std::cout<<"\t\t-nlf = remove the candidates with fewer neighbours of some node and edge label than the query node\n";
+	std::cout<<"\t\t-neighbours k = up to k rounds removing the candidates whose neighbours cannot hold distinct images of the\n";
+	std::cout<<"\t\t\tneighbours of the query node, 0 to skip. Pays off on graphs with high degrees and few labels\n";
+	std::cout<<"\t\t-edgeconv [0 1] = refine edge domains until convergence (with -reduce)\n";
+	std::cout<<"\t\t-reduce k = reduce edge domains by paths up to length k, 0 to skip\n";
+	std::cout<<"\t\t-auto = choose mama and solver for each reference graph by an estimate of the search cost\n";
+	std::cout<<"\t\t-probes n = choose the order for each reference graph by n random probes of the search tree of a few\n";
+	std::cout<<"\t\t\tcandidate orders, about 100 give stable choices, 0 to skip (not with the lf solver)\n";
+	std::cout<<"\t\t-symmetry [off emb distinct] = skip the embeddings equivalent by an automorphism of the query, and count\n";
+	std::cout<<"\t\t\tall the embeddings (emb) or one match per distinct subgraph (distinct). -print shows one embedding each\n";
+	std::cout<<"\t\t-backjump = when a state of the dp or td solver finds no match, jump back to the last state which took part\n";
+	std::cout<<"\t\t\tin the failure, skipping the other candidates of the states in between\n";
+	std::cout<<"\t\t-forward = after each assignment of the dp or td solver, count the candidates left to the later neighbours\n";
+	std::cout<<"\t\t\tand backtrack as soon as one has none. Pays off on queries with few matches\n";
+	std::cout<<"\t\t-cache mb = reuse the counts of the subtrees of the dp solver which depend on the same images, within mb MB\n";
+	std::cout<<"\t\t\tfor each reference graph (mono without -limit, 0 for none)\n";
+	std::cout<<"\t\t-profile file = strategy written by arcmatch-tune, later options override it\n";
+#ifndef _WIN32
+	std::cout<<"usage "<<args0<<" serve [gfu gfd geu ged] reference [reference ...] [options]\n";
+	std::cout<<"\tloads the references once and answers queries on stdin/stdout, or on a socket\n";
+	std::cout<<"\toptions: -index, -paths k as above, and\n";
+	std::cout<<"\t\t-socket path = listen on a Unix domain socket\n";
+	std::cout<<"\t\t-threads n = answer up to n MATCH requests concurrently, of any client. The answers to the requests\n";
+	std::cout<<"\t\t\tof a client are written in the order of the requests\n";
+	std::cout<<"\trequests (one line each, of at most 4096 bytes, answers end with a line starting with OK or ERR):\n";
+	std::cout<<"\t\tLIST = OK n, then a line \"id nof_graphs file\" per reference\n";
+	std::cout<<"\t\tMATCH [iso ind mono] reference_id nof_bytes [matches] [forward], followed by the query graph in nof_bytes bytes\n";
+	std::cout<<"\t\t\t= OK nof_matches search_space_size skipped_graphs, preceded by the matches if requested\n";
+	std::cout<<"\t\tQUIT = OK, then the connection is closed\n";
+#endif
+
+};
+
 
+void print_report(
+		std::ostream&	out,
+		std::string&	referencefile,
+		std::string&	queryfile,
+		MatchStats&		stats,
+		long			skippedgraphs,
+		DriverOptions&	options){
+	//timers are not active
+	double load_t=0;double load_t_q=0; double make_mama_t=0; double match_t=0; double total_t=0;
+
+#ifdef CSV_FORMAT
+	out<<referencefile<<"\t"<<queryfile<<"\t";
+	out<<load_t_q<<"\t"<<make_mama_t<<"\t"<<load_t<<"\t"<<match_t<<"\t"<<total_t<<"\t"<<stats.steps<<"\t"<<stats.triedcouples<<"\t"<<stats.matchedcouples<<"\t"<<stats.matchcount;
+#else
+	out<<"reference file: "<<referencefile<<"\n";
+	out<<"query file: "<<queryfile<<"\n";
+	out<<"reading time: "<<total_t<<"\n";
+	out<<"total time: "<<total_t<<"\n";
+	out<<"matching time: "<<match_t<<"\n";
+	out<<"number of found matches: "<<stats.matchcount<<"\n";
+	out<<"search space size: "<<stats.matchedcouples<<"\n";
+	if(options.use_index){
+		out<<"skipped reference graphs: "<<skippedgraphs<<"\n";
+	}
+#endif
+};
+
+
+//read the next reference graph to be matched, NULL if there are no more.
+//i counts the graphs already read
+Graph* next_reference(
+		std::string&		referencefile,
+		FileReader*			fd,
+		GRAPH_FILE_TYPE		filetype,
+		DBIndex*			dbindex,
+		std::vector<int>&	dbcandidates,
+		int&				i){
+	if(dbindex != NULL){
+		//jump to the next candidate graph
+		if(i == (int)dbcandidates.size())
+			return NULL;
+		fd->seek(dbindex->entries[dbcandidates[i]].offset);
+	}
+	else if(i > 0 && !fd->is_valid()){
+		return NULL;
+	}
+#ifdef MDEBUG
+	std::cout<<"reading reference...\n";
+#endif
+	Graph * rrg = new Graph();
+	read_dbgraph(referencefile.c_str(), fd, rrg, filetype);
+	i++;
+	return rrg;
 };
 
 
@@ -225,7 +469,8 @@ int match(
 		MATCH_TYPE 			matchtype,
 		GRAPH_FILE_TYPE 	filetype,
 		std::string& 		referencefile,
-		std::string& 	queryfile){
+		std::string& 	queryfile,
+		DriverOptions&	options){
 	bool doBijIso = (matchtype == MT_ISO);
 
 	//TIMEHANDLE load_s, load_s_q, make_mama_s, match_s, total_s, s_tmp;
@@ -238,26 +483,7 @@ int match(
 
 	AttributeComparator* nodeComparator;	//to compare node labels
 	AttributeComparator* edgeComparator;	//to compare edges labels
-	switch(filetype){
-		case GFT_GFU:
-		case GFT_GFD:
-			//for these formats, labels are only on nodes and they are strings
-			nodeComparator = new StringAttrComparator();
-			//nodeComparator = new DefaultAttrComparator();
-			edgeComparator = new DefaultAttrComparator();
-			break;
-		case GFT_EGFU:
-		case GFT_EGFD:
-			//labels both on nodes and edges
-			nodeComparator = new StringAttrComparator();
-			edgeComparator = new StringAttrComparator();
-			break;
-//		case GFT_VFU:
-//			//no labels
-//			nodeComparator = new DefaultAttrComparator();
-//			edgeComparator = new DefaultAttrComparator();
-//			break;
-	}
+	make_comparators(filetype, nodeComparator, edgeComparator);
 
 
 	//TIMEHANDLE tt_start;
@@ -275,6 +501,7 @@ int match(
 	if(rret !=0){
 		std::cout<<"error on reading query graph\n";
 	}
+	PreparedQuery prepared;
 
 #ifdef MDEBUG
 	query->print();
@@ -283,292 +510,384 @@ int match(
 	//delete dquery;
 	//load_t_q+=end_time(load_s_q);
 
-	long 	steps = 0,				//total number of steps of the backtracking phase
-			triedcouples = 0, 		//nof tried pair (query node, reference node)
-			matchcount = 0, 		//nof found matches
-			matchedcouples = 0;		//nof mathed pair (during partial solutions)
+	MatchStats stats;
 	long tsteps = 0, ttriedcouples = 0, tmatchedcouples = 0;
+	long skippedgraphs = 0;		//nof reference graphs discarded by the db index
+
+	DBIndex* dbindex = NULL;
+	std::vector<int> dbcandidates;	//ids of the reference graphs to be matched, when the index is used
+	if(options.use_index){
+		dbindex = open_dbindex(referencefile.c_str(), filetype, std::cout);
+		if(dbindex == NULL){
+			std::cout<<"unable to build the db index, scanning the whole reference file\n";
+		}
+	}
+	if(dbindex != NULL){
+		PathIndex* pathindex = open_references_pathindex(referencefile, filetype, dbindex, options, std::cout);
+		prepared.prepare(query, options);
+		skippedgraphs = select_candidates(prepared, dbindex, pathindex, doBijIso, dbcandidates);
+		delete pathindex;
+	}
+	else{
+		prepared.graph = query;
+	}
+	if(options.strategy.symmetry != SY_OFF)
+		prepared.prepare_symmetry(*nodeComparator, *edgeComparator);
+	QuerySymmetry* symmetry = prepared.symmetry;
 
 	FileReader *fd = open_file(referencefile.c_str(), filetype);
 	if(fd != NULL){
-#ifdef PRINT_MATCHES
-		//if you want to print found matches on screen
-		MatchListener* matchListener=new ConsoleMatchListener();
-#else
-		//do not print matches
-		MatchListener* matchListener=new EmptyMatchListener();
-#endif
-
 		int i=0;
-		bool rreaded = true;
-		do{	//for each reference graph in the file
-			//load_s=start_time();
-			Graph * rrg = new Graph();
-			//read the graph
-#ifdef MDEBUG
-	std::cout<<"reading reference...\n";
-#endif
-			int rret = read_dbgraph(referencefile.c_str(), fd, rrg, filetype);
-			//rreaded = fd->is_valid();
-			rreaded = true;
-			//load_t+=end_time(load_s);
-
-
-			if(rreaded){
-
-				if(!doBijIso ||
-					(doBijIso && (query->nof_nodes == rrg->nof_nodes))){
-
-					//initialize domains
-					sbitset *domains = new sbitset[query->nof_nodes];
-					//match_s=start_time();
-
-					std::cout<<"initializing domain...\n";
-
-					//s_tmp = start_time();
-					bool domok = init_domains(*rrg, *query, *nodeComparator, *edgeComparator, domains, doBijIso);
-					//t_tmp = end_time(s_tmp);
-					//std::cout<<":time: init domains "<<t_tmp<<"\n";
-
-					//match_t+=end_time(match_s);
-
-					//if domain constraints are satisfied (at least one compatible target node for each query node)
-					if(domok){
-						std::cout<<"domain ok\n";
-						std::cout<<"initializing edge domain...\n";
-
-						//match_s=start_time();
-
-						EdgeDomains edomains;
-						std::cout<<"edomain init\n";
-
-						//s_tmp = start_time();
-						init_edomains(*rrg, *query, domains, *edgeComparator, edomains);
-						//t_tmp = end_time(s_tmp);
-						//std::cout<<":time: init edomains "<<t_tmp<<"\n";
-
-#ifdef MDEBUG
-						print_domains(*query, *rrg, domains,edomains);
-#endif
-
-						//s_tmp = start_time();
-
-#ifdef REDUCE_EDGES
-						DomainReduction dr(*query, domains, edomains, rrg->nof_nodes);
-						std::cout<<"edomain reduction\n";
-						dr.reduce_by_paths(PATH_LENGTH);
-						//dr.reduce_by_paths(query->nof_nodes+1);
-						std::cout<<"edomain refinement\n";
-						dr.final_refinement();
-						std::cout<<"edomain done\n";
-#endif
+		Graph* rrg;
+		if(options.threads <= 1){
+			MatchListener* matchListener=make_listener(options, std::cout);
+			//scratch memory, reused for every reference graph
+			Arena arena;
+			//for each reference graph in the file
+			while((rrg = next_reference(referencefile, fd, filetype, dbindex, dbcandidates, i)) != NULL){
+				match_reference(matchtype, options.strategy, query, rrg, nodeComparator, edgeComparator, matchListener, &arena, std::cout, stats, symmetry);
+				delete rrg;
+			}
+			delete matchListener;
+		}
+		else{
+			//reference graphs are read in file order by this thread and matched in batches by the pool.
+			//each graph has its own output buffer, flushed in file order once the batch is done
+			ThreadPool pool(options.threads);
+			int batchsize = 8 * pool.size();
+			//one scratch arena for each slot of the batch
+			Arena* arenas = new Arena[batchsize];
+			std::vector<Graph*> batch;
+			bool readall = false;
+			while(!readall){
+				batch.clear();
+				while((int)batch.size() < batchsize){
+					if((rrg = next_reference(referencefile, fd, filetype, dbindex, dbcandidates, i)) == NULL){
+						readall = true;
+						break;
+					}
+					batch.push_back(rrg);
+				}
 
-						//t_tmp = end_time(s_tmp);
-						//std::cout<<":time: reduce edomains "<<t_tmp<<"\n";
+				std::ostringstream* bouts = new std::ostringstream[batch.size()];
+				MatchStats* bstats = new MatchStats[batch.size()];
+				for(size_t bi=0; bi<batch.size(); bi++){
+					Graph* brg = batch[bi];
+					std::ostringstream* bout = &bouts[bi];
+					MatchStats* bstat = &bstats[bi];
+					Arena* barena = &arenas[bi];
+					DriverOptions* boptions = &options;
+					pool.submit([=](){
+						MatchListener* matchListener=make_listener(*boptions, *bout);
+						match_reference(matchtype, boptions->strategy, query, brg, nodeComparator, edgeComparator, matchListener, barena, *bout, *bstat, symmetry);
+						delete matchListener;
+						delete brg;
+					});
+				}
+				pool.wait();
 
-						//match_t+=end_time(match_s);
+				for(size_t bi=0; bi<batch.size(); bi++){
+					std::cout<<bouts[bi].str();
+					stats.add(bstats[bi]);
+				}
+				delete[] bouts;
+				delete[] bstats;
+			}
+			delete[] arenas;
+		}
 
 #ifdef MDEBUG
-						print_domains(*query, *rrg, domains,edomains);
+	std::cout<<"all done\n";
 #endif
 
-						//std::cout<<"building matching machine...\n";
-
-						//just get the domain size for each query node
-						int *domains_size = new int[query->nof_nodes];
-						int dsize;
-						for(int ii=0; ii<query->nof_nodes; ii++){
-							dsize = 0;
-							for(sbitset::iterator IT = domains[ii].first_ones(); IT!=domains[ii].end(); IT.next_ones()){
-								dsize++;
-							}
-							domains_size[ii] = dsize;
-
-							/*std::cout<<"dsize["<<ii<<"]("<<domains_size[ii]<<")\n";
-							domains[ii].print_numbers();
-							std::cout<<"\n";
-							*/
-						}
-
-						//for(int ii=0; ii<query->nof_nodes; ii++){
-						//	std::cout<<ii<<" "<<query->out_adj_sizes[ii]<<" "<<domains_size[ii]<<"\n";
-						//}
-
-
-						//build the static matching machine
-						//make_mama_s=start_time();
-						
-						//MatchingMachine* mama = new MaMaConstrFirstDs(*query, domains, domains_size);
-						#ifdef MAMA_1
-						MatchingMachine* mama = new MaMaConstrFirstDs(*query, domains, domains_size);
-						#endif
-
-						#ifdef MAMA_0
-						MatchingMachine* mama = new MaMaConstrFirstEDs(*query, domains, domains_size, edomains);
-						#endif
-
-						#ifdef MAMA_FC
-						MatchingMachine* mama = new MaMaFloodCore(*query, domains, domains_size, edomains, query->nof_nodes);
-						#endif
-						
-						#ifdef MAMA_AC
-						MatchingMachine* mama = new MaMaAngularCoefficient(*query, domains, domains_size, edomains);
-						#endif
-
-						#ifdef MAMA_NS
-						MatchingMachine* mama = new MaMaConstrFirstNodeSets(*query, domains, domains_size);
-						#endif
-
-						#ifdef MAMA_NSL
-						MatchingMachine* mama = new MaMaConstrFirstNodeSetsLeafs(*query, domains, domains_size);
-						#endif
-
-						#ifdef MAMA_CC
-						MatchingMachine* mama = new MaMaConstrFirstNSCC(*query, domains, domains_size, *nodeComparator, *edgeComparator);
-						#endif
-
-
-						//std::cout<<"build mm\n";
-						mama->build(*query);
-						//std::cout<<"fix edis mm\n";
-						mama->fix_eids(*query);
-						//make_mama_t+=end_time(make_mama_s);
-						//std::cout<<"done\n";
-
-						//t_tmp = end_time(make_mama_s);
-						std::cout<<":time: make mama "<<t_tmp<<"\n";
-
-						std::cout<<"ordering: ";
-						for(int ii=0; ii<mama->nof_sn; ii++){
-							std::cout<<mama->map_state_to_node[ii]<<"("<<domains_size[mama->map_state_to_node[ii]]<<") ";
-						}
-						std::cout<<"\n";
-						std::cout<<"domain sizes: ";
-						for(int ii=0; ii<mama->nof_sn; ii++){
-							std::cout<<ii<<"["<<domains_size[ii]<<"] ";
-						}
-						std::cout<<"\n";
-
-#ifdef MDEBUG
-						mama->print();
-						print_domains(*query, *rrg, domains,edomains);
-						print_domains_extended(*query, *rrg, domains,edomains);
-#endif
+		fd->close();
+		delete fd;
+		delete dbindex;
+	}
+	else{
+		std::cout<<"unable to open reference file\n";
+		return -1;
+	}
 
-#ifdef MDEBUG
-	mama->print();
-#endif
+	print_report(std::cout, referencefile, queryfile, stats, skippedgraphs, options);
 
-						///match_s=start_time();
+	delete nodeComparator;
+	delete edgeComparator;
 
-#ifdef MDEBUG
-	std::cout<<"solving...\n";
-#endif
-						//prepare the matching phase
-						Solver* solver;
-						switch(matchtype){
-						case MT_MONO:
-							solver = new SubGISolver(*mama, *rrg, *query, *nodeComparator, *edgeComparator, *matchListener, domains, domains_size, edomains);
-							break;
-						case MT_ISO:  //a specialized solver for this will be better
-						case MT_INDSUB:
-							solver = new InducedSubGISolver(*mama, *rrg, *query, *nodeComparator, *edgeComparator, *matchListener, domains, domains_size, edomains);
-							break;
-						}
+	return 0;
+};
 
-						//run the matching phase
-						//std::cout<<"solving...\n";
 
 
-						//s_tmp = start_time();
+//match one query of a batch, the report goes to out
+void match_batch_query(
+		MATCH_TYPE 				matchtype,
+		std::string& 			queryfile,
+		Engine&					engine,
+		DriverOptions&			options,
+		std::ostream&			out,
+		MatchStats&				stats){
+	PreparedQuery query;
+	if(engine.prepare_file(queryfile.c_str(), query) != 0){
+		out<<"error on reading query graph "<<queryfile<<"\n";
+		return;
+	}
 
-						
-						#ifdef SOLVER_0
-						solver->solve();
-						#endif
+	MatchListener* matchListener=make_listener(options, out);
+	Session session;
+	session.log = &out;
+	long skippedgraphs = engine.match(session, query, 0, matchtype, *matchListener, stats);
+	delete matchListener;
 
-						#ifdef SOLVER_ED
-						solver->SolveEd();
-						#endif
+	print_report(out, engine.reference(0).file, queryfile, stats, skippedgraphs, options);
+};
 
-						#ifdef SOLVER_DP
-						solver->solve_rp();
-						#endif
 
-						#ifdef SOLVER_LF
-						solver->SolveLeafs();
-						#endif
+int match_batch(
+		MATCH_TYPE 			matchtype,
+		GRAPH_FILE_TYPE 	filetype,
+		std::string& 		referencefile,
+		std::string& 		querylist,
+		DriverOptions&		options){
+	std::vector<std::string> queryfiles;
+	if(read_query_list(querylist.c_str(), queryfiles) != 0){
+		std::cout<<"unable to read the query list "<<querylist<<"\n";
+		return -1;
+	}
 
+	//the reference graphs, and their indexes, are loaded once for all the queries
+	Engine engine(filetype, options);
+	if(engine.load_reference(referencefile, std::cout) < 0){
+		std::cout<<"unable to open reference file\n";
+		return -1;
+	}
 
-						//t_tmp = end_time(s_tmp);
-						//std::cout<<":time: solve "<<t_tmp<<"\n";
+	int nof_queries = (int)queryfiles.size();
+	MatchStats* qstats = new MatchStats[nof_queries];
+	if(options.threads <= 1){
+		for(int qi=0; qi<nof_queries; qi++){
+			match_batch_query(matchtype, queryfiles[qi], engine, options, std::cout, qstats[qi]);
+		}
+	}
+	else{
+		//queries run concurrently on the shared reference graphs, reports are printed in list order
+		std::ostringstream* qouts = new std::ostringstream[nof_queries];
+		ThreadPool pool(options.threads);
+		for(int qi=0; qi<nof_queries; qi++){
+			std::string* queryfile = &queryfiles[qi];
+			std::ostringstream* qout = &qouts[qi];
+			MatchStats* qstat = &qstats[qi];
+			pool.submit([&, queryfile, qout, qstat](){
+				match_batch_query(matchtype, *queryfile, engine, options, *qout, *qstat);
+			});
+		}
+		pool.wait();
+		for(int qi=0; qi<nof_queries; qi++){
+			std::cout<<qouts[qi].str();
+		}
+		delete[] qouts;
+	}
 
+	MatchStats stats;
+	for(int qi=0; qi<nof_queries; qi++){
+		stats.add(qstats[qi]);
+	}
+	std::cout<<"number of queries: "<<nof_queries<<"\n";
+	std::cout<<"total number of found matches: "<<stats.matchcount<<"\n";
+	std::cout<<"total search space size: "<<stats.matchedcouples<<"\n";
 
+	delete[] qstats;
 
-						//std::cout<<"done\n";
+	return 0;
+};
 
-						//match_t+=end_time(match_s);
 
-						steps += solver->steps;
-						triedcouples += solver->triedcouples;
-						matchedcouples += solver->matchedcouples;
+#ifndef _WIN32
+//a MATCH request, answered by a worker of the pool
+struct MatchRequest{
+	long slot;			//of the answer in the replies of the client
+	std::string type;
+	int ref;
+	bool matches;
+	Strategy strategy;
+	std::string payload;
+};
 
-						matchcount += solver->matchcount;
+void answer_match(MatchRequest* req, Engine& engine, Replies& replies){
+	std::ostringstream out;
+	MATCH_TYPE matchtype;
+	PreparedQuery query;
+	if(!parse_match_type(req->type, matchtype)){
+		out<<"ERR unknown match type "<<req->type<<"\n";
+	}
+	else if(req->ref < 0 || req->ref >= engine.nof_references()){
+		out<<"ERR unknown reference "<<req->ref<<"\n";
+	}
+	else if(engine.prepare_buffer(req->payload.data(), (long)req->payload.size(), query) != 0){
+		out<<"ERR unable to read the query graph\n";
+	}
+	else{
+		Session session;		//the matching log is not sent to clients
+		//matches, if requested, are streamed before the final counts
+		MatchListener* matchListener;
+		if(req->matches)
+			matchListener = new ConsoleMatchListener(out);
+		else
+			matchListener = new EmptyMatchListener();
+		MatchStats stats;
+		long skippedgraphs = engine.match(session, query, req->ref, matchtype, req->strategy, *matchListener, stats);
+		delete matchListener;
+		out<<"OK "<<stats.matchcount<<" "<<stats.matchedcouples<<" "<<skippedgraphs<<"\n";
+	}
+	std::string text = out.str();
+	replies.answer(req->slot, text);
+	delete req;
+};
 
-						delete solver;
-						delete mama;
-#ifdef MDEBUG
-	std::cout<<"done\n";
-#endif
-					}
-				}
-//				delete rrg;
-				//ReferenceGRaph destroyer is not yet developed...
+//answer the requests of one client until it quits or hangs up, see usage() for the protocol.
+//MATCH requests run on the workers of pool, the answers are written in the order of the requests
+void serve_channel(Channel& ch, Engine& engine, ThreadPool& pool){
+	Replies replies(ch);
+	std::string line, text;
+	int ret;
+	while((ret = ch.read_line(line)) != 0){
+		if(ret < 0){
+			//the stream cannot be resynchronized
+			std::ostringstream out;
+			out<<"ERR request line longer than "<<MAX_LINE_BYTES<<" bytes\n";
+			text = out.str();
+			replies.answer(replies.reserve(), text);
+			break;
+		}
+		std::istringstream request(line);
+		std::string cmd;
+		request>>cmd;
+		if(cmd.empty()){
+			continue;
+		}
+		std::ostringstream out;
+		long slot = replies.reserve();
+		if(cmd=="LIST"){
+			out<<"OK "<<engine.nof_references()<<"\n";
+			for(int ri=0; ri<engine.nof_references(); ri++){
+				out<<ri<<" "<<engine.reference(ri).graphs.size()<<" "<<engine.reference(ri).file<<"\n";
 			}
-			i++;
-
-			
-		//}while(rreaded);
-		}while( fd->is_valid());
-
-#ifdef MDEBUG
-	std::cout<<"all done\n";
-#endif
+		}
+		else if(cmd=="MATCH"){
+			MatchRequest* req = new MatchRequest();
+			std::string flag;
+			long size = -1;
+			req->slot = slot;
+			req->ref = -1;
+			req->matches = false;
+			req->strategy = engine.options.strategy;
+			request>>req->type>>req->ref>>size;
+			//forward checking can be asked for each query
+			while(request>>flag){
+				if(flag=="matches")
+					req->matches = true;
+				else if(flag=="forward")
+					req->strategy.forward = true;
+			}
+			if(size > (long)MAX_PAYLOAD_BYTES){
+				//the stream cannot be resynchronized
+				delete req;
+				out<<"ERR query graph larger than "<<MAX_PAYLOAD_BYTES<<" bytes\n";
+				text = out.str();
+				replies.answer(slot, text);
+				break;
+			}
+			if(size < 0 || !ch.read_bytes(size, req->payload)){
+				//the stream cannot be resynchronized
+				delete req;
+				out<<"ERR missing query graph\n";
+				text = out.str();
+				replies.answer(slot, text);
+				break;
+			}
+			pool.submit([req, &engine, &replies](){ answer_match(req, engine, replies); });
+			continue;
+		}
+		else if(cmd=="QUIT"){
+			text = "OK\n";
+			replies.answer(slot, text);
+			break;
+		}
+		else{
+			out<<"ERR unknown command "<<cmd<<"\n";
+		}
+		text = out.str();
+		replies.answer(slot, text);
+	}
+	//the running matches write to the channel
+	replies.wait();
+};
 
-		//if(matchListener != NULL)
-		//matchcount += matchListener->matchcount;
 
-		delete matchListener;
+int serve(
+		GRAPH_FILE_TYPE 			filetype,
+		std::vector<std::string>&	referencefiles,
+		DriverOptions&				options){
+	//stdout may be the protocol channel, the server log goes to stderr
+	Engine engine(filetype, options);
+	for(size_t ri=0; ri<referencefiles.size(); ri++){
+		int ref = engine.load_reference(referencefiles[ri], std::cerr);
+		if(ref < 0){
+			std::cerr<<"unable to open reference file "<<referencefiles[ri]<<"\n";
+			return -1;
+		}
+		std::cerr<<"reference "<<ref<<": "<<referencefiles[ri]<<" ("<<engine.reference(ref).graphs.size()<<" graphs)\n";
+	}
 
-		fd->close();
+	ignore_sigpipe();
+	int ret = 0;
+	//the MATCH requests of all the clients are answered by -threads workers
+	ThreadPool pool(options.threads);
+	if(options.socket_path.empty()){
+		Channel ch(0, 1);
+		serve_channel(ch, engine, pool);
 	}
 	else{
-		std::cout<<"unable to open reference file\n";
-		return -1;
+		int sfd = listen_unix_socket(options.socket_path.c_str(), 64);
+		if(sfd < 0){
+			ret = -1;
+		}
+		else{
+			std::cerr<<"listening on "<<options.socket_path<<"\n";
+			//each connection is read by its own thread, which only parses the requests
+			std::mutex conn_mtx;
+			std::condition_variable conn_cv;
+			int nof_conns = 0;
+			while(true){
+				int cfd = accept(sfd, NULL, NULL);
+				if(cfd < 0){
+					if(errno == EINTR)
+						continue;
+					perror("accept");
+					ret = -1;
+					break;
+				}
+				{
+					std::unique_lock<std::mutex> lock(conn_mtx);
+					nof_conns++;
+				}
+				std::thread([cfd, &engine, &pool, &conn_mtx, &conn_cv, &nof_conns](){
+					{
+						Channel ch(cfd, cfd);
+						serve_channel(ch, engine, pool);
+					}
+					close(cfd);
+					std::unique_lock<std::mutex> lock(conn_mtx);
+					nof_conns--;
+					conn_cv.notify_all();
+				}).detach();
+			}
+			std::unique_lock<std::mutex> lock(conn_mtx);
+			conn_cv.wait(lock, [&nof_conns](){ return nof_conns == 0; });
+			close(sfd);
+		}
 	}
 
-	//total_t=end_time(total_s);
-
-#ifdef CSV_FORMAT
-	std::cout<<referencefile<<"\t"<<queryfile<<"\t";
-	std:cout<<load_t_q<<"\t"<<make_mama_t<<"\t"<<load_t<<"\t"<<match_t<<"\t"<<total_t<<"\t"<<steps<<"\t"<<triedcouples<<"\t"<<matchedcouples<<"\t"<<matchcount;
-#else
-	std::cout<<"reference file: "<<referencefile<<"\n";
-	std::cout<<"query file: "<<queryfile<<"\n";
-	std::cout<<"reading time: "<<total_t<<"\n";
-	std::cout<<"total time: "<<total_t<<"\n";
-	std::cout<<"matching time: "<<match_t<<"\n";
-	std::cout<<"number of found matches: "<<matchcount<<"\n";
-	std::cout<<"search space size: "<<matchedcouples<<"\n";
-#endif
-
-	delete nodeComparator;
-	delete edgeComparator;
-
-	return 0;
+	return ret;
 };
-
-
-
-
-
+#endif
@@ -0,0 +1,345 @@
+/*
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+RI is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * arcmatch-tune: times the strategies selectable at run time (matching machine,
+ * solver, domain convergence, edge domain reduction) on a sample of queries
+ * against one reference file, and writes the fastest one to a profile that
+ * arcmatch loads by -profile.
+ */
+
+#include "PreprocessorControl.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+#include <chrono>
+
+
+#include "fr_textdb_driver.h"
+#include "query_list.h"
+
+
+#include "engine.h"
+#include "profile.h"
+
+
+using namespace rilib;
+
+struct TuneOptions {
+	std::string profile;		//output profile
+	int reps;					//runs of each query, the fastest one is taken
+	double slack;				//a strategy is dropped once its time exceeds slack times the best one
+	std::vector<int> reduce_lengths;	//path lengths of the edge domain reduction to try, 0 for no reduction
+	bool all_solvers;			//also try the 0 and ed solvers
+	TuneOptions(){
+		profile = "arcmatch.profile";
+		reps = 3;
+		slack = 1.2;
+		all_solvers = false;
+		reduce_lengths.push_back(0);
+		reduce_lengths.push_back(PATH_LENGTH);
+	}
+};
+
+
+void usage(char* args0){
+	TuneOptions defaults;
+	std::cout<<"usage "<<args0<<" [iso ind mono] [gfu gfd geu ged] reference queries [options]\n";
+	std::cout<<"\ttimes the strategies of arcmatch on the queries and writes the fastest one to a profile\n";
+	std::cout<<"\tqueries: a directory of query files, or a file listing one query file per line\n";
+	std::cout<<"\toptions:\n";
+	std::cout<<"\t\t-o file = profile to write (default "<<defaults.profile<<")\n";
+	std::cout<<"\t\t-reps n = runs of each query, the fastest one is taken (default "<<defaults.reps<<")\n";
+	std::cout<<"\t\t-slack f = drop a strategy once its time exceeds f times the best one (default "<<defaults.slack<<")\n";
+	std::cout<<"\t\t-reduce k,k,... = path lengths of the edge domain reduction to try, 0 for none (default 0,"<<PATH_LENGTH<<")\n";
+	std::cout<<"\t\t-all = also try the 0 and ed solvers, which do not check every query edge on all graphs\n";
+	std::cout<<"\tstrategies whose counts differ from the 1/dp ones on any query are dropped, also the auto selection,\n";
+	std::cout<<"\tthe leaf solver is only tried for mono\n";
+};
+
+
+bool parse_options(int argc, char* argv[], int first, TuneOptions& options){
+	for(int i=first; i<argc; i++){
+		std::string par = argv[i];
+		if(par=="-o" && i+1<argc){
+			options.profile = argv[++i];
+		}
+		else if(par=="-reps" && i+1<argc){
+			options.reps = atoi(argv[++i]);
+			if(options.reps <= 0)
+				return false;
+		}
+		else if(par=="-slack" && i+1<argc){
+			options.slack = atof(argv[++i]);
+			if(options.slack < 1)
+				return false;
+		}
+		else if(par=="-all"){
+			options.all_solvers = true;
+		}
+		else if(par=="-reduce" && i+1<argc){
+			options.reduce_lengths.clear();
+			std::istringstream lengths(argv[++i]);
+			std::string length;
+			while(std::getline(lengths, length, ',')){
+				int k = atoi(length.c_str());
+				if(k < 0)
+					return false;
+				options.reduce_lengths.push_back(k);
+			}
+			if(options.reduce_lengths.empty())
+				return false;
+		}
+		else{
+			return false;
+		}
+	}
+	return true;
+};
+
+
+//the strategies to time, the first one (1/dp, no refinement) gives the expected counts
+void enumerate_strategies(MATCH_TYPE matchtype, TuneOptions& options, std::vector<Strategy>& strategies){
+	Strategy s;
+	s.match_limit = 0;
+	s.auto_select = false;
+	s.mama = MK_1;
+	s.solver = SK_DP;
+	s.node_d_conv = false;
+	s.edge_d_conv = false;
+	s.reduce_path_length = 0;
+	strategies.push_back(s);
+
+	for(int mama=MK_1; mama<=MK_NST; mama++){
+		for(int solver=SK_0; solver<=SK_CS; solver++){
+			//leafs are only solved apart by nsl, and the leaf solver does not check induced constraints among leafs
+			if(solver==SK_LF && (mama!=MK_NSL || matchtype!=MT_MONO))
+				continue;
+			//trees are only counted apart with nst, for monomorphism
+			if(solver==SK_TD && (mama!=MK_NST || matchtype!=MT_MONO))
+				continue;
+			//components are not independent under the induced constraints
+			if(solver==SK_CS && matchtype!=MT_MONO)
+				continue;
+			//the fail-first solver does not follow the mama
+			if(solver==SK_FF && mama!=MK_1)
+				continue;
+			//a sample cannot prove them right, they only check the edges of the search tree on some graphs
+			if((solver==SK_0 || solver==SK_ED) && !options.all_solvers)
+				continue;
+			for(int nodeconv=0; nodeconv<2; nodeconv++){
+				for(size_t ri=0; ri<options.reduce_lengths.size(); ri++){
+					//edge domain convergence is part of the reduction
+					for(int edgeconv=0; edgeconv<(options.reduce_lengths[ri]>0 ? 2 : 1); edgeconv++){
+						s.mama = (MAMA_KIND)mama;
+						s.solver = (SOLVER_KIND)solver;
+						s.node_d_conv = (nodeconv != 0);
+						s.edge_d_conv = (edgeconv != 0);
+						s.reduce_path_length = options.reduce_lengths[ri];
+						if(mama==MK_1 && solver==SK_DP && nodeconv==0 && options.reduce_lengths[ri]==0)
+							continue;
+						strategies.push_back(s);
+					}
+				}
+			}
+		}
+	}
+
+	//the choice of mama and solver for each reference graph, checked against 1/dp like the fixed ones
+	s.auto_select = true;
+	for(int nodeconv=0; nodeconv<2; nodeconv++){
+		for(size_t ri=0; ri<options.reduce_lengths.size(); ri++){
+			for(int edgeconv=0; edgeconv<(options.reduce_lengths[ri]>0 ? 2 : 1); edgeconv++){
+				s.node_d_conv = (nodeconv != 0);
+				s.edge_d_conv = (edgeconv != 0);
+				s.reduce_path_length = options.reduce_lengths[ri];
+				strategies.push_back(s);
+			}
+		}
+	}
+};
+
+
+void print_strategy(std::ostream& out, Strategy& strategy){
+	if(strategy.auto_select)
+		out<<"auto";
+	else
+		out<<mama_kind_name(strategy.mama)<<"/"<<solver_kind_name(strategy.solver);
+	out<<" nodeconv "<<strategy.node_d_conv<<" edgeconv "<<strategy.edge_d_conv<<" reduce "<<strategy.reduce_path_length;
+};
+
+
+enum TUNE_RESULT {
+	TR_DONE,		//all the queries were timed
+	TR_ABORTED,		//the time went over the budget
+	TR_WRONG		//a count differs from the expected one
+};
+
+/*
+ * Time of the queries with a strategy, the fastest of reps runs for each query.
+ * Stops as soon as the time goes over budget (if budget > 0), the search of the
+ * running query is stopped from inside the solver by the deadline of the session.
+ * The counts are stored in counts if expected is NULL, otherwise they are checked
+ * against it and the first query with a different count is given in wrong, with its count.
+ */
+TUNE_RESULT time_strategy(Engine& engine, PreparedQuery* queries, int nof_queries, MATCH_TYPE matchtype, Strategy& strategy,
+		int reps, double budget, long* expected, long* counts, double& total, int& wrong, long& wrongcount){
+	Session session;
+	EmptyMatchListener matchListener;
+	total = 0;
+	for(int qi=0; qi<nof_queries; qi++){
+		double best = -1;
+		for(int r=0; r<reps; r++){
+			MatchStats stats;
+			//the first run may take what is left of the budget, the next ones only matter if faster than the best one
+			if(budget > 0)
+				session.deadline.set(best < 0 ? budget - total : best);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			engine.match(session, queries[qi], 0, matchtype, strategy, matchListener, stats);
+			double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if(session.deadline.expired){
+				if(best >= 0)
+					continue;
+				//the counts of a stopped search are partial
+				total += t;
+				return TR_ABORTED;
+			}
+			if(expected != NULL && stats.matchcount != expected[qi]){
+				wrong = qi;
+				wrongcount = stats.matchcount;
+				return TR_WRONG;
+			}
+			if(counts != NULL)
+				counts[qi] = stats.matchcount;
+			if(best < 0 || t < best)
+				best = t;
+			//a single run over the budget is enough to drop it
+			if(budget > 0 && total + best > budget){
+				total += best;
+				return TR_ABORTED;
+			}
+		}
+		total += best;
+	}
+	return TR_DONE;
+};
+
+
+int main(int argc, char* argv[]){
+	MATCH_TYPE matchtype;
+	GRAPH_FILE_TYPE filetype;
+	TuneOptions options;
+	if(argc<5 || !parse_match_type(argv[1], matchtype) || !parse_file_type(argv[2], filetype) || !parse_options(argc, argv, 5, options)){
+		usage(argv[0]);
+		return -1;
+	}
+	std::string referencefile = argv[3];
+	std::string querylist = argv[4];
+
+	std::vector<std::string> queryfiles;
+	if(read_query_list(querylist.c_str(), queryfiles) != 0 || queryfiles.empty()){
+		std::cout<<"unable to read the query list "<<querylist<<"\n";
+		return -1;
+	}
+
+	MatchOptions moptions;
+	Engine engine(filetype, moptions);
+	std::ostream discard(NULL);
+	if(engine.load_reference(referencefile, discard) < 0){
+		std::cout<<"unable to open reference file\n";
+		return -1;
+	}
+
+	int nof_queries = (int)queryfiles.size();
+	PreparedQuery* queries = new PreparedQuery[nof_queries];
+	for(int qi=0; qi<nof_queries; qi++){
+		if(engine.prepare_file(queryfiles[qi].c_str(), queries[qi]) != 0){
+			std::cout<<"unable to read the query "<<queryfiles[qi]<<"\n";
+			delete[] queries;
+			return -1;
+		}
+	}
+
+	std::vector<Strategy> strategies;
+	enumerate_strategies(matchtype, options, strategies);
+	std::cout<<nof_queries<<" queries, "<<strategies.size()<<" strategies, "<<options.reps<<" runs each\n";
+
+	long* expected = new long[nof_queries];
+	int best = -1;
+	double besttime = 0, basetime = 0;
+	int nof_aborted = 0, nof_wrong = 0;
+	for(size_t si=0; si<strategies.size(); si++){
+		double total;
+		int wrong = -1;
+		long wrongcount = 0;
+		double budget = (best < 0) ? 0 : besttime * options.slack;
+		TUNE_RESULT res = time_strategy(engine, queries, nof_queries, matchtype, strategies[si], options.reps, budget,
+				(si == 0) ? NULL : expected, (si == 0) ? expected : NULL, total, wrong, wrongcount);
+
+		print_strategy(std::cout, strategies[si]);
+		if(res == TR_WRONG){
+			std::cout<<": "<<wrongcount<<" matches of "<<queryfiles[wrong]<<" instead of "<<expected[wrong]<<", dropped\n";
+			nof_wrong++;
+		}
+		else if(res == TR_ABORTED){
+			std::cout<<": over "<<budget<<" s, dropped\n";
+			nof_aborted++;
+		}
+		else{
+			std::cout<<": "<<total<<" s\n";
+			if(si == 0)
+				basetime = total;
+			if(best < 0 || total < besttime){
+				best = (int)si;
+				besttime = total;
+			}
+		}
+	}
+	std::cout<<nof_aborted<<" strategies over budget, "<<nof_wrong<<" with wrong counts\n";
+	std::cout<<"best: ";
+	print_strategy(std::cout, strategies[best]);
+	std::cout<<", "<<besttime<<" s ("<<basetime<<" s with 1/dp)\n";
+
+	std::ofstream out(options.profile.c_str());
+	if(!out.is_open()){
+		std::cout<<"unable to write the profile "<<options.profile<<"\n";
+		delete[] expected;
+		delete[] queries;
+		return -1;
+	}
+	out<<"# arcmatch-tune "<<argv[1]<<" "<<argv[2]<<" "<<referencefile<<" "<<querylist<<"\n";
+	out<<"# "<<nof_queries<<" queries, "<<besttime<<" s ("<<basetime<<" s with 1/dp)\n";
+	write_profile(out, strategies[best]);
+	out.close();
+	std::cout<<"profile written to "<<options.profile<<"\n";
+
+	delete[] expected;
+	delete[] queries;
+	return 0;
+};
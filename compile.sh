@@ -33,69 +33,59 @@
 #//#define MAMA_1 //original order
 #//#define MAMA_NS //the real original order with node sets for flags
 #define MAMA_NSL //the real original order with node sets for flags, with disjoint leafs at the end of the ordering
+#//#define MAMA_NST //node sets, with the trees hanging from the core at the end of the ordering
 
 #//#define SOLVER_0 //simple solver with edge domains
 #//#define SOLVER_ED //simple solver which exploits edge domains
 #//#define SOLVER_DP //solver with dynamic parent selection
 #define SOLVER_LF //solver with dynamic parent selection and leafs
+#//#define SOLVER_FF //solver with dynamic fail-first node selection
+#//#define SOLVER_TD //solver with dynamic parent selection and trees counted by dynamic programming
+#//#define SOLVER_CS //solver counting the independent components of the query separately
 
 #define PATH_LENGTH 6
 #//#define PATH_LENGTH 9
 
 
-additional=""
-
-
-t1="-DMAMA_1 -DSOLVER_0"
-t2="-DMAMA_1 -DSOLVER_ED"
-t3="-DMAMA_1 -DSOLVER_DP"
-t4="-DMAMA_NS -DSOLVER_DP"
-t5="-DREDUCE_EDGES -DPATH_LENGTH=6 -DMAMA_NS -DSOLVER_DP"
-t6="-DMAMA_NSL -DSOLVER_LF"
-t7="-DREDUCE_EDGES -DPATH_LENGTH=6 -DMAMA_NSL -DSOLVER_LF"
-t8="-DNODE_D_CONV -DMAMA_1 -DSOLVER_0"
-t9="-DNODE_D_CONV -DMAMA_1 -DSOLVER_ED"
-t10="-DNODE_D_CONV -DMAMA_1 -DSOLVER_DP"
-t11="-DNODE_D_CONV -DMAMA_NS -DSOLVER_DP"
-t12="-DNODE_D_CONV -DREDUCE_EDGES -DPATH_LENGTH=6 -DMAMA_1 -DSOLVER_0"
-t13="-DNODE_D_CONV -DMAMA_NSL -DSOLVER_LF"
+# a single binary: the configurations below are selected at run time by -config n
+# (or by -mama, -solver, -nodeconv, -edgeconv, -reduce), the compile time flags
+# only give the defaults. The former variants are options of the same binary:
+#	arcmatch-n			-config n
+#	arcmatch-lt			-config 13
+#	arcmatch-print		-print
+#	arcmatch-100k		-limit 100000
+#	arcmatch-first		-first
+
+#t1="-DMAMA_1 -DSOLVER_0"
+#t2="-DMAMA_1 -DSOLVER_ED"
+#t3="-DMAMA_1 -DSOLVER_DP"
+#t4="-DMAMA_NS -DSOLVER_DP"
+#t5="-DREDUCE_EDGES -DPATH_LENGTH=6 -DMAMA_NS -DSOLVER_DP"
+#t6="-DMAMA_NSL -DSOLVER_LF"
+#t7="-DREDUCE_EDGES -DPATH_LENGTH=6 -DMAMA_NSL -DSOLVER_LF"
+#t8="-DNODE_D_CONV -DMAMA_1 -DSOLVER_0"
+#t9="-DNODE_D_CONV -DMAMA_1 -DSOLVER_ED"
+#t10="-DNODE_D_CONV -DMAMA_1 -DSOLVER_DP"
+#t11="-DNODE_D_CONV -DMAMA_NS -DSOLVER_DP"
+#t12="-DNODE_D_CONV -DREDUCE_EDGES -DPATH_LENGTH=6 -DMAMA_1 -DSOLVER_0"
+#t13="-DNODE_D_CONV -DMAMA_NSL -DSOLVER_LF"
 t14="-DNODE_D_CONV -DREDUCE_EDGES -DPATH_LENGTH=6 -DMAMA_NSL -DSOLVER_LF"
-t15="-DNODE_D_CONV -DEDGE_D_CONV -DMAMA_NS -DSOLVER_DP"
-t16="-DNODE_D_CONV -DEDGE_D_CONV -DMAMA_NSL -DSOLVER_LF"
-
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t1 $additional -o arcmatch-1
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t2 $additional -o arcmatch-2
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t3 $additional -o arcmatch-3 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t4 $additional -o arcmatch-4 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t5 $additional -o arcmatch-5 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t6 $additional -o arcmatch-6 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t7 $additional -o arcmatch-7
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t8 $additional -o arcmatch-8 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t9 $additional -o arcmatch-9 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t10 $additional -o arcmatch-10 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t11 $additional -o arcmatch-11 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t12 $additional -o arcmatch-12 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t13 $additional -o arcmatch-13 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t14 $additional -o arcmatch-14
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t15 $additional -o arcmatch-15
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t16 $additional -o arcmatch-16 
-
-cp arcmatch-7 arcmatch
-cp arcmatch-13 arcmatch-lt
-
-
-additional="-DPRINT_MATCHES"
-
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t7 $additional  -o arcmatch-print
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t13 $additional -o arcmatch-lt-print
-
+#t15="-DNODE_D_CONV -DEDGE_D_CONV -DMAMA_NS -DSOLVER_DP"
+#t16="-DNODE_D_CONV -DEDGE_D_CONV -DMAMA_NSL -DSOLVER_LF"
 
-additional="-DFIRST_100k_MATCHES"
+#ARC_MATCH_CONTROL=0 keeps PreprocessorControl.h from adding its own defaults, so the
+#flags of its default configuration 14 are given here
+g++ -std=c++11 -O3 -pthread  arcmatch_template.cpp -I ./rilib/ -I ./include/  -DARC_MATCH_CONTROL=0 $t14 -o arcmatch
 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t7 $additional  -o arcmatch-100k
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t13 $additional -o arcmatch-lt-100k
+#times the strategies on a sample of queries and writes a profile for arcmatch -profile
+g++ -std=c++11 -O3 -pthread  arcmatch_tune.cpp -I ./rilib/ -I ./include/  -DARC_MATCH_CONTROL=0 $t14 -o arcmatch-tune
 
-additional="-DFIRST_MATCH_ONLY"
+#two translation units including the headers must link, i.e. no non-inline definitions in headers
+g++ -std=c++11 -pthread -c arcmatch_link_check.cpp -I ./rilib/ -I ./include/  -DARC_MATCH_CONTROL=0 $t14 -o arcmatch_link_check_a.o \
+	&& g++ -std=c++11 -pthread -c arcmatch_link_check.cpp -I ./rilib/ -I ./include/  -DARC_MATCH_CONTROL=0 $t14 -DLINK_CHECK_MAIN -o arcmatch_link_check_b.o \
+	&& g++ -pthread arcmatch_link_check_a.o arcmatch_link_check_b.o -o arcmatch_link_check \
+	|| echo "link check failed: a header defines a non-inline function"
+rm -f arcmatch_link_check_a.o arcmatch_link_check_b.o arcmatch_link_check
 
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t7 $additional  -o arcmatch-first
-g++ -std=c++11 -O3  arcmatch_template.cpp -I ./rilib/ -I ./include/  $t13 $additional -o arcmatch-lt-first
\ No newline at end of file
+#regression checks of the arcmatch just built
+bash regression/run.sh ./arcmatch
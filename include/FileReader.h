@@ -32,19 +32,131 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <iostream>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <sys/stat.h>
 
+#define FNV64_OFFSET 14695981039346656037ULL
+#define FNV64_PRIME 1099511628211ULL
+
+// 64 bit FNV-1a over size bytes, chained from h
+inline unsigned long long fnv1a_64(const char *data, long size, unsigned long long h = FNV64_OFFSET) {
+    for (long i = 0; i < size; i++) {
+        h ^= (unsigned char)data[i];
+        h *= FNV64_PRIME;
+    }
+    return h;
+};
+
+inline long file_mtime(const char *filename) {
+    struct stat st;
+    if (stat(filename, &st) != 0)
+        return -1;
+    return (long)st.st_mtime;
+};
+
+/*
+ * Size, modification time and content checksum of a file, so that a sidecar
+ * index can tell whether the file changed since it was built.
+ */
+class FileStamp {
+  public:
+    long size;
+    long mtime;
+    unsigned long long checksum;
+
+    FileStamp() {
+        size = -1;
+        mtime = -1;
+        checksum = 0;
+    }
+
+    // false if the file cannot be read, the stamp is then left invalid
+    bool read(const char *filename) {
+        size = -1;
+        mtime = file_mtime(filename);
+        checksum = FNV64_OFFSET;
+        FILE *f = fopen(filename, "rb");
+        if (f == NULL)
+            return false;
+        char chunk[1 << 16];
+        long total = 0;
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+            checksum = fnv1a_64(chunk, (long)n, checksum);
+            total += (long)n;
+        }
+        bool ok = !ferror(f);
+        fclose(f);
+        if (ok)
+            size = total;
+        return ok;
+    }
+
+    /*
+     * Whether filename is still the file of this stamp, hashing it only when needed:
+     * a different size means it changed, the same size and mtime that it did not,
+     * otherwise the checksum decides. A touched but unchanged file updates the mtime.
+     */
+    bool matches(const char *filename) {
+        struct stat st;
+        if (size < 0 || stat(filename, &st) != 0 || (long)st.st_size != size)
+            return false;
+        if ((long)st.st_mtime == mtime)
+            return true;
+        FileStamp now;
+        if (!now.read(filename) || now.size != size || now.checksum != checksum)
+            return false;
+        mtime = now.mtime;
+        return true;
+    }
+
+    bool operator==(const FileStamp &o) const { return size == o.size && mtime == o.mtime && checksum == o.checksum; }
+    bool operator!=(const FileStamp &o) const { return !(*this == o); }
+};
+
+/*
+ * Tokens of a graph file, read through a window of WINDOW_BYTES moved along the
+ * file, so the memory does not grow with the file. A token is null-terminated in
+ * place, the string returned by next_string is valid until the next read.
+ */
 class FileReader {
+    static const long WINDOW_BYTES = 1 << 20;
+
     FILE *pFile;
     long lSize;
-    char *buffer;
+    char *buffer; // the window, with a spare byte for the terminator of a token at the end of the data
+    long capacity;
+    long base; // offset of the window in the file, the file is positioned at base + len
+    long len;
 
     long pi;
 
+    static bool blank(char c) { return (c == ' ') || (c == '\n') || (c == '\t') || (c == '\r'); }
+
+    // moves the window to start at keep, the first byte of the open token, and reads the bytes after the ones
+    // it holds. false if there are no more bytes
+    bool refill(long keep) {
+        if (pFile == NULL || base + len >= lSize)
+            return false;
+        long kept = base + len - keep;
+        if (kept == capacity) {
+            capacity *= 2;
+            buffer = (char *)realloc(buffer, capacity + 1);
+            if (buffer == NULL) {
+                fputs("Memory error\n", stderr);
+                exit(2);
+            }
+        }
+        memmove(buffer, buffer + (keep - base), kept);
+        size_t n = fread(buffer + kept, 1, capacity - kept, pFile);
+        base = keep;
+        len = kept + (long)n;
+        return n > 0;
+    }
+
   public:
     FileReader(const char *filename) {
-        size_t result;
-
         pFile = fopen(filename, "rb");
         if (pFile == NULL) {
             fputs("File error\n", stderr);
@@ -56,66 +168,126 @@ class FileReader {
         lSize = ftell(pFile);
         rewind(pFile);
 
-        // allocate memory to contain the whole file:
-        buffer = (char *)malloc(sizeof(char) * lSize);
+        capacity = WINDOW_BYTES;
+        buffer = (char *)malloc(capacity + 1);
         if (buffer == NULL) {
             fputs("Memory error\n", stderr);
             exit(2);
         }
+        base = 0;
+        len = 0;
+        pi = 0;
+    }
 
-        // copy the file into the buffer:
-        result = fread(buffer, 1, lSize, pFile);
-        if (result != lSize) {
-            fputs("Reading error\n", stderr);
-            exit(3);
+    // reads from a copy of a memory buffer, e.g. a graph received by the server mode
+    FileReader(const char *data, long size) {
+        pFile = NULL;
+        lSize = size;
+        capacity = (lSize > 0) ? lSize : 0;
+        buffer = (char *)malloc(capacity + 1);
+        if (buffer == NULL) {
+            fputs("Memory error\n", stderr);
+            exit(2);
         }
-
-        /* the whole file is now loaded in the memory buffer. */
-
+        if (lSize > 0)
+            memcpy(buffer, data, lSize);
+        base = 0;
+        len = capacity;
         pi = 0;
     }
 
     bool is_valid() { return pi < lSize; }
 
-    const char *next_string() {
-
-        while ((pi < lSize) && ((buffer[pi] == ' ') || (buffer[pi] == '\n') || (buffer[pi] == '\t') || (buffer[pi] == '\r'))) {
-            pi++;
+    // skip blanks and tell whether another token is available
+    bool has_next() {
+        for (;;) {
+            char *p = buffer + (pi - base), *end = buffer + len;
+            while ((p < end) && blank(*p)) {
+                p++;
+            }
+            pi = base + (p - buffer);
+            if (p < end)
+                return true;
+            if (!refill(pi))
+                return false;
         }
+    }
 
-        long ci = pi;
+    long size() { return lSize; }
 
-        while ((pi < lSize) && (buffer[pi] != ' ') && (buffer[pi] != '\n') && (buffer[pi] != '\t') && (buffer[pi] != '\r')) {
-            pi++;
-        }
+    // checksum of the file bytes, only meaningful before the first next_string since tokens are null-terminated in place
+    unsigned long long checksum() {
+        if (pFile == NULL)
+            return fnv1a_64(buffer, lSize);
+        unsigned long long h = FNV64_OFFSET;
+        rewind(pFile);
+        size_t n;
+        while ((n = fread(buffer, 1, capacity, pFile)) > 0)
+            h = fnv1a_64(buffer, (long)n, h);
+        fseek(pFile, pi, SEEK_SET);
+        base = pi;
+        len = 0;
+        return h;
+    }
 
-        if (pi < lSize) {
-            buffer[pi] = '\0';
-        }
-        pi++;
+    long tell() { return pi; }
 
-        return buffer + ci;
+    // only forward seeks are safe, tokens already read have been null-terminated in place
+    void seek(long pos) {
+        if (pos < 0)
+            pos = 0;
+        if (pos > lSize)
+            pos = lSize;
+        if (pos < base || pos > base + len) {
+            fseek(pFile, pos, SEEK_SET);
+            base = pos;
+            len = 0;
+        }
+        pi = pos;
     }
 
-    int next_int() {
+    const char *next_string() {
+        has_next();
 
-        while ((pi < lSize) && ((buffer[pi] == ' ') || (buffer[pi] == '\n') || (buffer[pi] == '\t') || (buffer[pi] == '\r'))) {
-            pi++;
+        long ci = pi;
+        for (;;) {
+            char *p = buffer + (pi - base), *end = buffer + len;
+            while ((p < end) && !blank(*p)) {
+                p++;
+            }
+            pi = base + (p - buffer);
+            if (p < end || !refill(ci))
+                break;
         }
 
-        int ret = 0;
+        buffer[pi - base] = '\0';
+        if (pi < base + len)
+            pi++;
 
-        while ((pi < lSize) && (buffer[pi] != ' ') && (buffer[pi] != '\n') && (buffer[pi] != '\t') && (buffer[pi] != '\r')) {
-            ret = (ret * 10) + (buffer[pi] - '0');
+        return buffer + (ci - base);
+    }
 
-            pi++;
+    int next_int() {
+        has_next();
+
+        int ret = 0;
+        for (;;) {
+            char *p = buffer + (pi - base), *end = buffer + len;
+            while ((p < end) && !blank(*p)) {
+                ret = (ret * 10) + (*p - '0');
+                p++;
+            }
+            pi = base + (p - buffer);
+            if (p < end || !refill(pi))
+                break;
         }
 
         return ret;
     }
 
     void close() {
-        fclose(pFile);
+        if (pFile != NULL)
+            fclose(pFile);
         free(buffer);
     }
 };
\ No newline at end of file
@@ -53,12 +53,12 @@ enum GRAPH_FILE_TYPE { GFT_GFU, GFT_GFD, GFT_EGFU, GFT_EGFD, GFT_VFU, GFT_LAD, G
 
 int read_gfu(const char *fileName, FILE *fd, Graph *graph);
 int read_gfd(const char *fileName, FILE *fd, Graph *graph);
-int read_vfu(const char *fileName, FILE *fd, Graph *graph);
-int read_lad(const char *fileName, FILE *fd, Graph *graph);
+inline int read_vfu(const char *fileName, FILE *fd, Graph *graph);
+inline int read_lad(const char *fileName, FILE *fd, Graph *graph);
 int read_egfu(const char *fileName, FILE *fd, Graph *graph);
 int read_egfd(const char *fileName, FILE *fd, Graph *graph);
 
-FILE *open_file(const char *filename, enum GRAPH_FILE_TYPE type) {
+inline FILE *open_file(const char *filename, enum GRAPH_FILE_TYPE type) {
     FILE *fd;
     switch (type) {
     case GFT_VFU:
@@ -75,7 +75,7 @@ FILE *open_file(const char *filename, enum GRAPH_FILE_TYPE type) {
     return fd;
 };
 
-int read_dbgraph(const char *filename, FILE *fd, Graph *g, enum GRAPH_FILE_TYPE type) {
+inline int read_dbgraph(const char *filename, FILE *fd, Graph *g, enum GRAPH_FILE_TYPE type) {
     int ret = 0;
     switch (type) {
     case GFT_GFU:
@@ -101,7 +101,7 @@ int read_dbgraph(const char *filename, FILE *fd, Graph *g, enum GRAPH_FILE_TYPE
     return ret;
 };
 
-int read_graph(const char *filename, Graph *g, enum GRAPH_FILE_TYPE type) {
+inline int read_graph(const char *filename, Graph *g, enum GRAPH_FILE_TYPE type) {
     FILE *fd = open_file(filename, type);
     if (fd == NULL) {
         printf("ERROR: Cannot open input file %s\n", filename);
@@ -139,7 +139,7 @@ struct gr_neighs_t {
     gr_neighs_t *next;
 };
 
-int read_gfu(const char *fileName, FILE *fd, Graph *graph) {
+inline int read_gfu(const char *fileName, FILE *fd, Graph *graph) {
     TIMEHANDLE time_s;
     double time_e;
 
@@ -284,7 +284,7 @@ int read_gfu(const char *fileName, FILE *fd, Graph *graph) {
     return 0;
 };
 
-int read_gfd(const char *fileName, FILE *fd, Graph *graph) {
+inline int read_gfd(const char *fileName, FILE *fd, Graph *graph) {
     char str[STR_READ_LENGTH];
     int i, j;
 
@@ -367,9 +367,9 @@ int read_gfd(const char *fileName, FILE *fd, Graph *graph) {
     return 0;
 };
 
-int read_vfu(const char *fileName, FILE *fd, Graph *graph) { return 0; };
+inline int read_vfu(const char *fileName, FILE *fd, Graph *graph) { return 0; };
 
-int read_lad(const char *fileName, FILE *fd, Graph *graph) { return 0; };
+inline int read_lad(const char *fileName, FILE *fd, Graph *graph) { return 0; };
 
 struct egr_neighs_t {
   public:
@@ -378,7 +378,7 @@ struct egr_neighs_t {
     std::string *label;
 };
 
-int read_egfu(const char *fileName, FILE *fd, Graph *graph) {
+inline int read_egfu(const char *fileName, FILE *fd, Graph *graph) {
     char str[STR_READ_LENGTH];
     int i, j;
 
@@ -518,7 +518,7 @@ int read_egfu(const char *fileName, FILE *fd, Graph *graph) {
     return 0;
 };
 
-int read_egfd(const char *fileName, FILE *fd, Graph *graph) {
+inline int read_egfd(const char *fileName, FILE *fd, Graph *graph) {
     char str[STR_READ_LENGTH];
     int i, j;
 
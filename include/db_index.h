@@ -0,0 +1,304 @@
+/*
+ * db_index.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef DB_INDEX_H_
+#define DB_INDEX_H_
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FileReader.h"
+#include "Graph.h"
+#include "fr_textdb_driver.h"
+
+/*
+ * Summary index over a reference database.
+ * For each graph of the db file it keeps the byte offset plus a few invariants
+ * (sizes, label histograms, degree profile) that must be dominated by any
+ * graph containing the query. Graphs failing the check are skipped without
+ * being parsed. The index is stored next to the db file (<db>.aidx) and it is
+ * rebuilt whenever the db size or the file format does not match.
+ */
+
+#define DBINDEX_MAGIC "ARCMATCH_DBINDEX"
+#define DBINDEX_VERSION 2
+#define DBINDEX_SUFFIX ".aidx"
+
+namespace rilib {
+
+typedef std::map<std::string, int> label_histogram_t;
+typedef std::map<int, int> degree_histogram_t; // degree -> nof nodes
+
+class GraphSummary {
+  public:
+    long offset; // byte offset of the graph header inside the db file
+    int nof_nodes;
+    int nof_edges; // nof entries in the out adjacency lists
+    int max_out_degree;
+    int max_in_degree;
+
+    label_histogram_t node_labels;
+    label_histogram_t edge_labels;
+    degree_histogram_t out_degrees;
+    degree_histogram_t in_degrees;
+
+    GraphSummary() {
+        offset = -1;
+        nof_nodes = 0;
+        nof_edges = 0;
+        max_out_degree = 0;
+        max_in_degree = 0;
+    }
+};
+
+inline void summarize_graph(Graph &g, GraphSummary &s) {
+    s.nof_nodes = g.nof_nodes;
+    s.nof_edges = 0;
+    s.max_out_degree = 0;
+    s.max_in_degree = 0;
+    s.node_labels.clear();
+    s.edge_labels.clear();
+    s.out_degrees.clear();
+    s.in_degrees.clear();
+
+    for (int i = 0; i < g.nof_nodes; i++) {
+        s.node_labels[*((std::string *)g.nodes_attrs[i])]++;
+        s.out_degrees[g.out_adj_sizes[i]]++;
+        s.in_degrees[g.in_adj_sizes[i]]++;
+        if (g.out_adj_sizes[i] > s.max_out_degree)
+            s.max_out_degree = g.out_adj_sizes[i];
+        if (g.in_adj_sizes[i] > s.max_in_degree)
+            s.max_in_degree = g.in_adj_sizes[i];
+
+        s.nof_edges += g.out_adj_sizes[i];
+        for (int j = 0; j < g.out_adj_sizes[i]; j++) {
+            if (g.out_adj_attrs[i][j] != NULL)
+                s.edge_labels[*((std::string *)g.out_adj_attrs[i][j])]++;
+        }
+    }
+};
+
+inline bool histogram_dominates(label_histogram_t &big, label_histogram_t &small) {
+    for (label_histogram_t::iterator it = small.begin(); it != small.end(); it++) {
+        label_histogram_t::iterator bit = big.find(it->first);
+        if (bit == big.end() || bit->second < it->second)
+            return false;
+    }
+    return true;
+};
+
+/*
+ * The sorted degree sequence of big has to dominate the one of small, that is
+ * for each degree d there are at least as many nodes of degree >= d in big as in small.
+ */
+inline bool degrees_dominate(degree_histogram_t &big, degree_histogram_t &small) {
+    degree_histogram_t::reverse_iterator bit = big.rbegin();
+    int bcount = 0, scount = 0;
+    for (degree_histogram_t::reverse_iterator sit = small.rbegin(); sit != small.rend(); sit++) {
+        scount += sit->second;
+        while (bit != big.rend() && bit->first >= sit->first) {
+            bcount += bit->second;
+            bit++;
+        }
+        if (bcount < scount)
+            return false;
+    }
+    return true;
+};
+
+/*
+ * Necessary conditions for the reference graph r to contain the query q.
+ * For isomorphism all the invariants must be equal.
+ */
+inline bool summary_may_contain(GraphSummary &r, GraphSummary &q, bool iso) {
+    if (iso) {
+        return r.nof_nodes == q.nof_nodes && r.nof_edges == q.nof_edges && r.node_labels == q.node_labels && r.edge_labels == q.edge_labels && r.out_degrees == q.out_degrees && r.in_degrees == q.in_degrees;
+    }
+    if (r.nof_nodes < q.nof_nodes || r.nof_edges < q.nof_edges)
+        return false;
+    if (r.max_out_degree < q.max_out_degree || r.max_in_degree < q.max_in_degree)
+        return false;
+    if (!histogram_dominates(r.node_labels, q.node_labels) || !histogram_dominates(r.edge_labels, q.edge_labels))
+        return false;
+    return degrees_dominate(r.out_degrees, q.out_degrees) && degrees_dominate(r.in_degrees, q.in_degrees);
+};
+
+class DBIndex {
+  public:
+    int filetype;
+    FileStamp db; // the db file the index was built from
+    std::vector<GraphSummary> entries;
+
+    DBIndex() { filetype = -1; }
+
+    int size() { return (int)entries.size(); }
+
+    bool save(const char *filename) {
+        std::ofstream os(filename);
+        if (!os.is_open())
+            return false;
+
+        os << DBINDEX_MAGIC << " " << DBINDEX_VERSION << " " << filetype << " " << db.size << " " << db.mtime << " " << db.checksum << " " << entries.size() << "\n";
+        for (size_t i = 0; i < entries.size(); i++) {
+            GraphSummary &s = entries[i];
+            os << s.offset << " " << s.nof_nodes << " " << s.nof_edges << " " << s.max_out_degree << " " << s.max_in_degree;
+            write_histogram(os, s.node_labels);
+            write_histogram(os, s.edge_labels);
+            write_histogram(os, s.out_degrees);
+            write_histogram(os, s.in_degrees);
+            os << "\n";
+        }
+        return os.good();
+    }
+
+    bool load(const char *filename) {
+        std::ifstream is(filename);
+        if (!is.is_open())
+            return false;
+
+        std::string magic;
+        int version;
+        size_t nof_entries;
+        is >> magic >> version >> filetype >> db.size >> db.mtime >> db.checksum >> nof_entries;
+        if (!is.good() || magic != DBINDEX_MAGIC || version != DBINDEX_VERSION)
+            return false;
+
+        entries.resize(nof_entries);
+        for (size_t i = 0; i < nof_entries; i++) {
+            GraphSummary &s = entries[i];
+            is >> s.offset >> s.nof_nodes >> s.nof_edges >> s.max_out_degree >> s.max_in_degree;
+            read_histogram(is, s.node_labels);
+            read_histogram(is, s.edge_labels);
+            read_histogram(is, s.out_degrees);
+            read_histogram(is, s.in_degrees);
+            if (is.fail())
+                return false;
+        }
+        return true;
+    }
+
+  private:
+    template <class K> void write_histogram(std::ostream &os, std::map<K, int> &h) {
+        os << " " << h.size();
+        for (typename std::map<K, int>::iterator it = h.begin(); it != h.end(); it++) {
+            os << " " << it->first << " " << it->second;
+        }
+    }
+
+    template <class K> void read_histogram(std::istream &is, std::map<K, int> &h) {
+        size_t n;
+        K key;
+        int count;
+        h.clear();
+        is >> n;
+        for (size_t i = 0; i < n && is.good(); i++) {
+            is >> key >> count;
+            h[key] = count;
+        }
+    }
+};
+
+/*
+ * Scan the whole db file once and summarize each graph.
+ */
+inline int build_dbindex(const char *filename, enum GRAPH_FILE_TYPE type, DBIndex &index) {
+    FileReader *fd = open_file(filename, type);
+    if (fd == NULL)
+        return -1;
+
+    index.filetype = type;
+    index.db.size = fd->size();
+    index.db.mtime = file_mtime(filename);
+    index.db.checksum = fd->checksum();
+    index.entries.clear();
+
+    while (fd->has_next()) {
+        GraphSummary s;
+        s.offset = fd->tell();
+
+        Graph *g = new Graph();
+        int ret = read_dbgraph(filename, fd, g, type);
+        if (ret != 0) {
+            delete g;
+            fd->close();
+            delete fd;
+            return ret;
+        }
+        summarize_graph(*g, s);
+        index.entries.push_back(s);
+        delete g;
+    }
+
+    fd->close();
+    delete fd;
+    return 0;
+};
+
+inline std::string dbindex_filename(const char *dbfilename) { return std::string(dbfilename) + DBINDEX_SUFFIX; };
+
+/*
+ * Load the sidecar index of a db file, (re)building it if it is missing or stale,
+ * that is if the size or the content of the db file differ from the stored ones.
+ * The db file is hashed only when its mtime changed. Progress goes to log, which
+ * must not be the channel of a server.
+ */
+inline DBIndex *open_dbindex(const char *dbfilename, enum GRAPH_FILE_TYPE type, std::ostream &log) {
+    std::string idxfile = dbindex_filename(dbfilename);
+
+    DBIndex *index = new DBIndex();
+    if (index->load(idxfile.c_str()) && index->filetype == type) {
+        long mtime = index->db.mtime;
+        if (index->db.matches(dbfilename)) {
+            // touched but unchanged, store the new mtime so that the next run does not hash it again
+            if (index->db.mtime != mtime && !index->save(idxfile.c_str()))
+                log << "unable to write db index " << idxfile << "\n";
+            return index;
+        }
+    }
+
+    log << "building db index " << idxfile << "...\n";
+    if (build_dbindex(dbfilename, type, *index) != 0) {
+        delete index;
+        return NULL;
+    }
+    if (!index->save(idxfile.c_str())) {
+        log << "unable to write db index " << idxfile << "\n";
+    }
+    return index;
+};
+
+} // namespace rilib
+
+#endif /* DB_INDEX_H_ */
@@ -0,0 +1,895 @@
+/*
+ * engine.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include <string.h>
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PreprocessorControl.h"
+
+#include "fr_textdb_driver.h"
+#include "db_index.h"
+#include "path_index.h"
+
+#include "AttributeComparator.h"
+#include "Graph.h"
+#include "GraphBuilder.h"
+#include "MatchingMachine.h"
+#include "MaMaConstrFirstDs.h"
+#include "MaMaConstrFirstEDs.h"
+#include "MaMaFloodCore.h"
+#include "MaMaAngularCoefficient.h"
+#include "MaMaConstrFirstNodeSets.h"
+#include "MaMaConstrFirstNodeSetsLeafs.h"
+#include "MaMaConstrFirstNodeSetsTrees.h"
+#include "MaMaConstrFirstNSCC.h"
+#include "MaMaCardinality.h"
+#include "MaMaSampled.h"
+
+#include "MatchListener.h"
+
+#include "Solver.h"
+#include "SubGISolver.h"
+#include "InducedSubGISolver.h"
+#include "IsoSolver.h"
+#include "Domains.h"
+#include "Strategy.h"
+#include "CostModel.h"
+#include "Automorphisms.h"
+
+/*
+ * Library interface of the matcher.
+ * An Engine keeps the reference graphs of one or more files, and their indexes,
+ * in memory. Queries are read once into a PreparedQuery, together with the
+ * features used to preselect the reference graphs, and matched with a Session,
+ * which carries the scratch memory of the solver and must not be shared between
+ * threads. After loading, an Engine is only read, so any number of Sessions may
+ * use it concurrently.
+ * The algorithms of the matching are chosen at run time by a Strategy, whose
+ * defaults are the ones selected at compile time (see PreprocessorControl.h).
+ */
+
+namespace rilib {
+
+enum MATCH_TYPE {
+    MT_ISO,    // isomprhism
+    MT_INDSUB, // induced sub-isomorphism
+    MT_MONO    // monomorphism
+};
+
+// iso, ind or mono
+inline bool parse_match_type(const std::string &par, MATCH_TYPE &matchtype) {
+    if (par == "iso") {
+        matchtype = MT_ISO;
+    } else if (par == "ind") {
+        matchtype = MT_INDSUB;
+    } else if (par == "mono") {
+        matchtype = MT_MONO;
+    } else {
+        return false;
+    }
+    return true;
+};
+
+// gfu, gfd, geu or ged
+inline bool parse_file_type(const std::string &par, GRAPH_FILE_TYPE &filetype) {
+    if (par == "gfu") {
+        filetype = GFT_GFU; // undirected type
+    } else if (par == "gfd") {
+        filetype = GFT_GFD; // directed type
+    } else if (par == "geu") {
+        filetype = GFT_EGFU; // undirect type with labels on edges
+    } else if (par == "ged") {
+        filetype = GFT_EGFD; // direct type with labels on edges
+    }
+    // if no labels, domains are unuseful
+    //	else if(par=="vfu"){
+    //		filetype = GFT_VFU;
+    //	}
+    else {
+        return false;
+    }
+    return true;
+};
+
+// run time options of the engine
+struct MatchOptions {
+    bool use_index;  // skip reference graphs by means of the db summary index
+    int path_length; // if >0, preselect reference graphs by an inverted index of paths up to this length
+    Strategy strategy;
+    MatchOptions() {
+        use_index = false;
+        path_length = 0;
+    }
+};
+
+// counters of the matching phase
+struct MatchStats {
+    long steps,         // total number of steps of the backtracking phase
+        triedcouples,   // nof tried pair (query node, reference node)
+        matchcount,     // nof found matches
+        matchedcouples; // nof mathed pair (during partial solutions)
+    MatchStats() {
+        steps = 0;
+        triedcouples = 0;
+        matchcount = 0;
+        matchedcouples = 0;
+    }
+    void add(MatchStats &s) {
+        steps += s.steps;
+        triedcouples += s.triedcouples;
+        matchcount += s.matchcount;
+        matchedcouples += s.matchedcouples;
+    }
+};
+
+// forwards the matches to a callback. Matches found as sets of leaf candidates
+// (SOLVER_LF) go to the second callback, they are dropped if it is not given
+class CallbackMatchListener : public MatchListener {
+  public:
+    typedef std::function<void(int n, int *qIDs, int *rIDs)> match_callback;
+    typedef std::function<void(int n, int *qIDs, int *rIDs, int si, std::set<int> *leaf_domains)> multiple_match_callback;
+
+  private:
+    match_callback on_match;
+    multiple_match_callback on_match_multiple;
+
+  public:
+    CallbackMatchListener(match_callback _on_match, multiple_match_callback _on_match_multiple = multiple_match_callback())
+        : MatchListener(), on_match(_on_match), on_match_multiple(_on_match_multiple) {}
+    virtual void match(int n, int *qIDs, int *rIDs) {
+        matchcount++;
+        on_match(n, qIDs, rIDs);
+    }
+    virtual void match_multiple(int n, int *qIDs, int *rIDs, int si, std::set<int> *leaf_domains) {
+        matchcount++;
+        if (on_match_multiple)
+            on_match_multiple(n, qIDs, rIDs, si, leaf_domains);
+    }
+};
+
+inline void make_comparators(GRAPH_FILE_TYPE filetype, AttributeComparator *&nodeComparator, AttributeComparator *&edgeComparator) {
+    switch (filetype) {
+    case GFT_GFU:
+    case GFT_GFD:
+        // for these formats, labels are only on nodes and they are strings
+        nodeComparator = new StringAttrComparator();
+        // nodeComparator = new DefaultAttrComparator();
+        edgeComparator = new DefaultAttrComparator();
+        break;
+    case GFT_EGFU:
+    case GFT_EGFD:
+    default:
+        // labels both on nodes and edges
+        nodeComparator = new StringAttrComparator();
+        edgeComparator = new StringAttrComparator();
+        break;
+        //		case GFT_VFU:
+        //			//no labels
+        //			nodeComparator = new DefaultAttrComparator();
+        //			edgeComparator = new DefaultAttrComparator();
+        //			break;
+    }
+};
+
+// the path index of the reference file, if requested and consistent with the db index
+inline PathIndex *open_references_pathindex(const std::string &referencefile, GRAPH_FILE_TYPE filetype, DBIndex *dbindex, MatchOptions &options,
+                                     std::ostream &log) {
+    if (options.path_length <= 0)
+        return NULL;
+    PathIndex *pathindex = open_pathindex(referencefile.c_str(), filetype, dbindex->db, options.path_length, log);
+    if (pathindex != NULL && pathindex->nof_graphs != dbindex->size()) {
+        delete pathindex;
+        pathindex = NULL;
+    }
+    return pathindex;
+};
+
+// a query graph with the features used to preselect the reference graphs
+class PreparedQuery {
+  public:
+    Graph *graph;
+    GraphSummary summary;
+    int path_length; // length of the paths in features, 0 if they are not computed
+    path_feature_set features;
+    QuerySymmetry *symmetry; // orbits of the automorphisms, NULL if they are not computed
+
+    PreparedQuery() {
+        graph = NULL;
+        path_length = 0;
+        symmetry = NULL;
+    }
+    ~PreparedQuery() {
+        delete graph;
+        delete symmetry;
+    }
+
+    // takes the ownership of the graph
+    void prepare(Graph *g, MatchOptions &options) {
+        delete graph;
+        graph = g;
+        delete symmetry;
+        symmetry = NULL;
+        summary = GraphSummary();
+        summarize_graph(*graph, summary);
+        features.clear();
+        path_length = options.path_length > 0 ? options.path_length : 0;
+        if (path_length > 0)
+            compute_path_features(*graph, path_length, features);
+    }
+
+    // needed to break the symmetries of the query
+    void prepare_symmetry(AttributeComparator &nodeComparator, AttributeComparator &edgeComparator) {
+        if (symmetry == NULL)
+            symmetry = new QuerySymmetry();
+        symmetry->compute(*graph, nodeComparator, edgeComparator);
+    }
+};
+
+// ids of the reference graphs which may contain the query, returns the number of skipped graphs
+inline long select_candidates(PreparedQuery &query, DBIndex *dbindex, PathIndex *pathindex, bool doBijIso, std::vector<int> &dbcandidates) {
+    dbcandidates.clear();
+    if (pathindex != NULL && query.path_length == pathindex->max_length) {
+        pathindex->candidates(query.features, dbcandidates);
+    } else {
+        for (int gi = 0; gi < dbindex->size(); gi++) {
+            dbcandidates.push_back(gi);
+        }
+    }
+
+    // drop the graphs that provably cannot contain the query
+    size_t nc = 0;
+    for (size_t ci = 0; ci < dbcandidates.size(); ci++) {
+        if (summary_may_contain(dbindex->entries[dbcandidates[ci]], query.summary, doBijIso)) {
+            dbcandidates[nc++] = dbcandidates[ci];
+        }
+    }
+    dbcandidates.resize(nc);
+    return dbindex->size() - nc;
+};
+
+inline MatchingMachine *make_matching_machine(MAMA_KIND kind, Graph &query, sbitset *domains, int *domains_size, EdgeDomains &edomains,
+                                       AttributeComparator &nodeComparator, AttributeComparator &edgeComparator) {
+    switch (kind) {
+    case MK_1:
+        return new MaMaConstrFirstDs(query, domains, domains_size);
+    case MK_0:
+        return new MaMaConstrFirstEDs(query, domains, domains_size, edomains);
+    case MK_FC:
+        return new MaMaFloodCore(query, domains, domains_size, edomains, query.nof_nodes);
+    case MK_AC:
+        return new MaMaAngularCoefficient(query, domains, domains_size, edomains);
+    case MK_NS:
+        return new MaMaConstrFirstNodeSets(query, domains, domains_size);
+    case MK_CC:
+        return new MaMaConstrFirstNSCC(query, domains, domains_size, nodeComparator, edgeComparator);
+    case MK_CE:
+        return new MaMaCardinality(query, domains, domains_size, edomains);
+    case MK_NST:
+        return new MaMaConstrFirstNodeSetsTrees(query, domains, domains_size);
+    case MK_NSL:
+    default:
+        return new MaMaConstrFirstNodeSetsLeafs(query, domains, domains_size);
+    }
+};
+
+/*
+ * Matching machine and solver with the lowest estimated cost for the domains of
+ * a (query, reference) pair, the reasons are logged to out. The leaf and the
+ * tree solvers are only candidates for monomorphism, since they do not check the
+ * induced constraints among leafs and trees, and only if the query has some.
+ */
+inline MatchingMachine *select_matching_machine(MATCH_TYPE matchtype, Graph &query, sbitset *domains, int *domains_size, EdgeDomains &edomains,
+                                         AttributeComparator &nodeComparator, AttributeComparator &edgeComparator, std::ostream &out,
+                                         MAMA_KIND &mamakind, SOLVER_KIND &solver) {
+    static const struct {
+        MAMA_KIND mama;
+        SOLVER_KIND solver;
+    } candidates[] = {{MK_1, SK_DP}, {MK_NS, SK_DP}, {MK_FC, SK_DP}, {MK_AC, SK_DP}, {MK_CE, SK_DP}, {MK_NSL, SK_LF}, {MK_NST, SK_TD}};
+    static const int nof_candidates = sizeof(candidates) / sizeof(candidates[0]);
+
+    QueryFeatures features;
+    compute_query_features(query, domains_size, edomains, features);
+    out << "auto: ";
+    print_query_features(out, features);
+    out << "\n";
+
+    MatchingMachine *best = NULL;
+    double bestcost = 0;
+    out << "auto: estimated cost";
+    for (int c = 0; c < nof_candidates; c++) {
+        if ((candidates[c].solver == SK_LF || candidates[c].solver == SK_TD) && (matchtype != MT_MONO || features.nof_leafs == 0))
+            continue;
+        MatchingMachine *mama = make_matching_machine(candidates[c].mama, query, domains, domains_size, edomains, nodeComparator, edgeComparator);
+        mama->build(query);
+        mama->fix_eids(query);
+        if (candidates[c].solver == SK_TD && mama->nof_leafs == 0) {
+            delete mama;
+            continue;
+        }
+        bool counted = (candidates[c].solver == SK_LF || candidates[c].solver == SK_TD);
+        double cost = estimate_search_cost(*mama, domains_size, edomains, counted ? mama->nof_leafs : 0, candidates[c].solver == SK_TD);
+        out << " " << mama_kind_name(candidates[c].mama) << "/" << solver_kind_name(candidates[c].solver) << "=" << cost;
+        if (best == NULL || cost < bestcost) {
+            delete best;
+            best = mama;
+            bestcost = cost;
+            mamakind = candidates[c].mama;
+            solver = candidates[c].solver;
+        } else {
+            delete mama;
+        }
+    }
+    out << "\n";
+    out << "auto: chosen " << mama_kind_name(mamakind) << "/" << solver_kind_name(solver) << "\n";
+    return best;
+};
+
+/*
+ * Order with the smallest search tree estimated by random probes, among mama,
+ * the orders of the other builders and a few random connected orders. Returns
+ * the chosen machine, mama is deleted if another one is chosen.
+ */
+inline MatchingMachine *select_sampled_machine(MatchingMachine *mama, MAMA_KIND mamakind, Graph &query, Graph &rgraph, sbitset *domains,
+                                        int *domains_size, EdgeDomains &edomains, AttributeComparator &nodeComparator,
+                                        AttributeComparator &edgeComparator, int probes, std::ostream &out) {
+    static const MAMA_KIND builders[] = {MK_1, MK_NS, MK_FC, MK_AC, MK_CE};
+    static const int nof_builders = sizeof(builders) / sizeof(builders[0]);
+    static const int nof_random_orders = 4;
+
+    std::vector<MatchingMachine *> machines;
+    std::vector<std::string> names;
+    machines.push_back(mama);
+    names.push_back(mama_kind_name(mamakind));
+    for (int b = 0; b < nof_builders; b++) {
+        if (builders[b] == mamakind)
+            continue;
+        MatchingMachine *m = make_matching_machine(builders[b], query, domains, domains_size, edomains, nodeComparator, edgeComparator);
+        m->build(query);
+        machines.push_back(m);
+        names.push_back(mama_kind_name(builders[b]));
+    }
+    std::mt19937 rng(query.nof_nodes);
+    std::vector<int> order;
+    for (int r = 0; r < nof_random_orders; r++) {
+        random_order(query, domains_size, rng, order);
+        MatchingMachine *m = new MaMaOrder(query, order);
+        m->build(query);
+        machines.push_back(m);
+        names.push_back("random");
+    }
+
+    MatchingMachine *best = NULL;
+    double bestsize = 0;
+    out << "sampling: estimated tree size";
+    for (size_t mi = 0; mi < machines.size(); mi++) {
+        MatchingMachine *m = machines[mi];
+        // the same order as an earlier candidate
+        bool same = false;
+        for (size_t mj = 0; mj < mi && !same; mj++) {
+            same = machines[mj] != NULL && memcmp(m->map_state_to_node, machines[mj]->map_state_to_node, m->nof_sn * sizeof(int)) == 0;
+        }
+        if (same) {
+            if (m != mama)
+                delete m;
+            machines[mi] = NULL;
+            continue;
+        }
+        if (m != mama)
+            m->fix_eids(query);
+        double size = estimate_tree_size(*m, rgraph, domains, edomains, probes, rng);
+        out << " " << names[mi] << "=" << size;
+        if (best == NULL || size < bestsize) {
+            best = m;
+            bestsize = size;
+        }
+    }
+    out << "\n";
+    for (size_t mi = 0; mi < machines.size(); mi++) {
+        if (machines[mi] != NULL && machines[mi] != best)
+            delete machines[mi];
+    }
+    return best;
+};
+
+/*
+ * Isomorphisms of the query onto one reference graph, see IsoSolver.h. The domains and the
+ * matching machines of the strategy are not used. With a symmetry mode and a complete
+ * automorphism group, the search stops at the first isomorphism, which stands for all of them.
+ */
+inline void match_isomorphism(Strategy &strategy, Graph *query, Graph *rrg, AttributeComparator *nodeComparator, AttributeComparator *edgeComparator,
+                       MatchListener *matchListener, std::ostream &out, MatchStats &stats, QuerySymmetry *symmetry = NULL, Deadline *deadline = NULL) {
+    IsoSolver solver(*rrg, *query, *nodeComparator, *edgeComparator, *matchListener);
+    solver.match_limit = strategy.match_limit;
+    solver.deadline = deadline;
+    solver.first_only = (strategy.symmetry != SY_OFF && symmetry != NULL && symmetry->complete);
+    solver.solve();
+    out << "isomorphism: refinements " << solver.steps << ", found " << solver.matchcount << "\n";
+
+    stats.steps += solver.steps;
+    stats.triedcouples += solver.triedcouples;
+    stats.matchedcouples += solver.matchedcouples;
+    if (solver.first_only && solver.matchcount > 0)
+        stats.matchcount += (strategy.symmetry == SY_DISTINCT) ? 1 : symmetry->aut_size;
+    else
+        stats.matchcount += solver.matchcount;
+};
+
+/*
+ * Runs the solver kind on a prepared solver. The options of the search loops are template arguments of
+ * the solvers, run_solver picks the instantiation of the options set in the solver once per reference.
+ */
+template <bool Backjump, bool Forward, bool Cache, bool KeepNeighs>
+inline void run_solver(Solver *solver, SOLVER_KIND solverkind, MATCH_TYPE matchtype) {
+    switch (solverkind) {
+    case SK_0:
+        solver->solve();
+        break;
+    case SK_ED:
+        solver->SolveEd();
+        break;
+    case SK_DP:
+        solver->solve_rp<Backjump, Forward, Cache, KeepNeighs>();
+        break;
+    case SK_FF:
+        solver->solve_ff();
+        break;
+    case SK_TD:
+        // trees are not checked against the induced constraints
+        if (matchtype == MT_MONO)
+            solver->SolveTrees<Backjump, Forward, Cache, KeepNeighs>();
+        else
+            solver->solve_rp<Backjump, Forward, Cache, KeepNeighs>();
+        break;
+    case SK_CS:
+        // the components are not independent under the induced constraints
+        if (matchtype == MT_MONO)
+            solver->SolveComponents<Backjump, Forward, Cache, KeepNeighs>();
+        else
+            solver->solve_rp<Backjump, Forward, Cache, KeepNeighs>();
+        break;
+    case SK_LF:
+    default:
+        solver->SolveLeafs<KeepNeighs>();
+        break;
+    }
+}
+
+template <bool Backjump, bool Forward, bool Cache>
+inline void run_solver_keep(Solver *solver, SOLVER_KIND solverkind, MATCH_TYPE matchtype) {
+    // the cache is only set for the monomorphisms, which do not keep the neighbour counts
+    if (solver->keep_neighs)
+        run_solver<Backjump, Forward, false, true>(solver, solverkind, matchtype);
+    else
+        run_solver<Backjump, Forward, Cache, false>(solver, solverkind, matchtype);
+}
+
+template <bool Backjump, bool Forward>
+inline void run_solver_cache(Solver *solver, SOLVER_KIND solverkind, MATCH_TYPE matchtype) {
+    if (solver->cache_bytes > 0)
+        run_solver_keep<Backjump, Forward, true>(solver, solverkind, matchtype);
+    else
+        run_solver_keep<Backjump, Forward, false>(solver, solverkind, matchtype);
+}
+
+template <bool Backjump>
+inline void run_solver_forward(Solver *solver, SOLVER_KIND solverkind, MATCH_TYPE matchtype) {
+    if (solver->forward)
+        run_solver_cache<Backjump, true>(solver, solverkind, matchtype);
+    else
+        run_solver_cache<Backjump, false>(solver, solverkind, matchtype);
+}
+
+inline void run_solver(Solver *solver, SOLVER_KIND solverkind, MATCH_TYPE matchtype) {
+    if (solver->backjump)
+        run_solver_forward<true>(solver, solverkind, matchtype);
+    else
+        run_solver_forward<false>(solver, solverkind, matchtype);
+}
+
+/*
+ * Match the query against one reference graph, the log goes to out and the counters are accumulated in stats.
+ * With a symmetry mode, symmetry holds the orbits of the query, the listener only gets one embedding per orbit.
+ */
+inline void match_reference(MATCH_TYPE matchtype, Strategy &strategy, Graph *query, Graph *rrg, AttributeComparator *nodeComparator,
+                     AttributeComparator *edgeComparator, MatchListener *matchListener, Arena *arena, std::ostream &out, MatchStats &stats,
+                     QuerySymmetry *symmetry = NULL, Deadline *deadline = NULL) {
+    bool doBijIso = (matchtype == MT_ISO);
+    double t_tmp = 0;
+
+    if (deadline != NULL && deadline->expired)
+        return;
+
+    if (doBijIso) {
+        if (query->nof_nodes == rrg->nof_nodes)
+            match_isomorphism(strategy, query, rrg, nodeComparator, edgeComparator, matchListener, out, stats, symmetry, deadline);
+        return;
+    }
+
+    // initialize domains
+    sbitset *domains = new sbitset[query->nof_nodes];
+
+    out << "initializing domain...\n";
+    bool domok = init_domains(*rrg, *query, *nodeComparator, *edgeComparator, domains, doBijIso, strategy.node_d_conv, strategy.nlf);
+    if (domok && strategy.neighbour_rounds > 0) {
+        out << "neighbour refinement\n";
+        domok = refine_domains_by_neighbours(*rrg, *query, *edgeComparator, domains, strategy.neighbour_rounds);
+    }
+
+    // if domain constraints are satisfied (at least one compatible target node for each query node)
+    if (domok) {
+        out << "domain ok\n";
+        out << "initializing edge domain...\n";
+
+        EdgeDomains edomains;
+        out << "edomain init\n";
+        init_edomains(*rrg, *query, domains, *edgeComparator, edomains);
+
+#ifdef MDEBUG
+        print_domains(*query, *rrg, domains, edomains);
+#endif
+
+        if (strategy.reduce_path_length > 0) {
+            DomainReduction dr(*query, domains, edomains, rrg->nof_nodes, strategy.edge_d_conv);
+            out << "edomain reduction\n";
+            dr.reduce_by_paths(strategy.reduce_path_length);
+            // dr.reduce_by_paths(query->nof_nodes+1);
+            out << "edomain refinement\n";
+            dr.final_refinement();
+            out << "edomain done\n";
+        }
+
+#ifdef MDEBUG
+        print_domains(*query, *rrg, domains, edomains);
+#endif
+
+        // just get the domain size for each query node
+        int *domains_size = arena->alloc<int>(query->nof_nodes);
+        int dsize;
+        for (int ii = 0; ii < query->nof_nodes; ii++) {
+            dsize = 0;
+            for (sbitset::iterator IT = domains[ii].first_ones(); IT != domains[ii].end(); IT.next_ones()) {
+                dsize++;
+            }
+            domains_size[ii] = dsize;
+        }
+
+        // build the static matching machine
+        MatchingMachine *mama;
+        MAMA_KIND mamakind = strategy.mama;
+        SOLVER_KIND solverkind = strategy.solver;
+        if (strategy.auto_select) {
+            mama = select_matching_machine(matchtype, *query, domains, domains_size, edomains, *nodeComparator, *edgeComparator, out,
+                                           mamakind, solverkind);
+        } else {
+            mama = make_matching_machine(strategy.mama, *query, domains, domains_size, edomains, *nodeComparator, *edgeComparator);
+            mama->build(*query);
+            mama->fix_eids(*query);
+        }
+        // the leaf and tree solvers need the leafs and trees of their own machine at the end of the order,
+        // the fail-first solver chooses its own order
+        if (strategy.probes > 0 && solverkind != SK_LF && solverkind != SK_TD && solverkind != SK_FF) {
+            mama = select_sampled_machine(mama, mamakind, *query, *rrg, domains, domains_size, edomains, *nodeComparator, *edgeComparator,
+                                          strategy.probes, out);
+        }
+
+        // leafs and trees of the leaf and tree solvers are combined without the conditions,
+        // the components of the component solver are counted apart so no condition may join two of them
+        long sym_kept = 1, sym_dropped = 1;
+        bool sym_distinct = false;
+        if (strategy.symmetry != SY_OFF && symmetry != NULL) {
+            bool counted = (solverkind == SK_LF || solverkind == SK_TD);
+            int nof_free = (solverkind == SK_CS && matchtype == MT_MONO) ? 0 : counted ? mama->nof_sn - mama->nof_leafs : mama->nof_sn;
+            symmetry->break_symmetry(*mama, nof_free, sym_kept, sym_dropped);
+            sym_distinct = (strategy.symmetry == SY_DISTINCT) && symmetry->complete;
+            out << "symmetry: automorphisms " << symmetry->aut_size << (symmetry->complete ? "" : " at least") << ", broken " << sym_kept
+                << ", counting " << (sym_distinct ? "subgraphs" : "embeddings") << "\n";
+        }
+
+        out << ":time: make mama " << t_tmp << "\n";
+
+        out << "ordering: ";
+        for (int ii = 0; ii < mama->nof_sn; ii++) {
+            out << mama->map_state_to_node[ii] << "(" << domains_size[mama->map_state_to_node[ii]] << ") ";
+        }
+        out << "\n";
+        out << "domain sizes: ";
+        for (int ii = 0; ii < mama->nof_sn; ii++) {
+            out << ii << "[" << domains_size[ii] << "] ";
+        }
+        out << "\n";
+
+#ifdef MDEBUG
+        mama->print();
+        print_domains(*query, *rrg, domains, edomains);
+        print_domains_extended(*query, *rrg, domains, edomains);
+        out << "solving...\n";
+#endif
+
+        // prepare the matching phase
+        Solver *solver;
+        switch (matchtype) {
+        case MT_MONO:
+            solver = new SubGISolver(*mama, *rrg, *query, *nodeComparator, *edgeComparator, *matchListener, domains, domains_size, edomains, arena);
+            break;
+        case MT_INDSUB:
+        default:
+            solver = new InducedSubGISolver(*mama, *rrg, *query, *nodeComparator, *edgeComparator, *matchListener, domains, domains_size, edomains, arena);
+            break;
+        }
+
+        // run the matching phase
+        solver->match_limit = strategy.match_limit;
+        solver->deadline = deadline;
+        solver->backjump = strategy.backjump;
+        solver->forward = strategy.forward;
+        // edgesCheck of the induced solvers reads matched flags the cache does not log
+        if (matchtype == MT_MONO)
+            solver->cache_bytes = (long)strategy.cache_mb << 20;
+        run_solver(solver, solverkind, matchtype);
+
+        if (solver->cache_bytes > 0)
+            out << "cache: hits " << solver->cache_hits << ", misses " << solver->cache_misses << ", evictions " << solver->cache_evictions << "\n";
+
+        stats.steps += solver->steps;
+        stats.triedcouples += solver->triedcouples;
+        stats.matchedcouples += solver->matchedcouples;
+        if (sym_distinct)
+            stats.matchcount += solver->matchcount / sym_dropped;
+        else
+            stats.matchcount += solver->matchcount * sym_kept;
+
+        delete solver;
+        delete mama;
+#ifdef MDEBUG
+        out << "done\n";
+#endif
+    }
+
+    delete[] domains;
+    // the scratch of this graph is not needed anymore
+    arena->reset();
+};
+
+// reference graphs of one file kept in memory, together with their indexes
+struct ReferenceSet {
+    std::string file;
+    std::vector<Graph *> graphs;
+    DBIndex *dbindex;     // NULL if the index is not used
+    PathIndex *pathindex; // NULL if the path index is not used
+
+    ReferenceSet() {
+        dbindex = NULL;
+        pathindex = NULL;
+    }
+    ~ReferenceSet() {
+        for (size_t gi = 0; gi < graphs.size(); gi++)
+            delete graphs[gi];
+        delete dbindex;
+        delete pathindex;
+    }
+};
+
+// read every graph of the reference file, in file order, and the indexes requested by the options
+inline int load_reference_set(const std::string &referencefile, GRAPH_FILE_TYPE filetype, MatchOptions &options, ReferenceSet &references, std::ostream &log) {
+    references.file = referencefile;
+    FileReader *fd = open_file(referencefile.c_str(), filetype);
+    if (fd == NULL)
+        return -1;
+    int ret = 0;
+    while (ret == 0 && fd->has_next()) {
+        Graph *rrg = new Graph();
+        ret = read_dbgraph(referencefile.c_str(), fd, rrg, filetype);
+        references.graphs.push_back(rrg);
+    }
+    fd->close();
+    delete fd;
+    if (ret != 0)
+        return ret;
+
+    if (options.use_index) {
+        references.dbindex = open_dbindex(referencefile.c_str(), filetype, log);
+        if (references.dbindex != NULL && references.dbindex->size() != (int)references.graphs.size()) {
+            delete references.dbindex;
+            references.dbindex = NULL;
+        }
+        if (references.dbindex == NULL) {
+            log << "unable to build the db index, scanning the whole reference file\n";
+        } else {
+            references.pathindex = open_references_pathindex(referencefile, filetype, references.dbindex, options, log);
+        }
+    }
+    return 0;
+};
+
+// per thread state of the matching: the scratch memory of the solver, reused query after query
+class Session {
+    std::ostream discard;
+
+  public:
+    Arena arena;
+    std::vector<int> candidates;
+    std::ostream *log; // the matching log, discarded if NULL
+    Deadline deadline; // matches stop once it is over, not set by default
+
+    Session() : discard(NULL) { log = NULL; }
+
+    std::ostream &log_stream() { return log != NULL ? *log : discard; }
+};
+
+class Engine {
+  public:
+    GRAPH_FILE_TYPE filetype;
+    MatchOptions options;
+    AttributeComparator *nodeComparator; // to compare node labels
+    AttributeComparator *edgeComparator; // to compare edges labels
+    std::vector<ReferenceSet *> references;
+
+    Engine(GRAPH_FILE_TYPE _filetype, const MatchOptions &_options) : filetype(_filetype), options(_options) {
+        make_comparators(filetype, nodeComparator, edgeComparator);
+    }
+
+    ~Engine() {
+        for (size_t ri = 0; ri < references.size(); ri++)
+            delete references[ri];
+        delete nodeComparator;
+        delete edgeComparator;
+    }
+
+    // load a reference file, returns its id or -1 if it cannot be read
+    int load_reference(const std::string &referencefile, std::ostream &log) {
+        ReferenceSet *rs = new ReferenceSet();
+        if (load_reference_set(referencefile, filetype, options, *rs, log) != 0) {
+            delete rs;
+            return -1;
+        }
+        references.push_back(rs);
+        return (int)references.size() - 1;
+    }
+
+    // add a reference made of in memory graphs (see GraphBuilder.h), which the engine takes the ownership of.
+    // The indexes requested by the options are built in memory. Returns the id of the reference
+    int add_reference(const std::string &name, std::vector<Graph *> &graphs) {
+        ReferenceSet *rs = new ReferenceSet();
+        rs->file = name;
+        rs->graphs = graphs;
+        if (options.use_index) {
+            rs->dbindex = new DBIndex();
+            rs->dbindex->filetype = filetype;
+            for (size_t gi = 0; gi < graphs.size(); gi++) {
+                GraphSummary summary;
+                summarize_graph(*graphs[gi], summary);
+                rs->dbindex->entries.push_back(summary);
+            }
+            if (options.path_length > 0) {
+                rs->pathindex = new PathIndex();
+                rs->pathindex->filetype = filetype;
+                rs->pathindex->max_length = options.path_length;
+                path_feature_set features;
+                for (size_t gi = 0; gi < graphs.size(); gi++) {
+                    features.clear();
+                    compute_path_features(*graphs[gi], options.path_length, features);
+                    for (path_feature_set::iterator it = features.begin(); it != features.end(); it++) {
+                        rs->pathindex->postings[*it].push_back((int)gi);
+                    }
+                }
+                rs->pathindex->nof_graphs = (int)graphs.size();
+            }
+        }
+        references.push_back(rs);
+        return (int)references.size() - 1;
+    }
+
+    int nof_references() { return (int)references.size(); }
+
+    ReferenceSet &reference(int ref) { return *references[ref]; }
+
+    // takes the ownership of the graph
+    void prepare(Graph *query, PreparedQuery &prepared) {
+        prepared.prepare(query, options);
+        if (options.strategy.symmetry != SY_OFF)
+            prepared.prepare_symmetry(*nodeComparator, *edgeComparator);
+    }
+
+    int prepare_file(const char *queryfile, PreparedQuery &prepared) {
+        Graph *query = new Graph();
+        int ret = read_graph(queryfile, query, filetype);
+        if (ret != 0) {
+            delete query;
+            return ret;
+        }
+        prepare(query, prepared);
+        return 0;
+    }
+
+    int prepare_buffer(const char *data, long size, PreparedQuery &prepared) {
+        Graph *query = new Graph();
+        int ret = read_graph_buffer(data, size, query, filetype);
+        if (ret != 0) {
+            delete query;
+            return ret;
+        }
+        prepare(query, prepared);
+        return 0;
+    }
+
+    // match a query against the graphs of a reference, returns the number of graphs skipped by the indexes
+    long match(Session &session, PreparedQuery &query, int ref, MATCH_TYPE matchtype, Strategy &strategy, MatchListener &matchListener,
+               MatchStats &stats) {
+        ReferenceSet &rs = *references[ref];
+        std::vector<int> &candidates = session.candidates;
+        long skippedgraphs = 0;
+        if (rs.dbindex != NULL) {
+            skippedgraphs = select_candidates(query, rs.dbindex, rs.pathindex, (matchtype == MT_ISO), candidates);
+        } else {
+            candidates.clear();
+            for (int gi = 0; gi < (int)rs.graphs.size(); gi++) {
+                candidates.push_back(gi);
+            }
+        }
+
+        // queries prepared without the symmetries
+        QuerySymmetry *symmetry = query.symmetry;
+        QuerySymmetry own_symmetry;
+        if (strategy.symmetry != SY_OFF && symmetry == NULL) {
+            own_symmetry.compute(*query.graph, *nodeComparator, *edgeComparator);
+            symmetry = &own_symmetry;
+        }
+
+        for (size_t ci = 0; ci < candidates.size() && !session.deadline.expired; ci++) {
+            match_reference(matchtype, strategy, query.graph, rs.graphs[candidates[ci]], nodeComparator, edgeComparator, &matchListener,
+                            &session.arena, session.log_stream(), stats, symmetry, &session.deadline);
+        }
+        return skippedgraphs;
+    }
+
+    // with the strategy of the engine options
+    long match(Session &session, PreparedQuery &query, int ref, MATCH_TYPE matchtype, MatchListener &matchListener, MatchStats &stats) {
+        return match(session, query, ref, matchtype, options.strategy, matchListener, stats);
+    }
+
+    long match(Session &session, PreparedQuery &query, int ref, MATCH_TYPE matchtype, CallbackMatchListener::match_callback on_match,
+               MatchStats &stats) {
+        CallbackMatchListener matchListener(on_match);
+        return match(session, query, ref, matchtype, matchListener, stats);
+    }
+};
+
+} // namespace rilib
+
+#endif /* ENGINE_H_ */
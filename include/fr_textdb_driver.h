@@ -54,12 +54,12 @@ int read_gfd(const char *fileName, FileReader *fd, Graph *graph);
 int read_egfu(const char *fileName, FileReader *fd, Graph *graph);
 int read_egfd(const char *fileName, FileReader *fd, Graph *graph);
 
-FileReader *open_file(const char *filename, enum GRAPH_FILE_TYPE type) {
+inline FileReader *open_file(const char *filename, enum GRAPH_FILE_TYPE type) {
     FileReader *fd = new FileReader(filename);
     return fd;
 };
 
-int read_dbgraph(const char *filename, FileReader *fd, Graph *g, enum GRAPH_FILE_TYPE type) {
+inline int read_dbgraph(const char *filename, FileReader *fd, Graph *g, enum GRAPH_FILE_TYPE type) {
     int ret = 0;
     switch (type) {
     case GFT_GFU:
@@ -79,7 +79,7 @@ int read_dbgraph(const char *filename, FileReader *fd, Graph *g, enum GRAPH_FILE
     return ret;
 };
 
-int read_graph(const char *filename, Graph *g, enum GRAPH_FILE_TYPE type) {
+inline int read_graph(const char *filename, Graph *g, enum GRAPH_FILE_TYPE type) {
     FileReader *fd = new FileReader(filename);
     if (fd == NULL) {
         printf("ERROR: Cannot open input file %s\n", filename);
@@ -106,13 +106,86 @@ int read_graph(const char *filename, Graph *g, enum GRAPH_FILE_TYPE type) {
     return ret;
 };
 
+// next token of a graph text, false at the end of the data
+inline bool next_graph_token(const char *data, long size, long &pos, long &begin, long &end) {
+    while (pos < size && (data[pos] == ' ' || data[pos] == '\n' || data[pos] == '\t' || data[pos] == '\r'))
+        pos++;
+    begin = pos;
+    while (pos < size && data[pos] != ' ' && data[pos] != '\n' && data[pos] != '\t' && data[pos] != '\r')
+        pos++;
+    end = pos;
+    return begin < end;
+};
+
+// next token as a number lower than limit
+inline bool next_graph_number(const char *data, long size, long &pos, long limit, long &value) {
+    long begin, end;
+    if (!next_graph_token(data, size, pos, begin, end) || end - begin > 9)
+        return false;
+    value = 0;
+    for (long i = begin; i < end; i++) {
+        if (data[i] < '0' || data[i] > '9')
+            return false;
+        value = value * 10 + (data[i] - '0');
+    }
+    return value < limit;
+};
+
+/*
+ * The readers trust their input: a graph received from a client is checked first.
+ * Every count must be a number, every edge endpoint a node, and no token may be missing.
+ */
+inline bool check_graph_text(const char *data, long size, enum GRAPH_FILE_TYPE type) {
+    long pos = 0, begin, end, nof_nodes, nof_edges, node;
+    bool edge_labels = (type == GFT_EGFU || type == GFT_EGFD);
+    if (!next_graph_token(data, size, pos, begin, end) || !next_graph_number(data, size, pos, 1000000000L, nof_nodes))
+        return false;
+    for (long i = 0; i < nof_nodes; i++) {
+        if (!next_graph_token(data, size, pos, begin, end))
+            return false;
+    }
+    if (!next_graph_number(data, size, pos, 1000000000L, nof_edges))
+        return false;
+    for (long i = 0; i < nof_edges; i++) {
+        if (!next_graph_number(data, size, pos, nof_nodes, node) || !next_graph_number(data, size, pos, nof_nodes, node))
+            return false;
+        if (edge_labels && !next_graph_token(data, size, pos, begin, end))
+            return false;
+    }
+    return true;
+};
+
+// read a graph held in memory, in one of the text formats, -1 if it is malformed
+inline int read_graph_buffer(const char *data, long size, Graph *g, enum GRAPH_FILE_TYPE type) {
+    if (!check_graph_text(data, size, type))
+        return -1;
+    FileReader *fd = new FileReader(data, size);
+    int ret = read_dbgraph("buffer", fd, g, type);
+    fd->close();
+    delete fd;
+    return ret;
+};
+
 struct gr_neighs_t {
   public:
     int nid;
     gr_neighs_t *next;
 };
 
-int read_gfu(const char *fileName, FileReader *fd, Graph *graph) {
+// release the temporary adjacency lists built by the readers (the labels are moved to the graph)
+template <typename T> void free_neighs(T **ns, int nof_nodes) {
+    for (int i = 0; i < nof_nodes; i++) {
+        T *n = ns[i];
+        while (n != NULL) {
+            T *p = n;
+            n = n->next;
+            free(p);
+        }
+    }
+    free(ns);
+}
+
+inline int read_gfu(const char *fileName, FileReader *fd, Graph *graph) {
     //TIMEHANDLE time_s;
     //double time_e;
 
@@ -211,33 +284,9 @@ int read_gfu(const char *fileName, FileReader *fd, Graph *graph) {
     //std::cout << ":rtime: data structures " << time_e << "\n";
     //time_s = start_time();
 
-    for (int i = 0; i < graph->nof_nodes; i++) {
-        if (ns_o[i] != NULL) {
-            gr_neighs_t *p = NULL;
-            gr_neighs_t *n = ns_o[i];
-            for (j = 0; j < graph->out_adj_sizes[i]; j++) {
-                if (p != NULL)
-                    free(p);
-                p = n;
-                n = n->next;
-            }
-            if (p != NULL)
-                free(p);
-        }
-
-        if (ns_i[i] != NULL) {
-            gr_neighs_t *p = NULL;
-            gr_neighs_t *n = ns_i[i];
-            for (j = 0; j < graph->out_adj_sizes[i]; j++) {
-                if (p != NULL)
-                    free(p);
-                p = n;
-                n = n->next;
-            }
-            if (p != NULL)
-                free(p);
-        }
-    }
+    free_neighs(ns_o, graph->nof_nodes);
+    free_neighs(ns_i, graph->nof_nodes);
+    free(ink);
 
     //time_e = end_time(time_s);
     //std::cout << ":rtime: free " << time_e << "\n";
@@ -245,7 +294,7 @@ int read_gfu(const char *fileName, FileReader *fd, Graph *graph) {
     return 0;
 };
 
-int read_gfd(const char *fileName, FileReader *fd, Graph *graph) {
+inline int read_gfd(const char *fileName, FileReader *fd, Graph *graph) {
     char str[STR_READ_LENGTH];
     int i, j;
 
@@ -317,6 +366,11 @@ int read_gfd(const char *fileName, FileReader *fd, Graph *graph) {
         }
     }
 
+
+    free_neighs(ns_o, graph->nof_nodes);
+    free_neighs(ns_i, graph->nof_nodes);
+    free(ink);
+
     return 0;
 };
 
@@ -327,7 +381,7 @@ struct egr_neighs_t {
     std::string *label;
 };
 
-int read_egfu(const char *fileName, FileReader *fd, Graph *graph) {
+inline int read_egfu(const char *fileName, FileReader *fd, Graph *graph) {
     char str[STR_READ_LENGTH];
     int i, j;
 
@@ -421,39 +475,17 @@ int read_egfu(const char *fileName, FileReader *fd, Graph *graph) {
         }
     }
 
-    for (int i = 0; i < graph->nof_nodes; i++) {
-        if (ns_o[i] != NULL) {
-            egr_neighs_t *p = NULL;
-            egr_neighs_t *n = ns_o[i];
-            for (j = 0; j < graph->out_adj_sizes[i]; j++) {
-                if (p != NULL)
-                    free(p);
-                p = n;
-                n = n->next;
-            }
-            if (p != NULL)
-                free(p);
-        }
-
-        if (ns_i[i] != NULL) {
-            egr_neighs_t *p = NULL;
-            egr_neighs_t *n = ns_i[i];
-            for (j = 0; j < graph->out_adj_sizes[i]; j++) {
-                if (p != NULL)
-                    free(p);
-                p = n;
-                n = n->next;
-            }
-            if (p != NULL)
-                free(p);
-        }
-    }
+    free_neighs(ns_o, graph->nof_nodes);
+    free_neighs(ns_i, graph->nof_nodes);
+    free(ink);
 
     return 0;
 };
 
-int read_egfd(const char *fileName, FileReader *fd, Graph *graph) {
+inline int read_egfd(const char *fileName, FileReader *fd, Graph *graph) {
+#ifdef MDEBUG
     std::cout << "reading............\n";
+#endif
 
     char str[STR_READ_LENGTH];
     int i, j;
@@ -531,6 +563,11 @@ int read_egfd(const char *fileName, FileReader *fd, Graph *graph) {
         }
     }
 
+
+    free_neighs(ns_o, graph->nof_nodes);
+    free_neighs(ns_i, graph->nof_nodes);
+    free(ink);
+
     return 0;
 };
 
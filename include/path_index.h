@@ -0,0 +1,282 @@
+/*
+ * path_index.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef PATH_INDEX_H_
+#define PATH_INDEX_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "FileReader.h"
+#include "Graph.h"
+#include "fr_textdb_driver.h"
+
+/*
+ * Path-feature inverted index over a reference database.
+ * Every simple path of at most max_length edges is turned into the sequence of
+ * its node and edge labels and hashed to a feature id. For each feature the
+ * index keeps the sorted list of the graphs having it.
+ * A graph containing the query also contains all the labelled simple paths of
+ * the query, so intersecting the lists of the query features gives a superset
+ * of the graphs to be matched (hash collisions may only add false candidates).
+ */
+
+#define PATHINDEX_MAGIC "ARCMATCH_PATHINDEX"
+#define PATHINDEX_VERSION 2
+#define PATHINDEX_SUFFIX ".apidx"
+
+namespace rilib {
+
+typedef uint64_t path_feature_t;
+typedef std::unordered_set<path_feature_t> path_feature_set;
+
+#define PATH_FEATURE_SEED 14695981039346656037ULL
+#define PATH_FEATURE_PRIME 1099511628211ULL
+
+// FNV-1a, labels are separated by a byte which can not appear inside a label
+inline path_feature_t path_feature_push(path_feature_t h, void *attr) {
+    if (attr != NULL) {
+        std::string *label = (std::string *)attr;
+        for (size_t i = 0; i < label->size(); i++) {
+            h ^= (unsigned char)(*label)[i];
+            h *= PATH_FEATURE_PRIME;
+        }
+    }
+    h ^= 0xff;
+    h *= PATH_FEATURE_PRIME;
+    return h;
+};
+
+inline void path_features_dfs(Graph &g, int n, int level, int max_length, path_feature_t h, bool *visited, path_feature_set &features) {
+    features.insert(h);
+    if (level == max_length)
+        return;
+
+    visited[n] = true;
+    for (int i = 0; i < g.out_adj_sizes[n]; i++) {
+        int m = g.out_adj_list[n][i];
+        if (!visited[m]) {
+            path_feature_t hm = path_feature_push(h, g.out_adj_attrs[n][i]);
+            hm = path_feature_push(hm, g.nodes_attrs[m]);
+            path_features_dfs(g, m, level + 1, max_length, hm, visited, features);
+        }
+    }
+    visited[n] = false;
+};
+
+/*
+ * Features of all the simple paths with at most max_length edges, following out edges.
+ */
+inline void compute_path_features(Graph &g, int max_length, path_feature_set &features) {
+    bool *visited = (bool *)calloc(g.nof_nodes, sizeof(bool));
+    for (int n = 0; n < g.nof_nodes; n++) {
+        path_features_dfs(g, n, 0, max_length, path_feature_push(PATH_FEATURE_SEED, g.nodes_attrs[n]), visited, features);
+    }
+    free(visited);
+};
+
+class PathIndex {
+  public:
+    int filetype;
+    FileStamp db; // the db file the index was built from
+    int max_length;
+    int nof_graphs;
+    std::map<path_feature_t, std::vector<int>> postings; // feature -> sorted graph ids
+
+    PathIndex() {
+        filetype = -1;
+        max_length = 0;
+        nof_graphs = 0;
+    }
+
+    /*
+     * Graph ids having all the given features, in increasing order.
+     */
+    void candidates(path_feature_set &features, std::vector<int> &result) {
+        result.clear();
+
+        std::vector<std::vector<int> *> lists;
+        for (path_feature_set::iterator it = features.begin(); it != features.end(); it++) {
+            std::map<path_feature_t, std::vector<int>>::iterator pit = postings.find(*it);
+            if (pit == postings.end())
+                return;
+            lists.push_back(&(pit->second));
+        }
+
+        if (lists.empty()) {
+            for (int i = 0; i < nof_graphs; i++)
+                result.push_back(i);
+            return;
+        }
+
+        std::sort(lists.begin(), lists.end(), [](std::vector<int> *a, std::vector<int> *b) { return a->size() < b->size(); });
+
+        result = *(lists[0]);
+        std::vector<int> tmp;
+        for (size_t l = 1; l < lists.size() && !result.empty(); l++) {
+            tmp.clear();
+            std::set_intersection(result.begin(), result.end(), lists[l]->begin(), lists[l]->end(), std::back_inserter(tmp));
+            result.swap(tmp);
+        }
+    }
+
+    bool save(const char *filename) {
+        std::ofstream os(filename);
+        if (!os.is_open())
+            return false;
+
+        os << PATHINDEX_MAGIC << " " << PATHINDEX_VERSION << " " << filetype << " " << db.size << " " << db.mtime << " " << db.checksum << " " << max_length << " " << nof_graphs << " " << postings.size() << "\n";
+        for (std::map<path_feature_t, std::vector<int>>::iterator it = postings.begin(); it != postings.end(); it++) {
+            os << it->first << " " << it->second.size();
+            // gaps between consecutive ids keep the file small
+            int prev = 0;
+            for (size_t i = 0; i < it->second.size(); i++) {
+                os << " " << (it->second[i] - prev);
+                prev = it->second[i];
+            }
+            os << "\n";
+        }
+        return os.good();
+    }
+
+    bool load(const char *filename) {
+        std::ifstream is(filename);
+        if (!is.is_open())
+            return false;
+
+        std::string magic;
+        int version;
+        size_t nof_features;
+        is >> magic >> version >> filetype >> db.size >> db.mtime >> db.checksum >> max_length >> nof_graphs >> nof_features;
+        if (!is.good() || magic != PATHINDEX_MAGIC || version != PATHINDEX_VERSION)
+            return false;
+
+        postings.clear();
+        path_feature_t f;
+        size_t n;
+        int gap;
+        for (size_t i = 0; i < nof_features; i++) {
+            is >> f >> n;
+            std::vector<int> &list = postings[f];
+            list.resize(n);
+            int prev = 0;
+            for (size_t j = 0; j < n; j++) {
+                is >> gap;
+                prev += gap;
+                list[j] = prev;
+            }
+            if (is.fail())
+                return false;
+        }
+        return true;
+    }
+};
+
+inline int build_pathindex(const char *filename, enum GRAPH_FILE_TYPE type, const FileStamp &db, int max_length, PathIndex &index) {
+    FileReader *fd = open_file(filename, type);
+    if (fd == NULL)
+        return -1;
+
+    index.filetype = type;
+    index.db = db;
+    index.max_length = max_length;
+    index.nof_graphs = 0;
+    index.postings.clear();
+
+    path_feature_set features;
+    while (fd->has_next()) {
+        Graph *g = new Graph();
+        int ret = read_dbgraph(filename, fd, g, type);
+        if (ret != 0) {
+            delete g;
+            fd->close();
+            delete fd;
+            return ret;
+        }
+
+        features.clear();
+        compute_path_features(*g, max_length, features);
+        delete g;
+        for (path_feature_set::iterator it = features.begin(); it != features.end(); it++) {
+            index.postings[*it].push_back(index.nof_graphs);
+        }
+        index.nof_graphs++;
+    }
+
+    fd->close();
+    delete fd;
+    return 0;
+};
+
+inline std::string pathindex_filename(const char *dbfilename) { return std::string(dbfilename) + PATHINDEX_SUFFIX; };
+
+/*
+ * Load the path index of a db file, (re)building it if it is missing, built for
+ * a different path length or stale, that is if it was not built from the db file
+ * of stamp db, the one checked by open_dbindex. Progress goes to log.
+ */
+inline PathIndex *open_pathindex(const char *dbfilename, enum GRAPH_FILE_TYPE type, const FileStamp &db, int max_length, std::ostream &log) {
+    std::string idxfile = pathindex_filename(dbfilename);
+
+    PathIndex *index = new PathIndex();
+    if (index->load(idxfile.c_str()) && index->filetype == type && index->max_length == max_length && index->db.size == db.size &&
+        index->db.checksum == db.checksum) {
+        // the db file was only touched, as in open_dbindex
+        if (index->db.mtime != db.mtime) {
+            index->db.mtime = db.mtime;
+            if (!index->save(idxfile.c_str()))
+                log << "unable to write path index " << idxfile << "\n";
+        }
+        return index;
+    }
+
+    log << "building path index " << idxfile << "...\n";
+    if (build_pathindex(dbfilename, type, db, max_length, *index) != 0) {
+        delete index;
+        return NULL;
+    }
+    if (!index->save(idxfile.c_str())) {
+        log << "unable to write path index " << idxfile << "\n";
+    }
+    return index;
+};
+
+} // namespace rilib
+
+#endif /* PATH_INDEX_H_ */
@@ -0,0 +1,135 @@
+/*
+ * profile.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "Strategy.h"
+
+/*
+ * Strategy profiles, written by arcmatch-tune for a workload and loaded by
+ * -profile. A profile is a text file with a "key value" pair per line, lines
+ * starting with # are comments:
+ *
+ *   mama ns
+ *   solver dp
+ *   nodeconv 1
+ *   edgeconv 0
+ *   reduce 6
+ *
+ * Missing keys keep the value they had, the match limit is not part of a profile.
+ */
+
+namespace rilib {
+
+inline void write_profile(std::ostream &out, Strategy &strategy) {
+    out << "mama " << mama_kind_name(strategy.mama) << "\n";
+    out << "solver " << solver_kind_name(strategy.solver) << "\n";
+    out << "nodeconv " << (strategy.node_d_conv ? 1 : 0) << "\n";
+    out << "nlf " << (strategy.nlf ? 1 : 0) << "\n";
+    out << "neighbours " << strategy.neighbour_rounds << "\n";
+    out << "edgeconv " << (strategy.edge_d_conv ? 1 : 0) << "\n";
+    out << "reduce " << strategy.reduce_path_length << "\n";
+    out << "auto " << (strategy.auto_select ? 1 : 0) << "\n";
+    out << "probes " << strategy.probes << "\n";
+    out << "symmetry " << symmetry_mode_name(strategy.symmetry) << "\n";
+    out << "backjump " << (strategy.backjump ? 1 : 0) << "\n";
+    out << "forward " << (strategy.forward ? 1 : 0) << "\n";
+    out << "cache " << strategy.cache_mb << "\n";
+};
+
+// returns 0, -1 if the file cannot be read, or the number of the first bad line
+inline int read_profile(const char *file, Strategy &strategy) {
+    std::ifstream in(file);
+    if (!in.is_open())
+        return -1;
+    std::string line, key, value;
+    int lineno = 0;
+    while (std::getline(in, line)) {
+        lineno++;
+        std::istringstream fields(line);
+        if (!(fields >> key) || key[0] == '#')
+            continue;
+        if (!(fields >> value))
+            return lineno;
+        if (key == "mama") {
+            if (!parse_mama_kind(value, strategy.mama))
+                return lineno;
+        } else if (key == "solver") {
+            if (!parse_solver_kind(value, strategy.solver))
+                return lineno;
+        } else if (key == "nodeconv") {
+            strategy.node_d_conv = (atoi(value.c_str()) != 0);
+        } else if (key == "nlf") {
+            strategy.nlf = (atoi(value.c_str()) != 0);
+        } else if (key == "neighbours") {
+            strategy.neighbour_rounds = atoi(value.c_str());
+            if (strategy.neighbour_rounds < 0)
+                return lineno;
+        } else if (key == "edgeconv") {
+            strategy.edge_d_conv = (atoi(value.c_str()) != 0);
+        } else if (key == "reduce") {
+            strategy.reduce_path_length = atoi(value.c_str());
+            if (strategy.reduce_path_length < 0)
+                return lineno;
+        } else if (key == "auto") {
+            strategy.auto_select = (atoi(value.c_str()) != 0);
+        } else if (key == "probes") {
+            strategy.probes = atoi(value.c_str());
+            if (strategy.probes < 0)
+                return lineno;
+        } else if (key == "symmetry") {
+            if (!parse_symmetry_mode(value, strategy.symmetry))
+                return lineno;
+        } else if (key == "backjump") {
+            strategy.backjump = (atoi(value.c_str()) != 0);
+        } else if (key == "forward") {
+            strategy.forward = (atoi(value.c_str()) != 0);
+        } else if (key == "cache") {
+            strategy.cache_mb = atoi(value.c_str());
+            if (strategy.cache_mb < 0)
+                return lineno;
+        } else {
+            return lineno;
+        }
+    }
+    return 0;
+};
+
+} // namespace rilib
+
+#endif /* PROFILE_H_ */
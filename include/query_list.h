@@ -0,0 +1,125 @@
+/*
+ * query_list.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef QUERY_LIST_H_
+#define QUERY_LIST_H_
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * Queries of a batch run. The batch is given either as a directory, whose
+ * regular files are taken in name order, or as a text file listing one query
+ * file per line (blank lines and lines starting with # are skipped).
+ * Relative paths of a list are resolved against the directory of the list.
+ */
+
+namespace rilib {
+
+inline std::string parent_directory(const std::string &path) {
+    size_t p = path.find_last_of("/\\");
+    if (p == std::string::npos)
+        return "";
+    return path.substr(0, p + 1);
+};
+
+inline bool is_absolute_path(const std::string &path) {
+    if (path.empty())
+        return false;
+    if (path[0] == '/' || path[0] == '\\')
+        return true;
+    return path.size() > 1 && path[1] == ':';
+};
+
+#ifndef _WIN32
+inline int read_query_directory(const char *dirname, std::vector<std::string> &files) {
+    DIR *dir = opendir(dirname);
+    if (dir == NULL)
+        return -1;
+
+    std::string prefix(dirname);
+    if (prefix[prefix.size() - 1] != '/')
+        prefix += "/";
+
+    std::vector<std::string> names;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::string file = prefix + entry->d_name;
+        struct stat st;
+        if (stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            names.push_back(file);
+        }
+    }
+    closedir(dir);
+
+    std::sort(names.begin(), names.end());
+    files.insert(files.end(), names.begin(), names.end());
+    return 0;
+};
+#endif
+
+inline int read_query_list(const char *path, std::vector<std::string> &files) {
+#ifndef _WIN32
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+        return read_query_directory(path, files);
+#endif
+
+    std::ifstream in(path);
+    if (!in.is_open())
+        return -1;
+
+    std::string dir = parent_directory(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t b = line.find_first_not_of(" \t\r");
+        if (b == std::string::npos || line[b] == '#')
+            continue;
+        size_t e = line.find_last_not_of(" \t\r");
+        line = line.substr(b, e - b + 1);
+        files.push_back(is_absolute_path(line) ? line : dir + line);
+    }
+    return 0;
+};
+
+} // namespace rilib
+
+#endif /* QUERY_LIST_H_ */
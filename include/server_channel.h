@@ -0,0 +1,279 @@
+/*
+ * server_channel.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef SERVER_CHANNEL_H_
+#define SERVER_CHANNEL_H_
+
+/*
+ * Transport of the server mode: a bidirectional byte stream over a pair of
+ * file descriptors (a Unix domain socket, or stdin/stdout).
+ * Requests are text lines, optionally followed by a payload of a declared
+ * number of bytes; responses are written through a buffered std::ostream.
+ */
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+
+namespace rilib {
+
+// write all the bytes, retrying on partial writes
+inline bool write_fully(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t w = write(fd, data, size);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += w;
+        size -= w;
+    }
+    return true;
+};
+
+// output stream buffer writing to a file descriptor
+class fd_streambuf : public std::streambuf {
+    int fd;
+    char obuf[4096];
+
+  public:
+    fd_streambuf(int _fd) : fd(_fd) { setp(obuf, obuf + sizeof(obuf)); }
+
+    virtual ~fd_streambuf() { sync(); }
+
+  protected:
+    virtual int overflow(int c) {
+        if (sync() != 0)
+            return traits_type::eof();
+        if (c != traits_type::eof()) {
+            *pptr() = (char)c;
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual int sync() {
+        size_t n = pptr() - pbase();
+        if (n > 0 && !write_fully(fd, pbase(), n))
+            return -1;
+        setp(obuf, obuf + sizeof(obuf));
+        return 0;
+    }
+};
+
+// largest payload accepted from a client
+const size_t MAX_PAYLOAD_BYTES = (size_t)256 << 20;
+// longest request line accepted from a client
+const size_t MAX_LINE_BYTES = 4096;
+
+class Channel {
+    int in_fd;
+    char ibuf[4096];
+    size_t ipos, ilen;
+
+    fd_streambuf obuf;
+
+  public:
+    std::ostream out;
+
+    Channel(int _in_fd, int _out_fd) : in_fd(_in_fd), obuf(_out_fd), out(&obuf) {
+        ipos = 0;
+        ilen = 0;
+    }
+
+    // next request line, without the line terminator. 1 if read, 0 at the end of the stream, -1 if longer than MAX_LINE_BYTES
+    int read_line(std::string &line) {
+        line.clear();
+        while (true) {
+            if (ipos == ilen && !fill())
+                return line.empty() ? 0 : 1;
+            char c = ibuf[ipos++];
+            if (c == '\n')
+                break;
+            if (c != '\r') {
+                if (line.size() == MAX_LINE_BYTES)
+                    return -1;
+                line += c;
+            }
+        }
+        return 1;
+    }
+
+    // exactly size bytes of payload, false if it is larger than MAX_PAYLOAD_BYTES
+    bool read_bytes(size_t size, std::string &data) {
+        data.clear();
+        if (size > MAX_PAYLOAD_BYTES)
+            return false;
+        data.reserve(size);
+        while (data.size() < size) {
+            if (ipos == ilen && !fill())
+                return false;
+            size_t n = ilen - ipos;
+            if (n > size - data.size())
+                n = size - data.size();
+            data.append(ibuf + ipos, n);
+            ipos += n;
+        }
+        return true;
+    }
+
+  private:
+    bool fill() {
+        ssize_t r;
+        do {
+            r = read(in_fd, ibuf, sizeof(ibuf));
+        } while (r < 0 && errno == EINTR);
+        if (r <= 0)
+            return false;
+        ipos = 0;
+        ilen = (size_t)r;
+        return true;
+    }
+};
+
+// largest number of requests of one client that are queued or running
+const int MAX_PENDING_REPLIES = 64;
+
+/*
+ * Answers to the requests read from a Channel, which may be computed concurrently
+ * but are written in the order of the requests, one at a time.
+ * Each request reserves a slot, its answer is written once it and the answers to
+ * all the earlier requests are complete.
+ */
+class Replies {
+    Channel &ch;
+    std::mutex mtx;
+    std::condition_variable cv; // a slot was completed
+    std::deque<std::string> answers; // of the requests from first on
+    std::deque<bool> complete;
+    long first;
+
+  public:
+    Replies(Channel &_ch) : ch(_ch) { first = 0; }
+
+    // slot of the next request, waits while MAX_PENDING_REPLIES are pending
+    long reserve() {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return answers.size() < (size_t)MAX_PENDING_REPLIES; });
+        answers.push_back(std::string());
+        complete.push_back(false);
+        return first + (long)answers.size() - 1;
+    }
+
+    // the answer of slot id, written with those that were waiting for it
+    void answer(long id, std::string &text) {
+        std::unique_lock<std::mutex> lock(mtx);
+        answers[id - first].swap(text);
+        complete[id - first] = true;
+        if (id != first)
+            return;
+        while (!complete.empty() && complete.front()) {
+            ch.out << answers.front();
+            answers.pop_front();
+            complete.pop_front();
+            first++;
+        }
+        ch.out << std::flush;
+        cv.notify_all();
+    }
+
+    // waits until every answer is written
+    void wait() {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return answers.empty(); });
+    }
+};
+
+// bind and listen on a Unix domain socket, replacing a stale socket file. -1 on error, or if path is another kind of file
+inline int listen_unix_socket(const char *path, int backlog) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fputs("socket path too long\n", stderr);
+        return -1;
+    }
+
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "%s: exists and is not a socket\n", path);
+            return -1;
+        }
+        if (unlink(path) < 0) {
+            perror(path);
+            return -1;
+        }
+    } else if (errno != ENOENT) {
+        perror(path);
+        return -1;
+    }
+
+    int sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sfd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sfd, backlog) < 0) {
+        perror(path);
+        close(sfd);
+        return -1;
+    }
+    return sfd;
+};
+
+// a client hanging up must not kill the server
+inline void ignore_sigpipe() { signal(SIGPIPE, SIG_IGN); };
+
+} // namespace rilib
+
+#endif // _WIN32
+
+#endif /* SERVER_CHANNEL_H_ */
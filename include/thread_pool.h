@@ -0,0 +1,130 @@
+/*
+ * thread_pool.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rilib {
+
+/*
+ * Fixed size pool of worker threads consuming a FIFO of tasks.
+ * wait() blocks until every submitted task has been completed.
+ */
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+
+    std::mutex mtx;
+    std::condition_variable task_cv; // a task is available or the pool is stopping
+    std::condition_variable done_cv; // all the tasks are completed
+
+    int nof_pending; // queued plus running tasks
+    bool stopping;
+
+  public:
+    ThreadPool(int nof_threads) {
+        nof_pending = 0;
+        stopping = false;
+        if (nof_threads < 1)
+            nof_threads = 1;
+        for (int i = 0; i < nof_threads; i++) {
+            workers.push_back(std::thread(&ThreadPool::run, this));
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        task_cv.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+    }
+
+    int size() { return (int)workers.size(); }
+
+    void submit(std::function<void()> task) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            tasks.push_back(task);
+            nof_pending++;
+        }
+        task_cv.notify_one();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mtx);
+        done_cv.wait(lock, [this] { return nof_pending == 0; });
+    }
+
+    static int hardware_threads() {
+        int n = (int)std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+  private:
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                task_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = tasks.front();
+                tasks.pop_front();
+            }
+
+            task();
+
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                nof_pending--;
+                if (nof_pending == 0)
+                    done_cv.notify_all();
+            }
+        }
+    }
+};
+
+} // namespace rilib
+
+#endif /* THREAD_POOL_H_ */
@@ -0,0 +1,65 @@
+#!/bin/bash
+
+#regression checks of arcmatch: every case is matched with the given options and
+#alone with -solver dp, both counts must be equal to the expected one. The counts
+#which differ from the dp one (-symmetry distinct) are only matched with the options
+#usage: bash regression/run.sh [arcmatch binary]
+
+bin=${1:-./arcmatch}
+dir=$(dirname "$0")
+failed=0
+
+count(){
+	"$bin" "$@" 2>/dev/null | awk '/number of found matches/ {print $NF}'
+}
+
+#check name matchtype filetype reference query expected [options]
+check(){
+	name=$1; mt=$2; ft=$3; ref=$dir/$4; query=$dir/$5; expected=$6
+	shift 6
+	got=$(count $mt $ft $ref $query "$@")
+	dp=$(count $mt $ft $ref $query -solver dp)
+	if [ "$got" != "$expected" ] || [ "$dp" != "$expected" ]; then
+		echo "FAIL $name: $got matches, $dp by -solver dp, expected $expected"
+		failed=1
+	else
+		echo "ok $name"
+	fi
+}
+
+#check_alone name matchtype filetype reference query expected [options]
+check_alone(){
+	name=$1; mt=$2; ft=$3; ref=$dir/$4; query=$dir/$5; expected=$6
+	shift 6
+	got=$(count $mt $ft $ref $query "$@")
+	if [ "$got" != "$expected" ]; then
+		echo "FAIL $name: $got matches, expected $expected"
+		failed=1
+	else
+		echo "ok $name"
+	fi
+}
+
+#a directed leaf with arcs in both directions to its parent, the leaf solver used to check only one of them
+check leaf_reciprocal_lf mono gfd leaf_reciprocal_reference.gfd leaf_reciprocal_query.gfd 2 -mama nsl -solver lf
+check leaf_reciprocal_lf_c7 mono gfd leaf_reciprocal_reference.gfd leaf_reciprocal_query.gfd 2 -config 7
+check leaf_reciprocal_auto mono gfd leaf_reciprocal_reference.gfd leaf_reciprocal_query.gfd 2 -auto
+
+#random_reference: 100 nodes labelled A or B. symmetry_query: a cycle of four A (8 automorphisms).
+#trees_query: a triangle with trees, two B leaves of the same node share their candidates (2 automorphisms)
+check components_cycle mono gfu random_reference.gfu symmetry_query.gfu 368 -solver cs
+check components_trees mono gfu random_reference.gfu trees_query.gfu 8238 -solver cs
+check trees_dp mono gfu random_reference.gfu trees_query.gfu 8238 -mama nst -solver td
+check trees_dp_forward mono gfu random_reference.gfu trees_query.gfu 8238 -mama nst -solver td -backjump -forward
+check symmetry_emb_cycle mono gfu random_reference.gfu symmetry_query.gfu 368 -symmetry emb
+check symmetry_emb_cycle_ind ind gfu random_reference.gfu symmetry_query.gfu 328 -symmetry emb
+check symmetry_emb_trees mono gfu random_reference.gfu trees_query.gfu 8238 -symmetry emb
+check_alone symmetry_distinct_cycle mono gfu random_reference.gfu symmetry_query.gfu 46 -symmetry distinct
+check_alone symmetry_distinct_cycle_ind ind gfu random_reference.gfu symmetry_query.gfu 41 -symmetry distinct
+check_alone symmetry_distinct_trees mono gfu random_reference.gfu trees_query.gfu 4119 -symmetry distinct
+check_alone symmetry_distinct_trees_ind ind gfu random_reference.gfu trees_query.gfu 925 -solver dp -symmetry distinct
+#the cache reuses the counts of some subtrees of trees_query
+check cache_trees mono gfu random_reference.gfu trees_query.gfu 8238 -solver dp -cache 1
+check cache_trees_backjump mono gfu random_reference.gfu trees_query.gfu 8238 -solver dp -cache 1 -backjump
+
+exit $failed
@@ -0,0 +1,124 @@
+/*
+ * Arena.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace rilib {
+
+/*
+ * Bump allocator for the scratch arrays of the matching phase.
+ * reset() only rewinds the allocation point, blocks are kept and reused,
+ * so scanning a database costs the memory of the largest reference graph.
+ * No destructor is run: only plain data must be allocated here.
+ */
+class Arena {
+    struct Block {
+        char *data;
+        size_t size;
+    };
+
+    static const size_t min_block_size = 1 << 16;
+    static const size_t alignment = 16;
+
+    std::vector<Block> blocks;
+    size_t cblock; // block in use
+    size_t cpos;   // first free byte of the block in use
+
+  public:
+    Arena() {
+        cblock = 0;
+        cpos = 0;
+    }
+
+    ~Arena() {
+        for (size_t i = 0; i < blocks.size(); i++) {
+            free(blocks[i].data);
+        }
+    }
+
+    void *allocate(size_t bytes) {
+        bytes = (bytes + alignment - 1) & ~(alignment - 1);
+        if (bytes == 0)
+            bytes = alignment;
+
+        while (cblock < blocks.size()) {
+            if (cpos + bytes <= blocks[cblock].size) {
+                void *p = blocks[cblock].data + cpos;
+                cpos += bytes;
+                return p;
+            }
+            cblock++;
+            cpos = 0;
+        }
+
+        Block b;
+        b.size = blocks.empty() ? min_block_size : blocks.back().size * 2;
+        if (b.size < bytes)
+            b.size = bytes;
+        b.data = (char *)malloc(b.size);
+        blocks.push_back(b);
+        cblock = blocks.size() - 1;
+        cpos = bytes;
+        return b.data;
+    }
+
+    template <typename T> T *alloc(size_t n) { return (T *)allocate(n * sizeof(T)); }
+
+    template <typename T> T *zalloc(size_t n) {
+        T *p = alloc<T>(n);
+        memset(p, 0, n * sizeof(T));
+        return p;
+    }
+
+    // drop every allocation, the memory is kept for the next graph
+    void reset() {
+        cblock = 0;
+        cpos = 0;
+    }
+
+    size_t capacity() {
+        size_t c = 0;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            c += blocks[i].size;
+        }
+        return c;
+    }
+};
+
+} // namespace rilib
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,408 @@
+/*
+ * Automorphisms.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef AUTOMORPHISMS_H_
+#define AUTOMORPHISMS_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "AttributeComparator.h"
+#include "Graph.h"
+#include "MatchingMachine.h"
+
+/*
+ * Orbits of the automorphism group of a query, used to break its symmetries.
+ * A symmetric query (a cycle, a clique, a star) has |Aut| embeddings onto each
+ * of its occurrences in a reference graph, and the solvers enumerate all of them.
+ * The orbits are taken along a stabiliser chain: v1 is a node with a non trivial
+ * orbit O1 under Aut, v2 a node with a non trivial orbit O2 under the automorphisms
+ * fixing v1, and so on. Asking f(vi) < f(w) for each w of Oi keeps one embedding
+ * out of |Oi| at every level, so the conditions of any subset of the levels divide
+ * the embeddings found by the product of their orbit sizes, and the conditions of
+ * all the levels leave one embedding per distinct subgraph.
+ *
+ * The automorphisms mapping vi to each candidate w of its orbit are searched by
+ * colour refinement and backtracking, within a budget of arc visits.
+ */
+
+namespace rilib {
+
+// colour refinement and automorphism search on the arcs of a graph, with their label classes
+class AutomorphismSearch {
+    int n;
+    std::vector<int> node_class;
+    int nof_eclasses;
+    std::vector<int> out_offsets, in_offsets;
+    std::vector<std::pair<int, int> > out_arcs, in_arcs; // (neighbour, edge class), rows sorted
+    std::vector<long> sig;
+
+  public:
+    long work; // arc visits so far
+    long max_work;
+    bool aborted;
+
+    AutomorphismSearch(Graph &g, AttributeComparator &nodeComparator, AttributeComparator &edgeComparator, long _max_work) : max_work(_max_work) {
+        Graph *graphs[1] = {&g};
+        build(graphs, 1, nodeComparator, edgeComparator);
+    }
+
+    // the disjoint union of g and h, the nodes of h follow the ones of g and share their colours
+    AutomorphismSearch(Graph &g, Graph &h, AttributeComparator &nodeComparator, AttributeComparator &edgeComparator, long _max_work)
+        : max_work(_max_work) {
+        Graph *graphs[2] = {&g, &h};
+        build(graphs, 2, nodeComparator, edgeComparator);
+    }
+
+    void build(Graph **graphs, int nof_graphs, AttributeComparator &nodeComparator, AttributeComparator &edgeComparator) {
+        work = 0;
+        aborted = false;
+        n = 0;
+        for (int gi = 0; gi < nof_graphs; gi++)
+            n += graphs[gi]->nof_nodes;
+
+        // label classes: ranks in the order of the comparators
+        std::vector<void *> nattrs, eattrs;
+        std::vector<int> targets;
+        out_offsets.assign(n + 1, 0);
+        for (int gi = 0, first = 0; gi < nof_graphs; first += graphs[gi]->nof_nodes, gi++) {
+            Graph &g = *graphs[gi];
+            for (int i = 0; i < g.nof_nodes; i++) {
+                nattrs.push_back(g.nodes_attrs != NULL ? g.nodes_attrs[i] : NULL);
+                out_offsets[first + i + 1] = out_offsets[first + i] + g.out_adj_sizes[i];
+                for (int j = 0; j < g.out_adj_sizes[i]; j++) {
+                    eattrs.push_back(g.out_adj_attrs != NULL ? g.out_adj_attrs[i][j] : NULL);
+                    targets.push_back(first + g.out_adj_list[i][j]);
+                }
+            }
+        }
+        label_classes(nattrs, nodeComparator, node_class);
+        std::vector<int> eclass;
+        nof_eclasses = label_classes(eattrs, edgeComparator, eclass);
+
+        std::vector<int> in_sizes(n, 0);
+        out_arcs.resize(out_offsets[n]);
+        for (int i = 0; i < n; i++) {
+            for (int a = out_offsets[i]; a < out_offsets[i + 1]; a++) {
+                out_arcs[a] = std::pair<int, int>(targets[a], eclass[a]);
+                in_sizes[targets[a]]++;
+            }
+            std::sort(out_arcs.begin() + out_offsets[i], out_arcs.begin() + out_offsets[i + 1]);
+        }
+        in_offsets.assign(n + 1, 0);
+        for (int i = 0; i < n; i++)
+            in_offsets[i + 1] = in_offsets[i] + in_sizes[i];
+        in_arcs.resize(in_offsets[n]);
+        std::vector<int> in_pos(in_offsets.begin(), in_offsets.end() - 1);
+        for (int i = 0; i < n; i++) {
+            for (int k = out_offsets[i]; k < out_offsets[i + 1]; k++)
+                in_arcs[in_pos[out_arcs[k].first]++] = std::pair<int, int>(i, out_arcs[k].second);
+        }
+        sig.resize(n + out_arcs.size() + in_arcs.size());
+    }
+
+    // colours of the labels, returns their number
+    int initial_colours(std::vector<int> &colours) {
+        colours = node_class;
+        int k = 0;
+        for (int i = 0; i < n; i++)
+            k = std::max(k, colours[i] + 1);
+        refine(colours, k);
+        return k;
+    }
+
+    /*
+     * Splits the colours by the colours of the neighbours until they are stable.
+     * New colours are the ranks of the node signatures, so colourings related by
+     * an automorphism are refined to colourings related by the same automorphism.
+     */
+    void refine(std::vector<int> &colours, int &nof_colours) {
+        std::vector<int> order(n), next(n);
+        while (true) {
+            work += sig.size();
+            if (work > max_work) {
+                aborted = true;
+                return;
+            }
+            for (int v = 0; v < n; v++) {
+                long *s = &sig[sig_begin(v)];
+                int k = 0;
+                s[k++] = colours[v];
+                for (int a = out_offsets[v]; a < out_offsets[v + 1]; a++)
+                    s[k++] = ((long)colours[out_arcs[a].first] * nof_eclasses + out_arcs[a].second) * 2;
+                for (int a = in_offsets[v]; a < in_offsets[v + 1]; a++)
+                    s[k++] = ((long)colours[in_arcs[a].first] * nof_eclasses + in_arcs[a].second) * 2 + 1;
+                std::sort(s + 1, s + k);
+                order[v] = v;
+            }
+            const long *s = sig.data();
+            std::sort(order.begin(), order.end(), [this, s](int a, int b) {
+                return std::lexicographical_compare(s + sig_begin(a), s + sig_end(a), s + sig_begin(b), s + sig_end(b));
+            });
+            int k = 0;
+            for (int i = 0; i < n; i++) {
+                int q = order[i];
+                if (i > 0) {
+                    int p = order[i - 1];
+                    if (sig_end(p) - sig_begin(p) != sig_end(q) - sig_begin(q) || !std::equal(s + sig_begin(p), s + sig_end(p), s + sig_begin(q)))
+                        k++;
+                }
+                next[q] = k;
+            }
+            k = (n > 0) ? k + 1 : 0;
+            // colours are only split, the same number means the same colours
+            if (k == nof_colours)
+                return;
+            colours.swap(next);
+            nof_colours = k;
+        }
+    }
+
+    // gives v a colour of its own
+    void individualize(std::vector<int> &colours, int &nof_colours, int v) {
+        colours[v] = nof_colours++;
+        refine(colours, nof_colours);
+    }
+
+    // gives v and w a new colour, shared by the two of them
+    void individualize(std::vector<int> &colours, int &nof_colours, int v, int w) {
+        colours[v] = nof_colours;
+        colours[w] = nof_colours++;
+        refine(colours, nof_colours);
+    }
+
+    // an automorphism which maps the colours of a to the ones of b, in sigma
+    bool search(std::vector<int> &a, int ka, std::vector<int> &b, int kb, std::vector<int> &sigma) {
+        if (aborted || ka != kb)
+            return false;
+        std::vector<int> sizes(ka, 0);
+        for (int i = 0; i < n; i++)
+            sizes[a[i]]++;
+        for (int i = 0; i < n; i++)
+            sizes[b[i]]--;
+        for (int c = 0; c < ka; c++) {
+            if (sizes[c] != 0)
+                return false;
+        }
+
+        if (ka == n) {
+            std::vector<int> by_colour(n);
+            for (int i = 0; i < n; i++)
+                by_colour[b[i]] = i;
+            for (int i = 0; i < n; i++)
+                sigma[i] = by_colour[a[i]];
+            return is_automorphism(sigma);
+        }
+
+        // the first node of the first non singleton colour is mapped to each node of that colour
+        for (int i = 0; i < n; i++)
+            sizes[a[i]]++;
+        int x = -1;
+        for (int i = 0; i < n; i++) {
+            if (sizes[a[i]] > 1 && (x == -1 || a[i] < a[x]))
+                x = i;
+        }
+        std::vector<int> a2 = a;
+        int ka2 = ka;
+        individualize(a2, ka2, x);
+        for (int y = 0; y < n && !aborted; y++) {
+            if (b[y] != a[x])
+                continue;
+            std::vector<int> b2 = b;
+            int kb2 = kb;
+            individualize(b2, kb2, y);
+            if (search(a2, ka2, b2, kb2, sigma))
+                return true;
+        }
+        return false;
+    }
+
+  private:
+    int sig_begin(int v) { return v + out_offsets[v] + in_offsets[v]; }
+    int sig_end(int v) { return v + 1 + out_offsets[v + 1] + in_offsets[v + 1]; }
+
+    // class of each attribute, equal attributes have the same class, returns the number of classes
+    static int label_classes(std::vector<void *> &attrs, AttributeComparator &comparator, std::vector<int> &classes) {
+        int size = (int)attrs.size();
+        std::vector<int> order(size);
+        for (int i = 0; i < size; i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            if (attrs[a] == NULL || attrs[b] == NULL)
+                return attrs[a] == NULL && attrs[b] != NULL;
+            return comparator.compareint(attrs[a], attrs[b]) < 0;
+        });
+        classes.assign(size, 0);
+        int k = 0;
+        for (int i = 1; i < size; i++) {
+            void *p = attrs[order[i - 1]], *q = attrs[order[i]];
+            if ((p == NULL) != (q == NULL) || (p != NULL && !comparator.compare(p, q)))
+                k++;
+            classes[order[i]] = k;
+        }
+        return size > 0 ? k + 1 : 1;
+    }
+
+    // labels are kept by the colours, the arcs are checked with their classes
+    bool is_automorphism(std::vector<int> &sigma) {
+        for (int v = 0; v < n; v++) {
+            std::vector<std::pair<int, int> >::iterator first = out_arcs.begin() + out_offsets[sigma[v]];
+            std::vector<std::pair<int, int> >::iterator last = out_arcs.begin() + out_offsets[sigma[v] + 1];
+            if (last - first != out_offsets[v + 1] - out_offsets[v])
+                return false;
+            for (int a = out_offsets[v]; a < out_offsets[v + 1]; a++) {
+                if (!std::binary_search(first, last, std::pair<int, int>(sigma[out_arcs[a].first], out_arcs[a].second)))
+                    return false;
+            }
+        }
+        work += out_arcs.size();
+        return true;
+    }
+};
+
+class QuerySymmetry {
+  public:
+    std::vector<int> level_nodes;                // vi of each level of the chain
+    std::vector<std::vector<int> > level_orbits; // Oi of each level, vi included
+    long aut_size;                               // order of the automorphism group, the product of the orbit sizes
+    bool complete;                               // false if the budget ran out, the levels found are still valid
+
+    QuerySymmetry() {
+        aut_size = 1;
+        complete = true;
+    }
+
+    void compute(Graph &query, AttributeComparator &nodeComparator, AttributeComparator &edgeComparator, long max_work = 50000000) {
+        level_nodes.clear();
+        level_orbits.clear();
+        aut_size = 1;
+
+        int n = query.nof_nodes;
+        AutomorphismSearch search(query, nodeComparator, edgeComparator, max_work);
+        std::vector<int> colours;
+        int k = search.initial_colours(colours);
+        std::vector<int> orbit_of(n), sigma(n), cell_sizes;
+
+        // the chain ends when the nodes fixed so far leave no automorphism
+        while (!search.aborted && k < n) {
+            cell_sizes.assign(k, 0);
+            for (int i = 0; i < n; i++)
+                cell_sizes[colours[i]]++;
+            int v = -1;
+            for (int i = 0; i < n; i++) {
+                if (cell_sizes[colours[i]] > 1 && (v == -1 || colours[i] < colours[v]))
+                    v = i;
+            }
+
+            std::vector<int> a = colours;
+            int ka = k;
+            search.individualize(a, ka, v);
+            for (int i = 0; i < n; i++)
+                orbit_of[i] = i;
+            for (int w = 0; w < n && !search.aborted; w++) {
+                if (w == v || colours[w] != colours[v] || find(orbit_of, w) == find(orbit_of, v))
+                    continue;
+                std::vector<int> b = colours;
+                int kb = k;
+                search.individualize(b, kb, w);
+                if (search.search(a, ka, b, kb, sigma)) {
+                    for (int i = 0; i < n; i++)
+                        join(orbit_of, i, sigma[i]);
+                }
+            }
+            if (search.aborted)
+                break;
+
+            std::vector<int> orbit;
+            for (int i = 0; i < n; i++) {
+                if (find(orbit_of, i) == find(orbit_of, v))
+                    orbit.push_back(i);
+            }
+            if (orbit.size() > 1) {
+                level_nodes.push_back(v);
+                level_orbits.push_back(orbit);
+                aut_size *= (long)orbit.size();
+            }
+            colours.swap(a);
+            k = ka;
+        }
+        complete = !search.aborted;
+    }
+
+    /*
+     * Sets on mama the conditions of the levels whose nodes are all mapped before
+     * state nof_free_states. Each match found then stands for kept embeddings, and
+     * for one distinct subgraph out of dropped matches.
+     */
+    void break_symmetry(MatchingMachine &mama, int nof_free_states, long &kept, long &dropped) {
+        std::vector<std::pair<int, int> > conditions;
+        kept = 1;
+        dropped = 1;
+        for (size_t l = 0; l < level_nodes.size(); l++) {
+            std::vector<int> &orbit = level_orbits[l];
+            bool free = true;
+            for (size_t i = 0; i < orbit.size() && free; i++)
+                free = mama.map_node_to_state[orbit[i]] < nof_free_states;
+            if (!free) {
+                dropped *= (long)orbit.size();
+                continue;
+            }
+            kept *= (long)orbit.size();
+            for (size_t i = 0; i < orbit.size(); i++) {
+                if (orbit[i] != level_nodes[l])
+                    conditions.push_back(std::pair<int, int>(level_nodes[l], orbit[i]));
+            }
+        }
+        mama.set_symmetry(conditions);
+    }
+
+  private:
+    static int find(std::vector<int> &parent, int n) {
+        while (parent[n] != n) {
+            parent[n] = parent[parent[n]];
+            n = parent[n];
+        }
+        return n;
+    }
+
+    static void join(std::vector<int> &parent, int a, int b) {
+        a = find(parent, a);
+        b = find(parent, b);
+        if (a != b)
+            parent[std::max(a, b)] = std::min(a, b);
+    }
+};
+
+} // namespace rilib
+
+#endif /* AUTOMORPHISMS_H_ */
@@ -0,0 +1,182 @@
+/*
+ * CostModel.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef COSTMODEL_H_
+#define COSTMODEL_H_
+
+#include <ostream>
+
+#include "Domains.h"
+#include "Graph.h"
+#include "MatchingMachine.h"
+
+/*
+ * Cheap estimate of the search cost of a matching machine, from the domains of
+ * one (query, reference) pair. Every state multiplies the number of partial
+ * solutions by its expected branching: the candidates of a state with a parent
+ * are the reference edges compatible with the parent edge, spread over the
+ * parent domain, and every other edge to an earlier state keeps a candidate with
+ * the density of its edge domain. The cost is the number of tried candidates.
+ * Leafs of a leaf solver are counted once per partial solution, since their
+ * candidates are combined without backtracking. Trees of the tree solver are
+ * counted once over their edge domains, then looked up once per core match, the
+ * trees searched again for each core match because of shared domains are not
+ * told apart.
+ */
+
+namespace rilib {
+
+struct QueryFeatures {
+    int nof_nodes;
+    int nof_edges; // pairs of adjacent nodes, whatever the direction
+    int nof_leafs; // nodes with a single neighbour
+    int cycle_rank;
+    double mean_domain;
+    double mean_edomain;
+};
+
+// number of distinct neighbours of n, over in and out arcs
+inline int count_neighbours(Graph &g, int n) {
+    int count = 0;
+    for (int k = 0; k < g.out_adj_sizes[n] + g.in_adj_sizes[n]; k++) {
+        int m = k < g.out_adj_sizes[n] ? g.out_adj_list[n][k] : g.in_adj_list[n][k - g.out_adj_sizes[n]];
+        bool seen = false;
+        for (int j = 0; j < k && !seen; j++)
+            seen = (j < g.out_adj_sizes[n] ? g.out_adj_list[n][j] : g.in_adj_list[n][j - g.out_adj_sizes[n]]) == m;
+        if (!seen && m != n)
+            count++;
+    }
+    return count;
+};
+
+inline void compute_query_features(Graph &query, int *domains_size, EdgeDomains &edomains, QueryFeatures &f) {
+    f.nof_nodes = query.nof_nodes;
+    int arcs = 0;
+    int degrees = 0;
+    f.nof_leafs = 0;
+    f.mean_domain = 0;
+    for (int i = 0; i < query.nof_nodes; i++) {
+        arcs += query.out_adj_sizes[i];
+        int nb = count_neighbours(query, i);
+        degrees += nb;
+        if (nb == 1)
+            f.nof_leafs++;
+        f.mean_domain += domains_size[i];
+    }
+    f.nof_edges = degrees / 2;
+    if (query.nof_nodes > 0)
+        f.mean_domain /= query.nof_nodes;
+
+    f.mean_edomain = 0;
+    for (int e = 0; e < arcs; e++) {
+        f.mean_edomain += edomains.domains[e].size();
+    }
+    if (arcs > 0)
+        f.mean_edomain /= arcs;
+
+    // components, by union find
+    int *parent = (int *)malloc(query.nof_nodes * sizeof(int));
+    for (int i = 0; i < query.nof_nodes; i++)
+        parent[i] = i;
+    int components = query.nof_nodes;
+    for (int i = 0; i < query.nof_nodes; i++) {
+        for (int j = 0; j < query.out_adj_sizes[i]; j++) {
+            int a = i, b = query.out_adj_list[i][j];
+            while (parent[a] != a)
+                a = parent[a] = parent[parent[a]];
+            while (parent[b] != b)
+                b = parent[b] = parent[parent[b]];
+            if (a != b) {
+                parent[a] = b;
+                components--;
+            }
+        }
+    }
+    free(parent);
+    f.cycle_rank = f.nof_edges - f.nof_nodes + components;
+};
+
+inline void print_query_features(std::ostream &out, QueryFeatures &f) {
+    out << "nodes " << f.nof_nodes << ", edges " << f.nof_edges << ", leafs " << f.nof_leafs << ", cycle rank " << f.cycle_rank;
+    out << ", mean domain " << f.mean_domain << ", mean edge domain " << f.mean_edomain;
+};
+
+// mama must have its edge ids fixed (MatchingMachine::fix_eids). nof_leafs trailing states are leafs of a leaf solver,
+// or the trees of the tree solver if trees is true
+inline double estimate_search_cost(MatchingMachine &mama, int *domains_size, EdgeDomains &edomains, int nof_leafs, bool trees = false) {
+    double partials = 1; // expected partial solutions before the current state
+    double cost = 0;
+    double leafcost = 0;
+    double treecost = 0;
+    int inner = mama.nof_sn - nof_leafs;
+    for (int si = 0; si < mama.nof_sn; si++) {
+        int n = mama.map_state_to_node[si];
+        double tried = domains_size[n];
+        double kept = 1;
+        for (int ei = 0; ei < mama.edges_sizes[si]; ei++) {
+            MaMaEdge &e = mama.edges[si][ei];
+            int other = (e.source == si) ? e.target : e.source;
+            // both arcs of an undirected edge are listed, a state is counted once
+            bool seen = false;
+            for (int ej = 0; ej < ei && !seen; ej++) {
+                MaMaEdge &f = mama.edges[si][ej];
+                seen = (f.source == si ? f.target : f.source) == other;
+            }
+            if (seen || e.id < 0)
+                continue;
+            double esize = (double)edomains.domains[e.id].size();
+            double dother = domains_size[mama.map_state_to_node[other]];
+            if (mama.parent_type[si] != PARENTTYPE_NULL && other == mama.parent_state[si]) {
+                // neighbours of the parent image
+                if (dother > 0 && esize / dother < tried)
+                    tried = esize / dother;
+            } else if (dother > 0 && domains_size[n] > 0) {
+                kept *= esize / (dother * domains_size[n]);
+            }
+        }
+        if (si < inner) {
+            cost += partials * tried;
+            partials *= tried * kept;
+        } else {
+            leafcost += tried;
+            if (mama.edges_sizes[si] > 0 && mama.edges[si][0].id >= 0)
+                treecost += (double)edomains.domains[mama.edges[si][0].id].size();
+        }
+    }
+    if (trees)
+        return cost + treecost + partials;
+    return cost + partials * leafcost;
+};
+
+} // namespace rilib
+
+#endif /* COSTMODEL_H_ */
@@ -0,0 +1,85 @@
+/*
+ * Deadline.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#ifndef DEADLINE_H_
+#define DEADLINE_H_
+
+#include <chrono>
+
+namespace rilib {
+
+/*
+ * Time limit of a search. The solvers call over() at each matched couple, the
+ * clock is read once every CHECK_TICKS calls. Once over, it stays expired and the
+ * counts of the stopped search are partial.
+ */
+class Deadline {
+    static const unsigned CHECK_TICKS = 1024;
+
+    std::chrono::steady_clock::time_point end;
+    bool active;
+    unsigned ticks;
+
+  public:
+    bool expired;
+
+    Deadline() { clear(); }
+
+    void set(double seconds) {
+        end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+        active = true;
+        ticks = 0;
+        expired = (seconds <= 0);
+    }
+
+    void clear() {
+        active = false;
+        ticks = 0;
+        expired = false;
+    }
+
+    bool over() {
+        if (!active)
+            return false;
+        if (expired)
+            return true;
+        if (++ticks % CHECK_TICKS != 0)
+            return false;
+        expired = (std::chrono::steady_clock::now() >= end);
+        return expired;
+    }
+};
+
+} // namespace rilib
+
+#endif /* DEADLINE_H_ */
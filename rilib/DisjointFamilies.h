@@ -0,0 +1,208 @@
+/*
+ * DisjointFamilies.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef DISJOINTFAMILIES_H_
+#define DISJOINTFAMILIES_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/*
+ * Number of tuples made of one member of each family whose members share no element.
+ * The members of a family are the sets of reference nodes used by the solutions of
+ * a query component, so the tuples are the injective combinations of the components.
+ * The count is by inclusion exclusion over the pairs of families which collide:
+ *   sum over the sets E of pairs of families of (-1)^|E| C(E)
+ * where C(E) is the number of tuples colliding on every pair of E. C(E) is the product
+ * over the connected parts of E, a family alone counts its members, and the tuples of
+ * a part are enumerated by following the collisions only. The number of sets E grows
+ * as 2^(k(k-1)/2), so only a few families are combined this way.
+ */
+
+namespace rilib {
+
+class DisjointFamilies {
+  public:
+    static const int MAX_FAMILIES = 4;
+
+  private:
+    std::vector<int> widths;                                     // indexed by family
+    std::vector<std::vector<int> > elements;                     // indexed by family, members one after the other
+    std::vector<std::vector<std::pair<int, int> > > occurrences; // indexed by family, sorted (element, member) pairs
+
+  public:
+    void reset(int nof_families) {
+        widths.assign(nof_families, 0);
+        elements.resize(nof_families);
+        for (int f = 0; f < nof_families; f++)
+            elements[f].clear();
+    }
+
+    // the members of family f are appended to the returned vector, width elements each
+    std::vector<int> &family(int f, int width) {
+        widths[f] = width;
+        return elements[f];
+    }
+
+    long count() {
+        int k = widths.size();
+        std::vector<long> sizes(k);
+        occurrences.resize(k);
+        for (int f = 0; f < k; f++) {
+            sizes[f] = elements[f].size() / widths[f];
+            if (sizes[f] == 0)
+                return 0;
+            occurrences[f].clear();
+            for (size_t e = 0; e < elements[f].size(); e++)
+                occurrences[f].push_back(std::pair<int, int>(elements[f][e], e / widths[f]));
+            std::sort(occurrences[f].begin(), occurrences[f].end());
+        }
+
+        std::vector<std::pair<int, int> > pairs;
+        for (int a = 0; a < k; a++) {
+            for (int b = a + 1; b < k; b++)
+                pairs.push_back(std::pair<int, int>(a, b));
+        }
+
+        long total = 0;
+        std::vector<int> part(k);
+        for (long mask = 0; mask < (1L << pairs.size()); mask++) {
+            std::vector<std::pair<int, int> > e;
+            for (int f = 0; f < k; f++)
+                part[f] = f;
+            for (size_t p = 0; p < pairs.size(); p++) {
+                if (mask & (1L << p)) {
+                    e.push_back(pairs[p]);
+                    int a = find(part, pairs[p].first);
+                    int b = find(part, pairs[p].second);
+                    if (a != b)
+                        part[std::max(a, b)] = std::min(a, b);
+                }
+            }
+            long term = 1;
+            for (int r = 0; r < k && term != 0; r++) {
+                if (find(part, r) != r)
+                    continue;
+                std::vector<int> fams;
+                for (int f = 0; f < k; f++) {
+                    if (find(part, f) == r)
+                        fams.push_back(f);
+                }
+                term *= (fams.size() == 1) ? sizes[r] : colliding(fams, e);
+            }
+            total += (e.size() % 2 == 0) ? term : -term;
+        }
+        return total;
+    }
+
+  private:
+    // tuples of the families of a connected part colliding on each pair of e between them
+    long colliding(std::vector<int> &fams, std::vector<std::pair<int, int> > &e) {
+        int k = widths.size();
+        // families in visit order, each one after the family it collides with
+        std::vector<int> order(1, fams[0]), parent(k, -1);
+        std::vector<bool> seen(k, false);
+        seen[fams[0]] = true;
+        for (size_t i = 0; i < order.size(); i++) {
+            for (size_t p = 0; p < e.size(); p++) {
+                int o = (e[p].first == order[i]) ? e[p].second : (e[p].second == order[i]) ? e[p].first : -1;
+                if (o != -1 && !seen[o]) {
+                    seen[o] = true;
+                    parent[o] = order[i];
+                    order.push_back(o);
+                }
+            }
+        }
+        std::vector<int> chosen(k, -1);
+        return colliding(order, 0, parent, e, chosen);
+    }
+
+    long colliding(std::vector<int> &order, size_t depth, std::vector<int> &parent, std::vector<std::pair<int, int> > &e,
+                   std::vector<int> &chosen) {
+        if (depth == order.size())
+            return 1;
+        int f = order[depth];
+        std::vector<int> candidates;
+        if (depth == 0) {
+            for (int m = 0; m < (int)(elements[f].size() / widths[f]); m++)
+                candidates.push_back(m);
+        } else {
+            int g = parent[f];
+            for (int i = 0; i < widths[g]; i++) {
+                std::vector<std::pair<int, int> >::iterator it =
+                    std::lower_bound(occurrences[f].begin(), occurrences[f].end(), std::pair<int, int>(elements[g][chosen[g] * widths[g] + i], -1));
+                for (; it != occurrences[f].end() && it->first == elements[g][chosen[g] * widths[g] + i]; it++)
+                    candidates.push_back(it->second);
+            }
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        }
+
+        long total = 0;
+        for (size_t c = 0; c < candidates.size(); c++) {
+            chosen[f] = candidates[c];
+            bool checked = true;
+            for (size_t p = 0; p < e.size() && checked; p++) {
+                int o = (e[p].first == f) ? e[p].second : (e[p].second == f) ? e[p].first : -1;
+                if (o != -1 && o != parent[f] && chosen[o] != -1)
+                    checked = collide(f, chosen[f], o, chosen[o]);
+            }
+            if (checked)
+                total += colliding(order, depth + 1, parent, e, chosen);
+        }
+        chosen[f] = -1;
+        return total;
+    }
+
+    bool collide(int f, int a, int g, int b) {
+        for (int i = 0; i < widths[f]; i++) {
+            for (int j = 0; j < widths[g]; j++) {
+                if (elements[f][a * widths[f] + i] == elements[g][b * widths[g] + j])
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    static int find(std::vector<int> &parent, int n) {
+        while (parent[n] != n) {
+            parent[n] = parent[parent[n]];
+            n = parent[n];
+        }
+        return n;
+    }
+};
+
+} // namespace rilib
+
+#endif /* DISJOINTFAMILIES_H_ */
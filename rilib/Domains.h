@@ -36,13 +36,142 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "Graph.h"
 #include "sbitset.h"
 
+#include <algorithm>
 #include <set>
 #include <tuple>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace rilib {
 
-bool init_domains(Graph &target, Graph &pattern, AttributeComparator &nodeComparator, AttributeComparator &edgeComparator, sbitset *domains, bool iso) {
+/*
+ * Neighbours of each node counted by direction, node label and edge label, in a sparse layout:
+ * the keys of node i, sorted, and their counts are the ones from offsets[i] to offsets[i + 1].
+ * A key is ((node class * nof_eclasses) + edge class) * 2 + direction, 1 for the in arcs.
+ */
+class NeighbourLabelCounts {
+  public:
+    std::vector<int> offsets;
+    std::vector<int> keys;
+    std::vector<int> counts;
+
+    // arcs towards a node or by an edge of class -1 are not counted. With distinct, parallel arcs count once
+    void build(Graph &g, std::vector<int> &node_class, std::vector<int> &arc_class, int nof_eclasses, bool distinct) {
+        int n = g.nof_nodes;
+        // the arcs of each node as (direction * n + neighbour, key), grouped by node
+        std::vector<int> first(n + 1, 0);
+        for (int i = 0, a = 0; i < n; i++) {
+            for (int j = 0; j < g.out_adj_sizes[i]; j++, a++) {
+                first[i + 1]++;
+                first[g.out_adj_list[i][j] + 1]++;
+            }
+        }
+        for (int i = 0; i < n; i++)
+            first[i + 1] += first[i];
+        std::vector<int> fill(first.begin(), first.end() - 1);
+        std::vector<std::pair<int, int> > arcs(first[n], std::pair<int, int>(-1, -1));
+        for (int i = 0, a = 0; i < n; i++) {
+            for (int j = 0; j < g.out_adj_sizes[i]; j++, a++) {
+                int t = g.out_adj_list[i][j];
+                if (arc_class[a] == -1 || node_class[i] == -1 || node_class[t] == -1)
+                    continue;
+                arcs[fill[i]++] = std::pair<int, int>(t, (node_class[t] * nof_eclasses + arc_class[a]) * 2);
+                arcs[fill[t]++] = std::pair<int, int>(n + i, (node_class[i] * nof_eclasses + arc_class[a]) * 2 + 1);
+            }
+        }
+
+        offsets.assign(n + 1, 0);
+        keys.clear();
+        counts.clear();
+        std::vector<int> node_keys;
+        for (int i = 0; i < n; i++) {
+            node_keys.clear();
+            if (distinct)
+                std::sort(arcs.begin() + first[i], arcs.begin() + fill[i]);
+            for (int k = first[i]; k < fill[i]; k++) {
+                if (!distinct || k == first[i] || arcs[k].first != arcs[k - 1].first)
+                    node_keys.push_back(arcs[k].second);
+            }
+            std::sort(node_keys.begin(), node_keys.end());
+            for (size_t q = 0; q < node_keys.size(); q++) {
+                if (q == 0 || node_keys[q] != node_keys[q - 1]) {
+                    keys.push_back(node_keys[q]);
+                    counts.push_back(0);
+                }
+                counts.back()++;
+            }
+            offsets[i + 1] = keys.size();
+        }
+    }
+
+    // every count of node i of other is at most the one of node r
+    bool dominates(int r, NeighbourLabelCounts &other, int i) {
+        int k = offsets[r];
+        for (int q = other.offsets[i]; q < other.offsets[i + 1]; q++) {
+            while (k < offsets[r + 1] && keys[k] < other.keys[q])
+                k++;
+            if (k == offsets[r + 1] || keys[k] != other.keys[q] || counts[k] < other.counts[q])
+                return false;
+        }
+        return true;
+    }
+};
+
+// index of the label equal to attr, added if missing and add is set, otherwise -1
+inline int label_class(std::vector<void *> &labels, AttributeComparator &comparator, void *attr, bool add) {
+    for (size_t c = 0; c < labels.size(); c++) {
+        if (comparator.compare(labels[c], attr))
+            return c;
+    }
+    if (!add)
+        return -1;
+    labels.push_back(attr);
+    return labels.size() - 1;
+};
+
+// classes of the node and arc labels of g, the labels of the query are added to the lists
+inline void label_classes(Graph &g, AttributeComparator &nodeComparator, AttributeComparator &edgeComparator, std::vector<void *> &node_labels,
+                   std::vector<void *> &edge_labels, bool add, std::vector<int> &node_class, std::vector<int> &arc_class) {
+    node_class.resize(g.nof_nodes);
+    arc_class.clear();
+    for (int i = 0; i < g.nof_nodes; i++) {
+        node_class[i] = label_class(node_labels, nodeComparator, g.nodes_attrs[i], add);
+        for (int j = 0; j < g.out_adj_sizes[i]; j++)
+            arc_class.push_back(label_class(edge_labels, edgeComparator, g.out_adj_attrs[i][j], add));
+    }
+};
+
+/*
+ * Neighbourhood label frequency: a candidate needs at least as many out (in) neighbours of each label, by an
+ * edge of each label, as the query node. Labels missing from the query are not counted.
+ */
+inline bool filter_domains_by_labels(Graph &target, Graph &pattern, AttributeComparator &nodeComparator, AttributeComparator &edgeComparator,
+                              sbitset *domains) {
+    std::vector<void *> node_labels, edge_labels;
+    std::vector<int> node_class, arc_class;
+    NeighbourLabelCounts pattern_counts, target_counts;
+    label_classes(pattern, nodeComparator, edgeComparator, node_labels, edge_labels, true, node_class, arc_class);
+    int nof_eclasses = std::max((int)edge_labels.size(), 1);
+    pattern_counts.build(pattern, node_class, arc_class, nof_eclasses, true);
+    label_classes(target, nodeComparator, edgeComparator, node_labels, edge_labels, false, node_class, arc_class);
+    target_counts.build(target, node_class, arc_class, nof_eclasses, false);
+
+    for (int q = 0; q < pattern.nof_nodes; q++) {
+        for (sbitset::iterator IT = domains[q].first_ones(); IT != domains[q].end(); IT.next_ones()) {
+            if (!target_counts.dominates(IT.first, pattern_counts, q))
+                domains[q].set(IT.first, false);
+        }
+        if (domains[q].is_empty())
+            return false;
+    }
+    return true;
+};
+
+// with nlf, candidates are filtered by the labels of their neighbours before the 1-hop check,
+// with node_d_conv, domains are refined until no more candidates are removed
+inline bool init_domains(Graph &target, Graph &pattern, AttributeComparator &nodeComparator, AttributeComparator &edgeComparator, sbitset *domains, bool iso,
+                  bool node_d_conv, bool nlf = false) {
 
     if (iso) {
         for (int q = 0; q < pattern.nof_nodes; q++) {
@@ -68,6 +197,9 @@ bool init_domains(Graph &target, Graph &pattern, AttributeComparator &nodeCompar
         }
     }
 
+    if (nlf && !filter_domains_by_labels(target, pattern, nodeComparator, edgeComparator, domains))
+        return false;
+
     int ra, qb, rb;
     bool notfound;
 
@@ -100,8 +232,7 @@ bool init_domains(Graph &target, Graph &pattern, AttributeComparator &nodeCompar
             return false;
     }
 
-#ifdef NODE_D_CONV
-    bool changes = true;
+    bool changes = node_d_conv;
     while (changes) {
         changes = false;
         for (int qa = 0; qa < pattern.nof_nodes; qa++) {
@@ -129,11 +260,96 @@ bool init_domains(Graph &target, Graph &pattern, AttributeComparator &nodeCompar
                 return false;
         }
     }
-#endif
 
     return true;
 };
 
+// finds a reference node for the query neighbour i, moving the earlier ones along an augmenting path
+inline bool augment_neighbours(std::vector<std::vector<int> > &options, std::vector<int> &owner, std::vector<long> &visited, int i, long stamp) {
+    for (size_t k = 0; k < options[i].size(); k++) {
+        int r = options[i][k];
+        if (visited[r] == stamp)
+            continue;
+        visited[r] = stamp;
+        if (owner[r] == -1 || augment_neighbours(options, owner, visited, owner[r], stamp)) {
+            owner[r] = i;
+            return true;
+        }
+    }
+    return false;
+};
+
+// distinct out (in) neighbours of ra for the distinct out (in) neighbours of qa, each within its domain and by a compatible edge.
+// owner and visited are indexed by the reference nodes, owner is left as it was found
+inline bool neighbours_dominate(Graph &target, Graph &pattern, AttributeComparator &edgeComparator, sbitset *domains, int qa, int ra, bool out,
+                         std::vector<std::vector<int> > &options, std::vector<int> &owner, std::vector<long> &visited, long &stamp) {
+    int q_size = out ? pattern.out_adj_sizes[qa] : pattern.in_adj_sizes[qa];
+    int r_size = out ? target.out_adj_sizes[ra] : target.in_adj_sizes[ra];
+    int *q_adj = out ? pattern.out_adj_list[qa] : pattern.in_adj_list[qa];
+    int *r_adj = out ? target.out_adj_list[ra] : target.in_adj_list[ra];
+
+    // the nodes which may hold each neighbour of qa, a neighbour repeated by parallel arcs counts once
+    int nof_options = 0;
+    for (int i = 0; i < q_size; i++) {
+        bool repeated = false;
+        for (int j = 0; j < i && !repeated; j++)
+            repeated = (q_adj[j] == q_adj[i]);
+        if (repeated)
+            continue;
+        if ((int)options.size() <= nof_options)
+            options.resize(nof_options + 1);
+        std::vector<int> &o = options[nof_options++];
+        o.clear();
+        for (int k = 0; k < r_size; k++) {
+            // the labels of the in arcs are checked as out arcs of the other end
+            if (domains[q_adj[i]].get(r_adj[k]) && (!out || edgeComparator.compare(pattern.out_adj_attrs[qa][i], target.out_adj_attrs[ra][k])))
+                o.push_back(r_adj[k]);
+        }
+        if (o.empty())
+            return false;
+    }
+    if (nof_options > r_size)
+        return false;
+
+    bool found = true;
+    for (int i = 0; i < nof_options && found; i++)
+        found = augment_neighbours(options, owner, visited, i, ++stamp);
+    for (int k = 0; k < r_size; k++)
+        owner[r_adj[k]] = -1;
+    return found;
+};
+
+/*
+ * Colour refinement of the domains for subgraph matching: the domains play the role of the colours, and a
+ * candidate ra of qa is kept only if the out (in) neighbours of ra can hold the out (in) neighbours of qa,
+ * each one a distinct node of its domain reached by a compatible edge. The neighbour multiset of ra must
+ * dominate the one of qa, not just cover each neighbour as the 1-hop check of init_domains does.
+ * Stops after rounds rounds or when nothing is removed, returns false if a domain is left empty.
+ */
+inline bool refine_domains_by_neighbours(Graph &target, Graph &pattern, AttributeComparator &edgeComparator, sbitset *domains, int rounds) {
+    std::vector<std::vector<int> > options;
+    std::vector<int> owner(target.nof_nodes, -1);
+    std::vector<long> visited(target.nof_nodes, 0);
+    long stamp = 0;
+    bool changes = true;
+    for (int round = 0; round < rounds && changes; round++) {
+        changes = false;
+        for (int qa = 0; qa < pattern.nof_nodes; qa++) {
+            for (sbitset::iterator qaIT = domains[qa].first_ones(); qaIT != domains[qa].end(); qaIT.next_ones()) {
+                int ra = qaIT.first;
+                if (!neighbours_dominate(target, pattern, edgeComparator, domains, qa, ra, true, options, owner, visited, stamp) ||
+                    !neighbours_dominate(target, pattern, edgeComparator, domains, qa, ra, false, options, owner, visited, stamp)) {
+                    domains[qa].set(ra, false);
+                    changes = true;
+                }
+            }
+            if (domains[qa].is_empty())
+                return false;
+        }
+    }
+    return true;
+};
+
 struct pair_hash {
     inline std::size_t operator()(const std::pair<int, int> &v) const { return v.first * 31 + v.second; }
 };
@@ -145,6 +361,7 @@ class EdgeDomains {
     int **pattern_out_adj_eids;
     int *inv_pattern_edge_ids;
     int *inv_target_edge_ids;
+    int nof_pattern_nodes;
     int nof_pattern_edges;
     int nof_target_edges;
 
@@ -152,10 +369,33 @@ class EdgeDomains {
 
     unordered_edge_set *domains;
 
-    EdgeDomains(){};
+    EdgeDomains() {
+        pattern_out_adj_eids = NULL;
+        inv_pattern_edge_ids = NULL;
+        inv_target_edge_ids = NULL;
+        nof_pattern_nodes = 0;
+        nof_pattern_edges = 0;
+        nof_target_edges = 0;
+        pattern_in_adj_eids = NULL;
+        domains = NULL;
+    };
+
+    ~EdgeDomains() {
+        if (pattern_out_adj_eids != NULL) {
+            for (int i = 0; i < nof_pattern_nodes; i++) {
+                delete[] pattern_out_adj_eids[i];
+                delete[] pattern_in_adj_eids[i];
+            }
+        }
+        delete[] pattern_out_adj_eids;
+        delete[] pattern_in_adj_eids;
+        delete[] inv_pattern_edge_ids;
+        delete[] inv_target_edge_ids;
+        delete[] domains;
+    }
 };
 
-bool init_edomains(Graph &target, Graph &pattern, sbitset *node_domains, AttributeComparator &edgeComparator, EdgeDomains &edomains) {
+inline bool init_edomains(Graph &target, Graph &pattern, sbitset *node_domains, AttributeComparator &edgeComparator, EdgeDomains &edomains) {
     int nof_pedges = 0;
     for (int i = 0; i < pattern.nof_nodes; i++) {
         nof_pedges += pattern.out_adj_sizes[i];
@@ -166,6 +406,7 @@ bool init_edomains(Graph &target, Graph &pattern, sbitset *node_domains, Attribu
         nof_tedges += target.out_adj_sizes[i];
     }
 
+    edomains.nof_pattern_nodes = pattern.nof_nodes;
     edomains.nof_pattern_edges = nof_pedges;
     edomains.nof_target_edges = nof_tedges;
 
@@ -255,8 +496,10 @@ class DomainReduction {
     sbitset *node_domains;
     EdgeDomains &edge_domains;
     int nof_target_nodes;
+    bool edge_d_conv; // refine edge domains until convergence
 
-    DomainReduction(Graph &_query, sbitset *ndomains, EdgeDomains &edomains, int noftargetnodes) : query(_query), node_domains(ndomains), edge_domains(edomains), nof_target_nodes(noftargetnodes){};
+    DomainReduction(Graph &_query, sbitset *ndomains, EdgeDomains &edomains, int noftargetnodes, bool _edge_d_conv)
+        : query(_query), node_domains(ndomains), edge_domains(edomains), nof_target_nodes(noftargetnodes), edge_d_conv(_edge_d_conv){};
 
     bool refine_domains(int altered_q_node) {
         bool erased = false;
@@ -290,8 +533,7 @@ class DomainReduction {
             }
         }
 
-#ifdef EDGE_D_CONV
-        if (erased) {
+        if (edge_d_conv && erased) {
             while (erased) {
                 erased = false;
 
@@ -363,7 +605,6 @@ class DomainReduction {
                 }
             }
         }
-#endif
         return true;
     };
 
@@ -550,7 +791,7 @@ class DomainReduction {
     };
 };
 
-void print_domains(Graph &query, Graph &target, sbitset *node_domains, EdgeDomains &edge_domains) {
+inline void print_domains(Graph &query, Graph &target, sbitset *node_domains, EdgeDomains &edge_domains) {
     std::cout << "nof query nodes " << query.nof_nodes << "\n";
     for (int i = 0; i < query.nof_nodes; i++) {
         std::cout << "node domain " << i << ":" << node_domains[i].count_ones() << ": ";
@@ -568,7 +809,7 @@ void print_domains(Graph &query, Graph &target, sbitset *node_domains, EdgeDomai
     }
 };
 
-void print_domains_extended(Graph &query, Graph &target, sbitset *node_domains, EdgeDomains &edge_domains) {
+inline void print_domains_extended(Graph &query, Graph &target, sbitset *node_domains, EdgeDomains &edge_domains) {
     std::cout << "nof query nodes " << query.nof_nodes << "\n";
     for (int i = 0; i < query.nof_nodes; i++) {
         std::cout << "node domain " << i << ":" << node_domains[i].count_ones() << ": ";
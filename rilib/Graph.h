@@ -32,6 +32,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef GRAPH_H_
 #define GRAPH_H_
 
+#include <stdlib.h>
+#include <string>
+
 namespace rilib {
 class Graph {
   public:
@@ -47,6 +50,11 @@ class Graph {
     int **in_adj_list;
     void ***out_adj_attrs;
 
+    // false for views over caller buffers (see GraphBuilder.h): the adjacency rows and the labels
+    // belong to the caller, only the per node arrays and view_data are released
+    bool owns_data;
+    void *view_data; // rows built for a view, one block
+
     Graph() {
         id = -1;
         nof_nodes = 0;
@@ -56,6 +64,45 @@ class Graph {
         out_adj_list = NULL;
         in_adj_list = NULL;
         out_adj_attrs = NULL;
+        owns_data = true;
+        view_data = NULL;
+    }
+
+    ~Graph() { clear(); }
+
+    // release adjacency lists and labels (std::string allocated by the readers)
+    void clear() {
+        for (int i = 0; owns_data && i < nof_nodes; i++) {
+            if (nodes_attrs != NULL)
+                delete (std::string *)nodes_attrs[i];
+            if (out_adj_attrs != NULL) {
+                for (int j = 0; j < out_adj_sizes[i]; j++) {
+                    delete (std::string *)out_adj_attrs[i][j];
+                }
+                free(out_adj_attrs[i]);
+            }
+            if (out_adj_list != NULL)
+                free(out_adj_list[i]);
+            if (in_adj_list != NULL)
+                free(in_adj_list[i]);
+        }
+        free(nodes_attrs);
+        free(out_adj_attrs);
+        free(out_adj_list);
+        free(in_adj_list);
+        free(out_adj_sizes);
+        free(in_adj_sizes);
+        free(view_data);
+
+        nof_nodes = 0;
+        nodes_attrs = NULL;
+        out_adj_sizes = NULL;
+        in_adj_sizes = NULL;
+        out_adj_list = NULL;
+        in_adj_list = NULL;
+        out_adj_attrs = NULL;
+        owns_data = true;
+        view_data = NULL;
     }
 
     void print() {
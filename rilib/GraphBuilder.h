@@ -0,0 +1,259 @@
+/*
+ * GraphBuilder.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef GRAPHBUILDER_H_
+#define GRAPHBUILDER_H_
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "Graph.h"
+
+/*
+ * In memory construction of graphs, without going through the text formats.
+ * Labels are std::string, as the ones of the readers, so that the graphs are
+ * matched by the comparators of the file formats (edge labels are compared
+ * for geu/ged only). Undirected graphs keep every edge in both directions,
+ * as read_gfu and read_egfu do.
+ *
+ * build_graph* copy the input into a Graph which owns its data, in one pass.
+ * view_graph_csr adopts the caller CSR arrays and labels without copying them:
+ * they must outlive the Graph, and are not released by it (Graph::owns_data).
+ */
+
+namespace rilib {
+
+// shared label of the nodes built without labels
+inline const std::string &empty_graph_label() {
+    static const std::string empty;
+    return empty;
+};
+
+/*
+ * Owning graph from an edge list. node_labels and edge_labels may be NULL,
+ * edge_labels is aligned with sources/targets.
+ * Returns NULL if an edge endpoint is not a node.
+ */
+inline Graph *build_graph(int nof_nodes, const std::string *node_labels, int nof_edges, const int *sources, const int *targets,
+                   const std::string *edge_labels, bool directed) {
+    for (int e = 0; e < nof_edges; e++) {
+        if (sources[e] < 0 || sources[e] >= nof_nodes || targets[e] < 0 || targets[e] >= nof_nodes)
+            return NULL;
+    }
+
+    Graph *graph = new Graph();
+    graph->nof_nodes = nof_nodes;
+
+    graph->nodes_attrs = (void **)malloc(nof_nodes * sizeof(void *));
+    for (int i = 0; i < nof_nodes; i++) {
+        graph->nodes_attrs[i] = new std::string(node_labels != NULL ? node_labels[i] : empty_graph_label());
+    }
+
+    graph->out_adj_sizes = (int *)calloc(nof_nodes, sizeof(int));
+    graph->in_adj_sizes = (int *)calloc(nof_nodes, sizeof(int));
+    for (int e = 0; e < nof_edges; e++) {
+        graph->out_adj_sizes[sources[e]]++;
+        graph->in_adj_sizes[targets[e]]++;
+        if (!directed) {
+            graph->out_adj_sizes[targets[e]]++;
+            graph->in_adj_sizes[sources[e]]++;
+        }
+    }
+
+    graph->out_adj_list = (int **)malloc(nof_nodes * sizeof(int *));
+    graph->in_adj_list = (int **)malloc(nof_nodes * sizeof(int *));
+    graph->out_adj_attrs = (void ***)malloc(nof_nodes * sizeof(void **));
+    for (int i = 0; i < nof_nodes; i++) {
+        graph->out_adj_list[i] = (int *)calloc(graph->out_adj_sizes[i], sizeof(int));
+        graph->in_adj_list[i] = (int *)calloc(graph->in_adj_sizes[i], sizeof(int));
+        graph->out_adj_attrs[i] = (void **)malloc(graph->out_adj_sizes[i] * sizeof(void *));
+    }
+
+    // next free slot of each row
+    int *outk = (int *)calloc(nof_nodes, sizeof(int));
+    int *ink = (int *)calloc(nof_nodes, sizeof(int));
+    for (int e = 0; e < nof_edges; e++) {
+        for (int dir = 0; dir < (directed ? 1 : 2); dir++) {
+            int s = dir == 0 ? sources[e] : targets[e];
+            int t = dir == 0 ? targets[e] : sources[e];
+            graph->out_adj_list[s][outk[s]] = t;
+            graph->out_adj_attrs[s][outk[s]] = edge_labels != NULL ? new std::string(edge_labels[e]) : NULL;
+            outk[s]++;
+            graph->in_adj_list[t][ink[t]] = s;
+            ink[t]++;
+        }
+    }
+    free(outk);
+    free(ink);
+
+    return graph;
+};
+
+/*
+ * Owning graph from CSR arrays: the out neighbours of node i are
+ * targets[offsets[i]] ... targets[offsets[i+1]-1], edge_labels (may be NULL) is
+ * aligned with targets. The CSR of an undirected graph lists every edge in both rows.
+ * Returns NULL if a target is not a node.
+ */
+inline Graph *build_graph_csr(int nof_nodes, const std::string *node_labels, const int *offsets, const int *targets, const std::string *edge_labels,
+                       bool directed) {
+    int nof_edges = offsets[nof_nodes] - offsets[0];
+    int *sources = (int *)malloc(nof_edges * sizeof(int));
+    for (int i = 0; i < nof_nodes; i++) {
+        for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+            sources[k - offsets[0]] = i;
+        }
+    }
+    // rows are already symmetric, so edges are added in one direction only
+    Graph *graph = build_graph(nof_nodes, node_labels, nof_edges, sources, targets + offsets[0], edge_labels != NULL ? edge_labels + offsets[0] : NULL,
+                               true);
+    free(sources);
+    return graph;
+};
+
+/*
+ * Graph over caller owned CSR arrays (see build_graph_csr), nothing is copied
+ * but the per node arrays, the in lists of directed graphs and the edge label pointers.
+ * node_labels may be NULL. Returns NULL if a target is not a node.
+ */
+inline Graph *view_graph_csr(int nof_nodes, const std::string *node_labels, const int *offsets, const int *targets, const std::string *edge_labels,
+                      bool directed) {
+    for (int k = offsets[0]; k < offsets[nof_nodes]; k++) {
+        if (targets[k] < 0 || targets[k] >= nof_nodes)
+            return NULL;
+    }
+
+    Graph *graph = new Graph();
+    graph->owns_data = false;
+    graph->nof_nodes = nof_nodes;
+
+    graph->nodes_attrs = (void **)malloc(nof_nodes * sizeof(void *));
+    for (int i = 0; i < nof_nodes; i++) {
+        graph->nodes_attrs[i] = (void *)(node_labels != NULL ? &node_labels[i] : &empty_graph_label());
+    }
+
+    int nof_edges = offsets[nof_nodes] - offsets[0];
+    graph->out_adj_sizes = (int *)malloc(nof_nodes * sizeof(int));
+    graph->in_adj_sizes = (int *)calloc(nof_nodes, sizeof(int));
+    graph->out_adj_list = (int **)malloc(nof_nodes * sizeof(int *));
+    graph->in_adj_list = (int **)malloc(nof_nodes * sizeof(int *));
+    graph->out_adj_attrs = (void ***)malloc(nof_nodes * sizeof(void **));
+
+    // edge label pointers, followed by the in lists when the graph is directed
+    graph->view_data = malloc(nof_edges * sizeof(void *) + (directed ? nof_edges * sizeof(int) : 0) + 1);
+    void **eattrs = (void **)graph->view_data;
+    int *inrows = (int *)(eattrs + nof_edges);
+
+    for (int i = 0; i < nof_nodes; i++) {
+        int first = offsets[i] - offsets[0];
+        graph->out_adj_sizes[i] = offsets[i + 1] - offsets[i];
+        graph->out_adj_list[i] = (int *)targets + offsets[i];
+        graph->out_adj_attrs[i] = eattrs + first;
+        for (int k = 0; k < graph->out_adj_sizes[i]; k++) {
+            eattrs[first + k] = edge_labels != NULL ? (void *)&edge_labels[offsets[i] + k] : NULL;
+        }
+    }
+
+    if (directed) {
+        for (int k = offsets[0]; k < offsets[nof_nodes]; k++) {
+            graph->in_adj_sizes[targets[k]]++;
+        }
+        int first = 0;
+        for (int i = 0; i < nof_nodes; i++) {
+            graph->in_adj_list[i] = inrows + first;
+            first += graph->in_adj_sizes[i];
+        }
+        int *ink = (int *)calloc(nof_nodes, sizeof(int));
+        for (int i = 0; i < nof_nodes; i++) {
+            for (int k = 0; k < graph->out_adj_sizes[i]; k++) {
+                int t = graph->out_adj_list[i][k];
+                graph->in_adj_list[t][ink[t]] = i;
+                ink[t]++;
+            }
+        }
+        free(ink);
+    } else {
+        // symmetric rows: the in lists are the out lists
+        for (int i = 0; i < nof_nodes; i++) {
+            graph->in_adj_sizes[i] = graph->out_adj_sizes[i];
+            graph->in_adj_list[i] = graph->out_adj_list[i];
+        }
+    }
+
+    return graph;
+};
+
+// incremental construction of an owning graph
+class GraphBuilder {
+    int nof_nodes;
+    bool directed;
+    std::vector<std::string> node_labels;
+    std::vector<int> sources;
+    std::vector<int> targets;
+    std::vector<std::string> edge_labels; // empty until an edge gets a label
+
+  public:
+    GraphBuilder(int _nof_nodes, bool _directed) : nof_nodes(_nof_nodes), directed(_directed), node_labels(_nof_nodes) {}
+
+    void reserve_edges(size_t n) {
+        sources.reserve(n);
+        targets.reserve(n);
+    }
+
+    void set_node_label(int n, const std::string &label) { node_labels[n] = label; }
+
+    void add_edge(int s, int t) {
+        sources.push_back(s);
+        targets.push_back(t);
+        if (!edge_labels.empty())
+            edge_labels.push_back(empty_graph_label());
+    }
+
+    void add_edge(int s, int t, const std::string &label) {
+        if (edge_labels.empty())
+            edge_labels.resize(sources.size());
+        sources.push_back(s);
+        targets.push_back(t);
+        edge_labels.push_back(label);
+    }
+
+    // NULL if an edge endpoint is not a node
+    Graph *build() {
+        return build_graph(nof_nodes, node_labels.empty() ? NULL : &node_labels[0], (int)sources.size(), sources.empty() ? NULL : &sources[0],
+                           targets.empty() ? NULL : &targets[0], edge_labels.empty() ? NULL : &edge_labels[0], directed);
+    }
+};
+
+} // namespace rilib
+
+#endif /* GRAPHBUILDER_H_ */
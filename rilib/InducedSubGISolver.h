@@ -38,9 +38,14 @@ namespace rilib {
 
 class InducedSubGISolver : public Solver {
   public:
-    InducedSubGISolver(MatchingMachine &_mama, Graph &_rgraph, Graph &_qgraph, AttributeComparator &_nodeComparator, AttributeComparator &_edgeComparator, MatchListener &_matchListener, sbitset *_domains, int *_domains_size, EdgeDomains &_edomains) : Solver(_mama, _rgraph, _qgraph, _nodeComparator, _edgeComparator, _matchListener, _domains, _domains_size, _edomains) {}
+    InducedSubGISolver(MatchingMachine &_mama, Graph &_rgraph, Graph &_qgraph, AttributeComparator &_nodeComparator, AttributeComparator &_edgeComparator, MatchListener &_matchListener, sbitset *_domains, int *_domains_size, EdgeDomains &_edomains, Arena *_arena = NULL) : Solver(_mama, _rgraph, _qgraph, _nodeComparator, _edgeComparator, _matchListener, _domains, _domains_size, _edomains, _arena) { keep_neighs = true; }
 
-    virtual bool edgesCheck(int si, int ci, int *solution, bool *matched) {
+    virtual bool edgesCheck(int si, int ci, int *solution, bool *matched) { return countsCheck(ci, mama.o_edges_sizes[si], mama.i_edges_sizes[si], matched); }
+
+    virtual bool countsCheck(int ci, int o_edges, int i_edges, bool *matched) {
+        // kept on each assignment by set_matched
+        if (o_matched_neighs != NULL)
+            return o_matched_neighs[ci] <= o_edges && i_matched_neighs[ci] <= i_edges;
 
         int ii;
 
@@ -48,7 +53,7 @@ class InducedSubGISolver : public Solver {
         for (ii = 0; ii < rgraph.out_adj_sizes[ci]; ii++) {
             if (matched[rgraph.out_adj_list[ci][ii]]) {
                 count++;
-                if (count > mama.o_edges_sizes[si])
+                if (count > o_edges)
                     return false;
             }
         }
@@ -56,13 +61,25 @@ class InducedSubGISolver : public Solver {
         for (ii = 0; ii < rgraph.in_adj_sizes[ci]; ii++) {
             if (matched[rgraph.in_adj_list[ci][ii]]) {
                 count++;
-                if (count > mama.i_edges_sizes[si])
+                if (count > i_edges)
                     return false;
             }
         }
 
         return true;
     }
+
+    // the count of matched reference neighbours depends on the states holding them
+    virtual void edgesReasons(int ci, bool *matched, int *matched_state, unsigned long *failing) {
+        for (int ii = 0; ii < rgraph.out_adj_sizes[ci]; ii++) {
+            if (matched[rgraph.out_adj_list[ci][ii]])
+                set_bit(failing, matched_state[rgraph.out_adj_list[ci][ii]]);
+        }
+        for (int ii = 0; ii < rgraph.in_adj_sizes[ci]; ii++) {
+            if (matched[rgraph.in_adj_list[ci][ii]])
+                set_bit(failing, matched_state[rgraph.in_adj_list[ci][ii]]);
+        }
+    }
 };
 
 } // namespace rilib
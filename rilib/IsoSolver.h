@@ -0,0 +1,178 @@
+/*
+ * IsoSolver.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef ISOSOLVER_H_
+#define ISOSOLVER_H_
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+#include <vector>
+
+#include "AttributeComparator.h"
+#include "Automorphisms.h"
+#include "Deadline.h"
+#include "Graph.h"
+#include "MatchListener.h"
+
+/*
+ * Isomorphisms between a query and a reference graph of the same size, by colour
+ * refinement and individualisation. The two graphs are refined together as one
+ * disjoint union, after a check of their degrees, so a colour stands for the same class of nodes in both of them,
+ * and the graphs are rejected as soon as a colour has a different number of nodes
+ * in each one. Otherwise a query node x of the smallest cell is given a new colour
+ * together with each reference node y of its cell in turn, and the colours are
+ * refined again. When every cell holds one query node and one reference node, the
+ * stable colouring is an isomorphism. Distinct branches give distinct bijections,
+ * so every isomorphism is found once.
+ */
+
+namespace rilib {
+
+class IsoSolver {
+    Graph &rgraph;
+    Graph &qgraph;
+    AttributeComparator &nodeComparator;
+    AttributeComparator &edgeComparator;
+    MatchListener &matchListener;
+    AutomorphismSearch *search; // query nodes first, then the reference nodes
+    int n;                      // nodes of each graph
+    std::vector<int> qIDs, rIDs;
+
+  public:
+    long steps;          // refined colourings
+    long triedcouples;   // individualised couples
+    long matchedcouples; // individualised couples which kept the colours balanced
+
+    long matchcount;
+    long match_limit;   // stop after this many matches, 0 to find them all
+    bool first_only;    // stop at the first isomorphism
+    Deadline *deadline; // stop the search once it is over, NULL for no time limit
+
+    IsoSolver(Graph &_rgraph, Graph &_qgraph, AttributeComparator &_nodeComparator, AttributeComparator &_edgeComparator, MatchListener &_matchListener)
+        : rgraph(_rgraph), qgraph(_qgraph), nodeComparator(_nodeComparator), edgeComparator(_edgeComparator), matchListener(_matchListener) {
+        search = NULL;
+        n = qgraph.nof_nodes;
+        steps = 0;
+        triedcouples = 0;
+        matchedcouples = 0;
+
+        matchcount = 0;
+        match_limit = 0;
+        first_only = false;
+        deadline = NULL;
+    }
+
+    void solve() {
+        matchcount = 0;
+        if (rgraph.nof_nodes != n || degrees(rgraph) != degrees(qgraph))
+            return;
+        AutomorphismSearch union_search(qgraph, rgraph, nodeComparator, edgeComparator, LONG_MAX);
+        search = &union_search;
+        std::vector<int> colours;
+        int k = search->initial_colours(colours);
+        steps++;
+        if (balanced(colours, k))
+            expand(colours, k);
+        search = NULL;
+    }
+
+  private:
+    // sorted (out, in) degrees of the nodes, most graphs of a different shape are told apart by them
+    static std::vector<std::pair<int, int> > degrees(Graph &g) {
+        std::vector<std::pair<int, int> > d(g.nof_nodes);
+        for (int i = 0; i < g.nof_nodes; i++)
+            d[i] = std::pair<int, int>(g.out_adj_sizes[i], g.in_adj_sizes[i]);
+        std::sort(d.begin(), d.end());
+        return d;
+    }
+
+    // each colour has as many query nodes as reference nodes
+    bool balanced(std::vector<int> &colours, int k) {
+        std::vector<int> sizes(k, 0);
+        for (int i = 0; i < n; i++)
+            sizes[colours[i]]++;
+        for (int i = n; i < 2 * n; i++) {
+            if (--sizes[colours[i]] < 0)
+                return false;
+        }
+        return true;
+    }
+
+    // returns true to stop the search
+    bool expand(std::vector<int> &colours, int k) {
+        if (k == n) {
+            qIDs.resize(n);
+            rIDs.resize(n);
+            for (int i = 0; i < n; i++)
+                qIDs[colours[i]] = i;
+            for (int i = n; i < 2 * n; i++)
+                rIDs[colours[i]] = i - n;
+            if (matchListener.wants_matches)
+                matchListener.match(n, qIDs.data(), rIDs.data());
+            matchcount++;
+            return first_only || (match_limit > 0 && matchcount >= match_limit);
+        }
+
+        // the query node of the smallest cell, the one with the lowest colour on ties
+        std::vector<int> sizes(k, 0);
+        for (int i = 0; i < n; i++)
+            sizes[colours[i]]++;
+        int x = -1;
+        for (int i = 0; i < n; i++) {
+            if (sizes[colours[i]] > 1 && (x == -1 || sizes[colours[i]] < sizes[colours[x]] || (sizes[colours[i]] == sizes[colours[x]] && colours[i] < colours[x])))
+                x = i;
+        }
+
+        for (int y = n; y < 2 * n; y++) {
+            if (colours[y] != colours[x])
+                continue;
+            triedcouples++;
+            std::vector<int> next = colours;
+            int nk = k;
+            search->individualize(next, nk, x, y);
+            steps++;
+            if (!balanced(next, nk))
+                continue;
+            matchedcouples++;
+            if (deadline != NULL && deadline->over())
+                return true;
+            if (expand(next, nk))
+                return true;
+        }
+        return false;
+    }
+};
+
+} // namespace rilib
+
+#endif /* ISOSOLVER_H_ */
@@ -37,6 +37,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "MatchingMachine.h"
 #include "sbitset.h"
 #include <math.h>
+#include <set>
+#include <vector>
 
 namespace rilib {
 
@@ -54,181 +56,59 @@ class MaMaAngularCoefficient : public MatchingMachine {
         std::cout << "init mama...\n";
 #endif
 
-        enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
-        NodeFlag *node_flags = new NodeFlag[nof_sn]; // indexed by node_id
+        node_flags = new NodeFlag[nof_sn]; // indexed by node_id
+        double *cws = new double[nof_sn];
+        double *outs = new double[nof_sn];
+        double *tcs = new double[nof_sn];
+        touched = new int[nof_sn];
+        touched_stamp = 0;
 
         for (int n = 0; n < nof_sn; n++) {
             node_flags[n] = NS_UNV;
             map_node_to_state[n] = nof_sn;
             map_state_to_node[n] = nof_sn;
+            touched[n] = 0;
         }
 
-        int nn;
+        // the score of the first node of a connected component does not depend on the flags
+        ScoreQueue unvs(tcs, NULL);
+        ScoreQueue cneighs(cws, outs);
+        for (int n = 0; n < nof_sn; n++) {
+            double n_out = ssg.out_adj_sizes[n] + ssg.in_adj_sizes[n];
+            double w_out = 0.0;
+            for (int ni = 0; ni < ssg.out_adj_sizes[n]; ni++) {
+                w_out += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[n][ni]].size());
+            }
+            for (int ni = 0; ni < ssg.in_adj_sizes[n]; ni++) {
+                w_out += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[n][ni]].size());
+            }
+            tcs[n] = (n_out * n_out) / (w_out);
+            unvs.insert(n);
+        }
 
         int si = 0;
         for (int n = 0; n < nof_sn; n++) {
             if (domains_size[n] == 1) {
-                map_node_to_state[n] = si;
-                map_state_to_node[si] = n;
+                push_node_to_core(n, si, ssg, unvs, cneighs);
                 si++;
-
-                node_flags[n] = NS_CORE;
-                for (int ni = 0; ni < ssg.out_adj_sizes[n]; ni++) {
-                    nn = ssg.out_adj_list[n][ni];
-                    if (node_flags[nn] != NS_CORE) {
-                        node_flags[nn] = NS_CNEIGH;
-                    }
-                }
-                for (int ni = 0; ni < ssg.in_adj_sizes[n]; ni++) {
-                    nn = ssg.in_adj_list[n][ni];
-                    if (node_flags[nn] != NS_CORE) {
-                        node_flags[nn] = NS_CNEIGH;
-                    }
-                }
             }
         }
 
-        double max_weight, max_out;
-
-        double cw, tc, tn;
-        double n_core, n_neigh, n_out;
-        double w_core, w_neigh, w_out;
-        int max_node;
-
         for (; si < nof_sn; si++) {
-            max_node = -1;
-
-            for (int n = 0; n < nof_sn; n++) {
-                if (node_flags[n] == NS_CNEIGH) {
-
-                    n_core = 0.0;
-                    n_neigh = 0.0;
-                    n_out = 0.0;
-                    w_core = 0.0;
-                    w_neigh = 0.0;
-                    w_out = 0.0;
-
-                    for (int ni = 0; ni < ssg.out_adj_sizes[n]; ni++) {
-                        nn = ssg.out_adj_list[n][ni];
-                        if (node_flags[nn] == NS_CORE) {
-                            n_core++;
-                            w_core += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[n][ni]].size());
-                        } else if (node_flags[nn] == NS_CNEIGH) {
-                            n_neigh++;
-                            w_neigh += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[n][ni]].size());
-                        } else {
-                            n_out++;
-                            w_out += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[n][ni]].size());
-                        }
-                    }
-                    for (int ni = 0; ni < ssg.in_adj_sizes[n]; ni++) {
-                        nn = ssg.in_adj_list[n][ni];
-                        if (node_flags[nn] == NS_CORE) {
-                            n_core++;
-                            w_core += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[n][ni]].size());
-                        } else if (node_flags[nn] == NS_CNEIGH) {
-                            n_neigh++;
-                            w_neigh += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[n][ni]].size());
-                        } else {
-                            n_out++;
-                            w_out += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[n][ni]].size());
-                        }
-                    }
-
-                    tc = (n_core * n_core) / (w_core);
-                    tn = (n_neigh * n_neigh) / (w_neigh);
-                    cw = sqrt((tc * tc) + (tn * tn)) / ((double)domains_size[n]);
-
-                    if ((max_node == -1)) {
-                        max_node = n;
-                        max_weight = cw;
-                        max_out = (n_out * n_out) / w_out;
-                    } else {
-                        if (max_weight < cw) {
-                            max_node = n;
-                            max_weight = cw;
-                            max_out = (n_out * n_out) / w_out;
-                        } else if (max_weight == cw) {
-                            if (max_out < (n_out * n_out) / w_out) {
-                                max_node = n;
-                                max_weight = cw;
-                                max_out = (n_out * n_out) / w_out;
-                            }
-                        }
-                    }
-                }
-            }
-
-            if (max_node != -1) {
-                int n = max_node;
-                map_node_to_state[n] = si;
-                map_state_to_node[si] = n;
-                node_flags[n] = NS_CORE;
-                for (int ni = 0; ni < ssg.out_adj_sizes[n]; ni++) {
-                    nn = ssg.out_adj_list[n][ni];
-                    if (node_flags[nn] != NS_CORE) {
-                        node_flags[nn] = NS_CNEIGH;
-                    }
-                }
-                for (int ni = 0; ni < ssg.in_adj_sizes[n]; ni++) {
-                    nn = ssg.in_adj_list[n][ni];
-                    if (node_flags[nn] != NS_CORE) {
-                        node_flags[nn] = NS_CNEIGH;
-                    }
-                }
-            } else {
+            int max_node = cneighs.best();
+            if (max_node == -1) {
                 // first node or new connected component
-
-                for (int n = 0; n < nof_sn; n++) {
-                    if (node_flags[n] == NS_UNV) {
-
-                        n_out = 0.0;
-                        w_out = 0.0;
-
-                        for (int ni = 0; ni < ssg.out_adj_sizes[n]; ni++) {
-                            nn = ssg.out_adj_list[n][ni];
-                            n_out++;
-                            w_out += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[n][ni]].size());
-                        }
-                        for (int ni = 0; ni < ssg.in_adj_sizes[n]; ni++) {
-                            nn = ssg.in_adj_list[n][ni];
-                            n_out++;
-                            w_out += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[n][ni]].size());
-                        }
-
-                        tc = (n_out * n_out) / (w_out);
-
-                        if ((max_node == -1)) {
-                            max_node = n;
-                            max_weight = tc;
-                        } else {
-                            if (max_weight < tc) {
-                                max_node = n;
-                                max_weight = tc;
-                            }
-                        }
-                    }
-                }
-
-                int n = max_node;
-                map_node_to_state[n] = si;
-                map_state_to_node[si] = n;
-                node_flags[n] = NS_CORE;
-                for (int ni = 0; ni < ssg.out_adj_sizes[n]; ni++) {
-                    nn = ssg.out_adj_list[n][ni];
-                    if (node_flags[nn] != NS_CORE) {
-                        node_flags[nn] = NS_CNEIGH;
-                    }
-                }
-                for (int ni = 0; ni < ssg.in_adj_sizes[n]; ni++) {
-                    nn = ssg.in_adj_list[n][ni];
-                    if (node_flags[nn] != NS_CORE) {
-                        node_flags[nn] = NS_CNEIGH;
-                    }
-                }
+                max_node = unvs.best();
             }
+            push_node_to_core(max_node, si, ssg, unvs, cneighs);
         }
 
+        delete[] cws;
+        delete[] outs;
+        delete[] tcs;
+        delete[] touched;
+
+        int nn;
         for (int si = 0; si < nof_sn; si++) {
             parent_state[si] = -1;
             parent_type[si] = PARENTTYPE_NULL;
@@ -354,6 +234,181 @@ class MaMaAngularCoefficient : public MatchingMachine {
 
         delete[] node_flags;
     }
+
+  private:
+    // cw and out are NaN when a node has no edges of that kind, then they never win a comparison
+    static bool is_nan(double v) { return v != v; }
+
+    // decreasing weight, then increasing node id
+    struct WeightOrder {
+        double *cws;
+        WeightOrder(double *_cws) : cws(_cws) {}
+        bool operator()(int n1, int n2) const {
+            if (cws[n1] != cws[n2])
+                return cws[n1] > cws[n2];
+            return n1 < n2;
+        }
+    };
+
+    // decreasing weight, decreasing out with NaN last, then increasing node id
+    struct OutOrder {
+        double *cws;
+        double *outs;
+        OutOrder(double *_cws, double *_outs) : cws(_cws), outs(_outs) {}
+        bool operator()(int n1, int n2) const {
+            if (cws[n1] != cws[n2])
+                return cws[n1] > cws[n2];
+            double o1 = is_nan(outs[n1]) ? -1.0 : outs[n1];
+            double o2 = is_nan(outs[n2]) ? -1.0 : outs[n2];
+            if (o1 != o2)
+                return o1 > o2;
+            return n1 < n2;
+        }
+    };
+
+    /*
+     * Candidates sorted to give the node of a linear scan by increasing id which keeps the first node
+     * and replaces it by a node with a greater weight, or with an equal weight and a greater out.
+     * The scores of a node must not change while it is in the queue.
+     */
+    class ScoreQueue {
+        double *cws;
+        double *outs; // NULL if only the weight is compared
+        std::set<int> ids;
+        std::set<int, WeightOrder> by_weight;
+        std::set<int, OutOrder> by_out;
+
+      public:
+        ScoreQueue(double *_cws, double *_outs) : cws(_cws), outs(_outs), by_weight(WeightOrder(_cws)), by_out(OutOrder(_cws, _outs)) {}
+
+        void insert(int n) {
+            ids.insert(n);
+            if (!is_nan(cws[n])) {
+                by_weight.insert(n);
+                if (outs != NULL)
+                    by_out.insert(n);
+            }
+        }
+
+        void erase(int n) {
+            if (ids.erase(n) && !is_nan(cws[n])) {
+                by_weight.erase(n);
+                if (outs != NULL)
+                    by_out.erase(n);
+            }
+        }
+
+        double &cws_of(int n) { return cws[n]; }
+        double &outs_of(int n) { return outs[n]; }
+
+        int best() {
+            if (ids.empty())
+                return -1;
+            int first = *ids.begin();
+            if (is_nan(cws[first]))
+                return first;
+            int max_node = *by_weight.begin();
+            if (outs == NULL || is_nan(outs[max_node]))
+                return max_node;
+            return *by_out.begin();
+        }
+    };
+
+    enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
+
+    NodeFlag *node_flags;
+    int *touched;
+    int touched_stamp;
+
+    // the scores of the neighbours of the nodes whose flag changes are computed again
+    void push_node_to_core(int n, int si, Graph &ssg, ScoreQueue &unvs, ScoreQueue &cneighs) {
+        std::vector<int> changed;
+        changed.push_back(n);
+        for (int ni = 0; ni < ssg.out_adj_sizes[n]; ni++) {
+            if (node_flags[ssg.out_adj_list[n][ni]] == NS_UNV && ssg.out_adj_list[n][ni] != n)
+                changed.push_back(ssg.out_adj_list[n][ni]);
+        }
+        for (int ni = 0; ni < ssg.in_adj_sizes[n]; ni++) {
+            if (node_flags[ssg.in_adj_list[n][ni]] == NS_UNV && ssg.in_adj_list[n][ni] != n)
+                changed.push_back(ssg.in_adj_list[n][ni]);
+        }
+
+        touched_stamp++;
+        std::vector<int> affected;
+        for (size_t c = 0; c < changed.size(); c++) {
+            int m = changed[c];
+            touch(m, affected, unvs, cneighs);
+            for (int ni = 0; ni < ssg.out_adj_sizes[m]; ni++)
+                touch(ssg.out_adj_list[m][ni], affected, unvs, cneighs);
+            for (int ni = 0; ni < ssg.in_adj_sizes[m]; ni++)
+                touch(ssg.in_adj_list[m][ni], affected, unvs, cneighs);
+        }
+
+        map_node_to_state[n] = si;
+        map_state_to_node[si] = n;
+        node_flags[n] = NS_CORE;
+        for (size_t c = 1; c < changed.size(); c++)
+            node_flags[changed[c]] = NS_CNEIGH;
+
+        for (size_t a = 0; a < affected.size(); a++) {
+            int m = affected[a];
+            if (node_flags[m] == NS_UNV) {
+                unvs.insert(m);
+            } else if (node_flags[m] == NS_CNEIGH) {
+                get_scores(m, ssg, cneighs);
+                cneighs.insert(m);
+            }
+        }
+    }
+
+    void touch(int n, std::vector<int> &affected, ScoreQueue &unvs, ScoreQueue &cneighs) {
+        if (touched[n] == touched_stamp)
+            return;
+        touched[n] = touched_stamp;
+        affected.push_back(n);
+        if (node_flags[n] == NS_UNV)
+            unvs.erase(n);
+        else if (node_flags[n] == NS_CNEIGH)
+            cneighs.erase(n);
+    }
+
+    void get_scores(int n, Graph &ssg, ScoreQueue &cneighs) {
+        double n_core = 0.0, n_neigh = 0.0, n_out = 0.0;
+        double w_core = 0.0, w_neigh = 0.0, w_out = 0.0;
+        int nn;
+
+        for (int ni = 0; ni < ssg.out_adj_sizes[n]; ni++) {
+            nn = ssg.out_adj_list[n][ni];
+            if (node_flags[nn] == NS_CORE) {
+                n_core++;
+                w_core += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[n][ni]].size());
+            } else if (node_flags[nn] == NS_CNEIGH) {
+                n_neigh++;
+                w_neigh += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[n][ni]].size());
+            } else {
+                n_out++;
+                w_out += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[n][ni]].size());
+            }
+        }
+        for (int ni = 0; ni < ssg.in_adj_sizes[n]; ni++) {
+            nn = ssg.in_adj_list[n][ni];
+            if (node_flags[nn] == NS_CORE) {
+                n_core++;
+                w_core += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[n][ni]].size());
+            } else if (node_flags[nn] == NS_CNEIGH) {
+                n_neigh++;
+                w_neigh += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[n][ni]].size());
+            } else {
+                n_out++;
+                w_out += 1.0 / ((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[n][ni]].size());
+            }
+        }
+
+        double tc = (n_core * n_core) / (w_core);
+        double tn = (n_neigh * n_neigh) / (w_neigh);
+        cneighs.cws_of(n) = sqrt((tc * tc) + (tn * tn)) / ((double)domains_size[n]);
+        cneighs.outs_of(n) = (n_out * n_out) / w_out;
+    }
 };
 
 } // namespace rilib
@@ -0,0 +1,406 @@
+/*
+ * MaMaCardinality.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef MAMACARDINALITY_H_
+#define MAMACARDINALITY_H_
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "Domains.h"
+#include "Graph.h"
+#include "MatchingMachine.h"
+#include "sbitset.h"
+
+namespace rilib {
+
+/*
+ * Ordering which minimises the estimated size of the search tree, computed from
+ * the edge domains of the (query, reference) pair. Reaching a node n from an
+ * ordered neighbour p gives, on average, fanout(p,n) candidates per image of p:
+ * the pairs in the domain of the edge over the distinct images of p in it. Every
+ * other ordered neighbour q keeps a candidate with the selectivity of the edge,
+ * |edge domain| / (D(q) D(n)). The size of the tree is the sum of the partial
+ * solutions over the states. The best order is found exactly, by dynamic
+ * programming over the sets of ordered nodes, up to max_exact_nodes query nodes,
+ * and by a beam search above. The beam is beam_width wide up to max_beam_nodes
+ * and narrower on larger queries, so that they take about the same time. Once
+ * it would be narrower than min_beam_width (above 512 nodes) the order is built
+ * greedily, by the lowest expected candidates.
+ */
+class MaMaCardinality : public MatchingMachine {
+    sbitset *domains;
+    int *domains_size;
+    EdgeDomains &edomains;
+
+    // neighbours of each node sorted by id, as in compressed sparse rows
+    int *nbr_offsets; // [nof_sn + 1]
+    int *nbr_ids;
+    double *nbr_fanout; // candidates of the node per image of the neighbour
+    double *nbr_sel;    // probability that a pair (image of the neighbour, candidate of the node) is an edge
+
+  public:
+    static const int max_exact_nodes = 12;
+    static const int max_beam_nodes = 128;
+    static const int beam_width = 32;
+    static const int min_beam_width = 2;
+
+    // a step of the beam costs about width * nof_sn^2, as much as a full beam on max_beam_nodes nodes
+    static int beam_width_for(int nof_nodes) {
+        if (nof_nodes <= max_beam_nodes)
+            return beam_width;
+        return (int)((long)beam_width * max_beam_nodes * max_beam_nodes / ((long)nof_nodes * nof_nodes));
+    }
+
+    MaMaCardinality(Graph &query, sbitset *_domains, int *_domains_size, EdgeDomains &_edomains) : MatchingMachine(query), domains(_domains), domains_size(_domains_size), edomains(_edomains) {
+        nbr_offsets = NULL;
+        nbr_ids = NULL;
+        nbr_fanout = NULL;
+        nbr_sel = NULL;
+    }
+
+    virtual void build(Graph &ssg) {
+        edge_statistics(ssg);
+
+        int *order = new int[nof_sn];
+        int width = beam_width_for(nof_sn);
+        if (nof_sn <= max_exact_nodes)
+            exact_order(order);
+        else if (width >= min_beam_width)
+            beam_order(order, width);
+        else
+            greedy_order(order);
+
+        for (int si = 0; si < nof_sn; si++) {
+            map_state_to_node[si] = order[si];
+            map_node_to_state[order[si]] = si;
+        }
+
+        int e_count, o_e_count, i_e_count, n;
+        for (int si = 0; si < nof_sn; si++) {
+            n = map_state_to_node[si];
+
+            // the parent is the ordered neighbour with the lowest fan-out
+            int p = -1;
+            double p_fanout = 0;
+            for (int k = nbr_offsets[n]; k < nbr_offsets[n + 1]; k++) {
+                if (map_node_to_state[nbr_ids[k]] < si && (p == -1 || nbr_fanout[k] < p_fanout)) {
+                    p = nbr_ids[k];
+                    p_fanout = nbr_fanout[k];
+                }
+            }
+            if (p != -1) {
+                parent_state[si] = map_node_to_state[p];
+                parent_type[si] = PARENTTYPE_IN;
+                for (int i = 0; i < ssg.out_adj_sizes[p]; i++) {
+                    if (ssg.out_adj_list[p][i] == n)
+                        parent_type[si] = PARENTTYPE_OUT;
+                }
+            }
+
+            e_count = 0;
+            o_e_count = 0;
+            for (int i = 0; i < ssg.out_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.out_adj_list[n][i]] < si) {
+                    e_count++;
+                    o_e_count++;
+                }
+            }
+            i_e_count = 0;
+            for (int i = 0; i < ssg.in_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.in_adj_list[n][i]] < si) {
+                    e_count++;
+                    i_e_count++;
+                }
+            }
+
+            edges_sizes[si] = e_count;
+            o_edges_sizes[si] = o_e_count;
+            i_edges_sizes[si] = i_e_count;
+
+            edges[si] = new MaMaEdge[e_count];
+
+            e_count = 0;
+            for (int i = 0; i < ssg.out_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.out_adj_list[n][i]] < si) {
+                    edges[si][e_count].source = si;
+                    edges[si][e_count].target = map_node_to_state[ssg.out_adj_list[n][i]];
+                    e_count++;
+                }
+            }
+            for (int i = 0; i < ssg.in_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.in_adj_list[n][i]] < si) {
+                    edges[si][e_count].target = si;
+                    edges[si][e_count].source = map_node_to_state[ssg.in_adj_list[n][i]];
+                    e_count++;
+                }
+            }
+        }
+
+        delete[] order;
+        delete[] nbr_offsets;
+        delete[] nbr_ids;
+        delete[] nbr_fanout;
+        delete[] nbr_sel;
+        nbr_offsets = NULL;
+        nbr_ids = NULL;
+        nbr_fanout = NULL;
+        nbr_sel = NULL;
+    }
+
+  private:
+    struct NeighbourStat {
+        int node; // node whose candidates are counted
+        int nbr;
+        double fanout;
+        double sel;
+        bool operator<(const NeighbourStat &b) const {
+            if (node != b.node)
+                return node < b.node;
+            return nbr < b.nbr;
+        }
+    };
+
+    // fan-out and selectivity of every pair of adjacent query nodes, the tighter arc wins when both directions are edges
+    void edge_statistics(Graph &ssg) {
+        std::vector<NeighbourStat> stats;
+        std::unordered_set<int> sources, targets;
+        for (int a = 0; a < nof_sn; a++) {
+            for (int k = 0; k < ssg.out_adj_sizes[a]; k++) {
+                int b = ssg.out_adj_list[a][k];
+                if (b == a)
+                    continue;
+                unordered_edge_set &ed = edomains.domains[edomains.pattern_out_adj_eids[a][k]];
+                sources.clear();
+                targets.clear();
+                for (unordered_edge_set::iterator it = ed.begin(); it != ed.end(); it++) {
+                    sources.insert(it->first);
+                    targets.insert(it->second);
+                }
+                double size = (double)ed.size();
+                double ab = sources.empty() ? 0 : size / sources.size();
+                double ba = targets.empty() ? 0 : size / targets.size();
+                double s = (domains_size[a] > 0 && domains_size[b] > 0) ? size / ((double)domains_size[a] * domains_size[b]) : 0;
+                NeighbourStat to_b = {b, a, ab, s};
+                NeighbourStat to_a = {a, b, ba, s};
+                stats.push_back(to_b);
+                stats.push_back(to_a);
+            }
+        }
+        std::sort(stats.begin(), stats.end());
+
+        nbr_offsets = new int[nof_sn + 1];
+        nbr_ids = new int[stats.size()];
+        nbr_fanout = new double[stats.size()];
+        nbr_sel = new double[stats.size()];
+        int k = 0;
+        size_t i = 0;
+        for (int n = 0; n < nof_sn; n++) {
+            nbr_offsets[n] = k;
+            for (; i < stats.size() && stats[i].node == n; i++) {
+                if (k > nbr_offsets[n] && nbr_ids[k - 1] == stats[i].nbr) {
+                    nbr_fanout[k - 1] = std::min(nbr_fanout[k - 1], stats[i].fanout);
+                    nbr_sel[k - 1] = std::min(nbr_sel[k - 1], stats[i].sel);
+                } else {
+                    nbr_ids[k] = stats[i].nbr;
+                    nbr_fanout[k] = stats[i].fanout;
+                    nbr_sel[k] = std::min(1.0, stats[i].sel);
+                    k++;
+                }
+            }
+        }
+        nbr_offsets[nof_sn] = k;
+    }
+
+    // expected candidates of n, per partial solution over the nodes flagged in ordered
+    double extension(int n, bool *ordered) {
+        int p = -1;
+        for (int k = nbr_offsets[n]; k < nbr_offsets[n + 1]; k++) {
+            if (ordered[nbr_ids[k]] && (p == -1 || nbr_fanout[k] < nbr_fanout[p]))
+                p = k;
+        }
+        if (p == -1)
+            return domains_size[n];
+        double ext = nbr_fanout[p];
+        for (int k = nbr_offsets[n]; k < nbr_offsets[n + 1]; k++) {
+            if (k != p && ordered[nbr_ids[k]])
+                ext *= nbr_sel[k];
+        }
+        return ext;
+    }
+
+    void exact_order(int *order) {
+        int nof_sets = 1 << nof_sn;
+        double *cost = new double[nof_sets];     // tree size of the best order of the set
+        double *partials = new double[nof_sets]; // partial solutions at the end of that order
+        int *last = new int[nof_sets];           // last node of that order
+        for (int s = 0; s < nof_sets; s++)
+            last[s] = -1;
+        cost[0] = 0;
+        partials[0] = 1;
+        bool *ordered = new bool[nof_sn];
+        for (int s = 0; s < nof_sets - 1; s++) {
+            if (s != 0 && last[s] == -1)
+                continue;
+            for (int i = 0; i < nof_sn; i++)
+                ordered[i] = (s >> i) & 1;
+            for (int n = 0; n < nof_sn; n++) {
+                if (ordered[n])
+                    continue;
+                double p = partials[s] * extension(n, ordered);
+                double c = cost[s] + p;
+                int t = s | (1 << n);
+                if (last[t] == -1 || c < cost[t]) {
+                    cost[t] = c;
+                    partials[t] = p;
+                    last[t] = n;
+                }
+            }
+        }
+        int s = nof_sets - 1;
+        for (int si = nof_sn - 1; si >= 0; si--) {
+            order[si] = last[s];
+            s &= ~(1 << last[s]);
+        }
+        delete[] ordered;
+        delete[] cost;
+        delete[] partials;
+        delete[] last;
+    }
+
+    // partial order of the beam search, the ordered nodes are found through the parents
+    struct BeamEntry {
+        int parent; // index in the previous step
+        int node;   // last ordered node
+        double cost, partials;
+        unsigned long long set; // hash of the set of ordered nodes
+        bool operator<(const BeamEntry &b) const { return cost < b.cost; }
+    };
+
+    static unsigned long long node_hash(int n) {
+        unsigned long long z = (unsigned long long)n + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // keeps the width cheapest partial orders at each step, one for each set of ordered nodes
+    void beam_order(int *order, int width) {
+        std::vector<std::vector<BeamEntry> > steps(nof_sn + 1);
+        BeamEntry root = {-1, -1, 0, 1, 0};
+        steps[0].push_back(root);
+        std::unordered_map<unsigned long long, int> sets;
+        bool *ordered = new bool[nof_sn];
+        for (int i = 0; i < nof_sn; i++)
+            ordered[i] = false;
+        for (int si = 0; si < nof_sn; si++) {
+            std::vector<BeamEntry> &beam = steps[si];
+            std::vector<BeamEntry> &next = steps[si + 1];
+            sets.clear();
+            for (size_t b = 0; b < beam.size(); b++) {
+                set_ordered(steps, si, (int)b, ordered, true);
+                for (int n = 0; n < nof_sn; n++) {
+                    if (ordered[n])
+                        continue;
+                    double p = beam[b].partials * extension(n, ordered);
+                    double c = beam[b].cost + p;
+                    unsigned long long set = beam[b].set ^ node_hash(n);
+                    std::unordered_map<unsigned long long, int>::iterator it = sets.find(set);
+                    if (it != sets.end() && next[it->second].cost <= c)
+                        continue;
+                    BeamEntry e = {(int)b, n, c, p, set};
+                    if (it != sets.end()) {
+                        next[it->second] = e;
+                    } else {
+                        sets[set] = (int)next.size();
+                        next.push_back(e);
+                    }
+                }
+                set_ordered(steps, si, (int)b, ordered, false);
+            }
+            std::sort(next.begin(), next.end());
+            if ((int)next.size() > width)
+                next.resize(width);
+        }
+        int b = 0;
+        for (int si = nof_sn - 1; si >= 0; si--) {
+            order[si] = steps[si + 1][b].node;
+            b = steps[si + 1][b].parent;
+        }
+        delete[] ordered;
+    }
+
+    void set_ordered(std::vector<std::vector<BeamEntry> > &steps, int si, int b, bool *ordered, bool value) {
+        for (; si > 0; si--) {
+            ordered[steps[si][b].node] = value;
+            b = steps[si][b].parent;
+        }
+    }
+
+    // orders at each step the node with the lowest expected candidates, then the lowest id
+    void greedy_order(int *order) {
+        bool *ordered = new bool[nof_sn];
+        double *ext = new double[nof_sn];
+        std::set<std::pair<double, int> > queue;
+        for (int n = 0; n < nof_sn; n++) {
+            ordered[n] = false;
+            ext[n] = domains_size[n];
+            queue.insert(std::make_pair(ext[n], n));
+        }
+        for (int si = 0; si < nof_sn; si++) {
+            int n = queue.begin()->second;
+            queue.erase(queue.begin());
+            order[si] = n;
+            ordered[n] = true;
+            for (int k = nbr_offsets[n]; k < nbr_offsets[n + 1]; k++) {
+                int q = nbr_ids[k];
+                if (!ordered[q]) {
+                    queue.erase(std::make_pair(ext[q], q));
+                    ext[q] = extension(q, ordered);
+                    queue.insert(std::make_pair(ext[q], q));
+                }
+            }
+        }
+        delete[] ordered;
+        delete[] ext;
+    }
+};
+
+} // namespace rilib
+
+#endif /* MAMACARDINALITY_H_ */
@@ -35,6 +35,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "Graph.h"
 #include "sbitset.h"
 
+#include <algorithm>
+#include <set>
+#include <vector>
+
 namespace rilib {
 
 class MaMaConstrFirstDs : public MatchingMachine {
@@ -42,7 +46,10 @@ class MaMaConstrFirstDs : public MatchingMachine {
     int *domains_size;
 
   public:
-    MaMaConstrFirstDs(Graph &query, sbitset *_domains, int *_domains_size) : MatchingMachine(query), domains(_domains), domains_size(_domains_size) {}
+    MaMaConstrFirstDs(Graph &query, sbitset *_domains, int *_domains_size) : MatchingMachine(query), domains(_domains), domains_size(_domains_size) {
+        node_flags = NULL;
+        weights = NULL;
+    }
 
     virtual void build(Graph &ssg) {
 
@@ -50,9 +57,8 @@ class MaMaConstrFirstDs : public MatchingMachine {
         std::cout << "init mama...\n";
 #endif
 
-        enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
-        NodeFlag *node_flags = new NodeFlag[nof_sn];                  // indexed by node_id
-        int **weights = new int *[nof_sn];                            // indexed by node_id
+        node_flags = new NodeFlag[nof_sn];                            // indexed by node_id
+        weights = new int[nof_sn * 3];                                // indexed by node_id * 3
         int *t_parent_node = (int *)calloc(nof_sn, sizeof(int));      // indexed by node_id
         MAMA_PARENTTYPE *t_parent_type = new MAMA_PARENTTYPE[nof_sn]; // indexed by node id
 
@@ -60,10 +66,9 @@ class MaMaConstrFirstDs : public MatchingMachine {
 
         for (int i = 0; i < nof_sn; i++) {
             node_flags[i] = NS_UNV;
-            weights[i] = new int[3];
-            weights[i][0] = 0;
-            weights[i][1] = 0;
-            weights[i][2] = ssg.out_adj_sizes[i] + ssg.in_adj_sizes[i];
+            weights[i * 3] = 0;
+            weights[i * 3 + 1] = 0;
+            weights[i * 3 + 2] = ssg.out_adj_sizes[i] + ssg.in_adj_sizes[i];
             t_parent_node[i] = -1;
             t_parent_type[i] = PARENTTYPE_NULL;
 
@@ -71,15 +76,16 @@ class MaMaConstrFirstDs : public MatchingMachine {
                 nof_single_domains++;
         }
 
+        // neighbours of the core, by decreasing weights
+        WeightOrder order(weights);
+        std::set<int, WeightOrder> queue(order);
+
         int si = 0;
         int n;
         int nIT;
         int ni;
         int nnIT;
         int nni;
-        int nqueueL = 0, nqueueR = 0;
-        int maxi, maxv;
-        int tmp;
 
 #ifdef MDEBUG
         std::cout << "single domains [" << nof_single_domains << "]...\n";
@@ -87,14 +93,11 @@ class MaMaConstrFirstDs : public MatchingMachine {
 
         if (nof_single_domains != 0) {
 
-            nqueueR = nof_single_domains;
-            // nqueueR = 0;
-
             for (int n = 0; n < nof_sn; n++) {
                 if (domains_size[n] == 1) {
 
 #ifdef MDEBUG
-                    std::cout << "nqueueR(" << nqueueR << ") node[" << n << "] si[" << si << "]\n";
+                    std::cout << "queue(" << queue.size() << ") node[" << n << "] si[" << si << "]\n";
 #endif
 
                     map_state_to_node[si] = n;
@@ -108,8 +111,7 @@ class MaMaConstrFirstDs : public MatchingMachine {
                     while (nIT < ssg.out_adj_sizes[n]) {
                         ni = ssg.out_adj_list[n][nIT];
                         if (ni != n && domains_size[ni] > 1) {
-                            weights[ni][0]++;
-                            weights[ni][1]--;
+                            update_weights(queue, ni, 1, -1);
 
                             if (node_flags[ni] == NS_UNV) {
                                 node_flags[ni] = NS_CNEIGH;
@@ -117,14 +119,12 @@ class MaMaConstrFirstDs : public MatchingMachine {
                                 t_parent_type[ni] = PARENTTYPE_OUT;
 
                                 // add to queue
-                                map_state_to_node[nqueueR] = ni;
-                                map_node_to_state[ni] = nqueueR;
-                                nqueueR++;
+                                queue.insert(ni);
 
                                 nnIT = 0;
                                 while (nnIT < ssg.out_adj_sizes[ni]) {
                                     nni = ssg.out_adj_list[ni][nnIT];
-                                    weights[nni][1]++;
+                                    update_weights(queue, nni, 0, 1);
                                     nnIT++;
                                 }
                             }
@@ -136,21 +136,18 @@ class MaMaConstrFirstDs : public MatchingMachine {
                     while (nIT < ssg.in_adj_sizes[n]) {
                         ni = ssg.in_adj_list[n][nIT];
                         if (ni != n && domains_size[ni] > 1) {
-                            weights[ni][0]++;
-                            weights[ni][1]--;
+                            update_weights(queue, ni, 1, -1);
 
                             if (node_flags[ni] == NS_UNV) {
                                 node_flags[ni] = NS_CNEIGH;
                                 t_parent_node[ni] = n;
                                 t_parent_type[ni] = PARENTTYPE_IN;
-                                map_state_to_node[nqueueR] = ni;
-                                map_node_to_state[ni] = nqueueR;
-                                nqueueR++;
+                                queue.insert(ni);
 
                                 nnIT = 0;
                                 while (nnIT < ssg.in_adj_sizes[ni]) {
                                     nni = ssg.in_adj_list[ni][nnIT];
-                                    weights[nni][1]++;
+                                    update_weights(queue, nni, 0, 1);
                                     nnIT++;
                                 }
                             }
@@ -162,91 +159,73 @@ class MaMaConstrFirstDs : public MatchingMachine {
                 }
             }
         }
-        nqueueL = nof_single_domains;
+
+        // nodes by decreasing degree, to start each connected component
+        std::vector<int> roots(nof_sn);
+        for (int i = 0; i < nof_sn; i++)
+            roots[i] = i;
+        std::stable_sort(roots.begin(), roots.end(), DegreeOrder(weights));
+        int rootIT = 0;
 
 #ifdef MDEBUG
         std::cout << "others...\n";
 #endif
         while (si < nof_sn) {
 
-            if (nqueueL == nqueueR) {
+            if (queue.empty()) {
                 // if queue is empty....
-                maxi = -1;
-                maxv = -1;
-                nIT = 0;
-                while (nIT < nof_sn) {
-                    if (node_flags[nIT] == NS_UNV && weights[nIT][2] > maxv) {
-                        maxv = weights[nIT][2];
-                        maxi = nIT;
-                    }
-                    nIT++;
-                }
-                map_state_to_node[si] = maxi;
-                map_node_to_state[maxi] = si;
-                t_parent_type[maxi] = PARENTTYPE_NULL;
-                t_parent_node[maxi] = -1;
+                while (node_flags[roots[rootIT]] != NS_UNV)
+                    rootIT++;
+                n = roots[rootIT];
+                t_parent_type[n] = PARENTTYPE_NULL;
+                t_parent_node[n] = -1;
 
-                nqueueR++;
-
-                n = maxi;
                 nIT = 0;
                 while (nIT < ssg.out_adj_sizes[n]) {
                     ni = ssg.out_adj_list[n][nIT];
                     if (ni != n) {
-                        weights[ni][1]++;
+                        update_weights(queue, ni, 0, 1);
                     }
                     nIT++;
                 }
                 while (nIT < ssg.in_adj_sizes[n]) {
                     ni = ssg.in_adj_list[n][nIT];
                     if (ni != n) {
-                        weights[ni][1]++;
+                        update_weights(queue, ni, 0, 1);
                     }
                     nIT++;
                 }
+            } else {
+                n = *queue.begin();
+                queue.erase(queue.begin());
             }
 
-            if (nqueueL != nqueueR - 1) {
-                maxi = nqueueL;
-                for (int mi = maxi + 1; mi < nqueueR; mi++) {
-                    if (wcompare(map_state_to_node[mi], map_state_to_node[maxi], weights) < 0) {
-                        maxi = mi;
-                    }
-                }
-                tmp = map_state_to_node[nqueueL];
-                map_state_to_node[nqueueL] = map_state_to_node[maxi];
-                map_state_to_node[maxi] = tmp;
-            }
-
+#ifdef MDEBUG
             std::cout << "<<<< " << si << " " << n << "\n";
+#endif
 
-            n = map_state_to_node[si];
+            map_state_to_node[si] = n;
             map_node_to_state[n] = si;
 
-            // move queue left limit
-            nqueueL++;
             // update nodes' flags & weights
             node_flags[n] = NS_CORE;
             nIT = 0;
             while (nIT < ssg.out_adj_sizes[n]) {
                 ni = ssg.out_adj_list[n][nIT];
                 if (ni != n) {
-                    weights[ni][0]++;
-                    weights[ni][1]--;
+                    update_weights(queue, ni, 1, -1);
 
                     if (node_flags[ni] == NS_UNV) {
                         node_flags[ni] = NS_CNEIGH;
                         t_parent_node[ni] = n;
                         t_parent_type[ni] = PARENTTYPE_OUT;
                         // add to queue
-                        map_state_to_node[nqueueR] = ni;
-                        map_node_to_state[ni] = nqueueR;
-                        nqueueR++;
+                        queue.insert(ni);
 
                         nnIT = 0;
                         while (nnIT < ssg.out_adj_sizes[ni]) {
                             nni = ssg.out_adj_list[ni][nnIT];
-                            weights[nni][1]++;
+                            update_weights(queue, nni, 0, 1);
                             nnIT++;
                         }
                     }
@@ -258,21 +237,18 @@ class MaMaConstrFirstDs : public MatchingMachine {
             while (nIT < ssg.in_adj_sizes[n]) {
                 ni = ssg.in_adj_list[n][nIT];
                 if (ni != n) {
-                    weights[ni][0]++;
-                    weights[ni][1]--;
+                    update_weights(queue, ni, 1, -1);
 
                     if (node_flags[ni] == NS_UNV) {
                         node_flags[ni] = NS_CNEIGH;
                         t_parent_node[ni] = n;
                         t_parent_type[ni] = PARENTTYPE_IN;
-                        map_state_to_node[nqueueR] = ni;
-                        map_node_to_state[ni] = nqueueR;
-                        nqueueR++;
+                        queue.insert(ni);
 
                         nnIT = 0;
                         while (nnIT < ssg.in_adj_sizes[ni]) {
                             nni = ssg.in_adj_list[ni][nnIT];
-                            weights[nni][1]++;
+                            update_weights(queue, nni, 0, 1);
                             nnIT++;
                         }
                     }
@@ -350,21 +326,45 @@ class MaMaConstrFirstDs : public MatchingMachine {
         }
 
         delete[] node_flags;
-        for (int i = 0; i < nof_sn; i++)
-            delete[] weights[i];
         delete[] weights;
         free(t_parent_node);
         delete[] t_parent_type;
     }
 
   private:
-    int wcompare(int i, int j, int **weights) {
-        for (int w = 0; w < 3; w++) {
-            if (weights[i][w] != weights[j][w]) {
-                return weights[j][w] - weights[i][w];
+    enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
+
+    NodeFlag *node_flags; // indexed by node_id, only during build
+    int *weights;         // indexed by node_id * 3, only during build
+
+    // decreasing weights, then increasing node id
+    struct WeightOrder {
+        int *weights;
+        WeightOrder(int *_weights) : weights(_weights) {}
+        bool operator()(int i, int j) const {
+            for (int w = 0; w < 3; w++) {
+                if (weights[i * 3 + w] != weights[j * 3 + w])
+                    return weights[i * 3 + w] > weights[j * 3 + w];
             }
+            return i < j;
         }
-        return i - j;
+    };
+
+    struct DegreeOrder {
+        int *weights;
+        DegreeOrder(int *_weights) : weights(_weights) {}
+        bool operator()(int i, int j) const { return weights[i * 3 + 2] > weights[j * 3 + 2]; }
+    };
+
+    // a queued node is taken out while its weights change, to keep the queue sorted
+    void update_weights(std::set<int, WeightOrder> &queue, int n, int d0, int d1) {
+        bool queued = (node_flags[n] == NS_CNEIGH);
+        if (queued)
+            queue.erase(n);
+        weights[n * 3] += d0;
+        weights[n * 3 + 1] += d1;
+        if (queued)
+            queue.insert(n);
     }
 };
 
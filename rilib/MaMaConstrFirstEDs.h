@@ -37,6 +37,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "MatchingMachine.h"
 #include "sbitset.h"
 
+#include <algorithm>
+#include <set>
+#include <vector>
+
 namespace rilib {
 
 class MaMaConstrFirstEDs : public MatchingMachine {
@@ -45,7 +49,10 @@ class MaMaConstrFirstEDs : public MatchingMachine {
     EdgeDomains &edge_domains;
 
   public:
-    MaMaConstrFirstEDs(Graph &query, sbitset *_domains, int *_domains_size, EdgeDomains &_edomains) : MatchingMachine(query), domains(_domains), domains_size(_domains_size), edge_domains(_edomains) {}
+    MaMaConstrFirstEDs(Graph &query, sbitset *_domains, int *_domains_size, EdgeDomains &_edomains) : MatchingMachine(query), domains(_domains), domains_size(_domains_size), edge_domains(_edomains) {
+        node_flags = NULL;
+        weights = NULL;
+    }
 
     virtual void build(Graph &ssg) {
 
@@ -53,9 +60,8 @@ class MaMaConstrFirstEDs : public MatchingMachine {
         std::cout << "init mama...\n";
 #endif
 
-        enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
-        NodeFlag *node_flags = new NodeFlag[nof_sn];                  // indexed by node_id
-        int **weights = new int *[nof_sn];                            // indexed by node_id
+        node_flags = new NodeFlag[nof_sn];                            // indexed by node_id
+        weights = new int[nof_sn * 3];                                // indexed by node_id * 3
         int *t_parent_node = (int *)calloc(nof_sn, sizeof(int));      // indexed by node_id
         MAMA_PARENTTYPE *t_parent_type = new MAMA_PARENTTYPE[nof_sn]; // indexed by node id
 
@@ -78,16 +84,15 @@ class MaMaConstrFirstEDs : public MatchingMachine {
 
         for (int i = 0; i < nof_sn; i++) {
             node_flags[i] = NS_UNV;
-            weights[i] = new int[3];
-            weights[i][0] = 0;
-            weights[i][1] = 0;
+            weights[i * 3] = 0;
+            weights[i * 3 + 1] = 0;
 
-            weights[i][2] = 0.0;
+            weights[i * 3 + 2] = 0.0;
             for (int j = 0; j < ssg.out_adj_sizes[i]; j++) {
-                weights[i][2] += o_query_e_weights[i][j];
+                weights[i * 3 + 2] += o_query_e_weights[i][j];
             }
             for (int j = 0; j < ssg.in_adj_sizes[i]; j++) {
-                weights[i][2] += i_query_e_weights[i][j];
+                weights[i * 3 + 2] += i_query_e_weights[i][j];
             }
 
             t_parent_node[i] = -1;
@@ -97,15 +102,16 @@ class MaMaConstrFirstEDs : public MatchingMachine {
                 nof_single_domains++;
         }
 
+        // neighbours of the core, by decreasing weights
+        WeightOrder order(weights);
+        std::set<int, WeightOrder> queue(order);
+
         int si = 0;
         int n;
         int nIT;
         int ni;
         int nnIT;
         int nni;
-        int nqueueL = 0, nqueueR = 0;
-        int maxi, maxv;
-        int tmp;
 
 #ifdef MDEBUG
         std::cout << "single domains [" << nof_single_domains << "]...\n";
@@ -113,13 +119,11 @@ class MaMaConstrFirstEDs : public MatchingMachine {
 
         if (nof_single_domains != 0) {
 
-            nqueueR = nof_single_domains;
-
             for (int n = 0; n < nof_sn; n++) {
                 if (domains_size[n] == 1) {
 
 #ifdef MDEBUG
-                    std::cout << "nqueueR(" << nqueueR << ") node[" << n << "] si[" << si << "]\n";
+                    std::cout << "queue(" << queue.size() << ") node[" << n << "] si[" << si << "]\n";
 #endif
 
                     map_state_to_node[si] = n;
@@ -133,24 +137,20 @@ class MaMaConstrFirstEDs : public MatchingMachine {
                     while (nIT < ssg.out_adj_sizes[n]) {
                         ni = ssg.out_adj_list[n][nIT];
                         if (ni != n && domains_size[ni] > 1) {
-                            weights[ni][0] += o_query_e_weights[n][nIT];
-                            weights[ni][1] -= o_query_e_weights[n][nIT];
+                            update_weights(queue, ni, o_query_e_weights[n][nIT], -o_query_e_weights[n][nIT]);
 
                             if (node_flags[ni] == NS_UNV) {
                                 node_flags[ni] = NS_CNEIGH;
                                 t_parent_node[ni] = n;
                                 t_parent_type[ni] = PARENTTYPE_OUT;
+
                                 // add to queue
-                                map_state_to_node[nqueueR] = ni;
-                                map_node_to_state[ni] = nqueueR;
-                                nqueueR++;
+                                queue.insert(ni);
 
                                 nnIT = 0;
                                 while (nnIT < ssg.out_adj_sizes[ni]) {
                                     nni = ssg.out_adj_list[ni][nnIT];
-
-                                    weights[nni][1] += o_query_e_weights[n][nnIT];
-
+                                    update_weights(queue, nni, 0, o_query_e_weights[ni][nnIT]);
                                     nnIT++;
                                 }
                             }
@@ -162,23 +162,18 @@ class MaMaConstrFirstEDs : public MatchingMachine {
                     while (nIT < ssg.in_adj_sizes[n]) {
                         ni = ssg.in_adj_list[n][nIT];
                         if (ni != n && domains_size[ni] > 1) {
-
-                            weights[ni][0] += i_query_e_weights[n][nIT];
-                            weights[ni][1] -= i_query_e_weights[n][nIT];
+                            update_weights(queue, ni, i_query_e_weights[n][nIT], -i_query_e_weights[n][nIT]);
 
                             if (node_flags[ni] == NS_UNV) {
                                 node_flags[ni] = NS_CNEIGH;
                                 t_parent_node[ni] = n;
                                 t_parent_type[ni] = PARENTTYPE_IN;
-                                // add to queue
-                                map_state_to_node[nqueueR] = ni;
-                                map_node_to_state[ni] = nqueueR;
-                                nqueueR++;
+                                queue.insert(ni);
 
                                 nnIT = 0;
                                 while (nnIT < ssg.in_adj_sizes[ni]) {
                                     nni = ssg.in_adj_list[ni][nnIT];
-                                    weights[nni][1] += i_query_e_weights[n][nnIT];
+                                    update_weights(queue, nni, 0, i_query_e_weights[ni][nnIT]);
                                     nnIT++;
                                 }
                             }
@@ -190,91 +185,73 @@ class MaMaConstrFirstEDs : public MatchingMachine {
                 }
             }
         }
-        nqueueL = nof_single_domains;
+
+        // nodes by decreasing degree, to start each connected component
+        std::vector<int> roots(nof_sn);
+        for (int i = 0; i < nof_sn; i++)
+            roots[i] = i;
+        std::stable_sort(roots.begin(), roots.end(), DegreeOrder(weights));
+        int rootIT = 0;
 
 #ifdef MDEBUG
         std::cout << "others...\n";
 #endif
         while (si < nof_sn) {
 
-            if (nqueueL == nqueueR) {
+            if (queue.empty()) {
                 // if queue is empty....
-                maxi = -1;
-                maxv = -1;
-                nIT = 0;
-                while (nIT < nof_sn) {
-                    if (node_flags[nIT] == NS_UNV && weights[nIT][2] > maxv) {
-                        maxv = weights[nIT][2];
-                        maxi = nIT;
-                    }
-                    nIT++;
-                }
-                map_state_to_node[si] = maxi;
-                map_node_to_state[maxi] = si;
-                t_parent_type[maxi] = PARENTTYPE_NULL;
-                t_parent_node[maxi] = -1;
+                while (node_flags[roots[rootIT]] != NS_UNV)
+                    rootIT++;
+                n = roots[rootIT];
+                t_parent_type[n] = PARENTTYPE_NULL;
+                t_parent_node[n] = -1;
 
-                nqueueR++;
-
-                n = maxi;
                 nIT = 0;
                 while (nIT < ssg.out_adj_sizes[n]) {
                     ni = ssg.out_adj_list[n][nIT];
                     if (ni != n) {
-                        weights[ni][1] += o_query_e_weights[n][nIT];
+                        update_weights(queue, ni, 0, o_query_e_weights[n][nIT]);
                     }
                     nIT++;
                 }
                 while (nIT < ssg.in_adj_sizes[n]) {
                     ni = ssg.in_adj_list[n][nIT];
                     if (ni != n) {
-                        weights[ni][1] += i_query_e_weights[n][nIT];
+                        update_weights(queue, ni, 0, i_query_e_weights[n][nIT]);
                     }
                     nIT++;
                 }
+            } else {
+                n = *queue.begin();
+                queue.erase(queue.begin());
             }
 
-            if (nqueueL != nqueueR - 1) {
-                maxi = nqueueL;
-                for (int mi = maxi + 1; mi < nqueueR; mi++) {
-                    if (wcompare(map_state_to_node[mi], map_state_to_node[maxi], weights) < 0) {
-                        maxi = mi;
-                    }
-                }
-                tmp = map_state_to_node[nqueueL];
-                map_state_to_node[nqueueL] = map_state_to_node[maxi];
-                map_state_to_node[maxi] = tmp;
-            }
+#ifdef MDEBUG
+            std::cout << "<<<< " << si << " " << n << "\n";
+#endif
 
-            n = map_state_to_node[si];
+            map_state_to_node[si] = n;
             map_node_to_state[n] = si;
 
-            // move queue left limit
-            nqueueL++;
             // update nodes' flags & weights
             node_flags[n] = NS_CORE;
             nIT = 0;
             while (nIT < ssg.out_adj_sizes[n]) {
                 ni = ssg.out_adj_list[n][nIT];
                 if (ni != n) {
-                    weights[ni][0] += o_query_e_weights[n][nIT];
-                    weights[ni][1] -= o_query_e_weights[n][nIT];
+                    update_weights(queue, ni, o_query_e_weights[n][nIT], -o_query_e_weights[n][nIT]);
 
                     if (node_flags[ni] == NS_UNV) {
                         node_flags[ni] = NS_CNEIGH;
                         t_parent_node[ni] = n;
-
                         t_parent_type[ni] = PARENTTYPE_OUT;
-
-                        map_state_to_node[nqueueR] = ni;
-                        map_node_to_state[ni] = nqueueR;
-                        nqueueR++;
+                        // add to queue
+                        queue.insert(ni);
 
                         nnIT = 0;
                         while (nnIT < ssg.out_adj_sizes[ni]) {
                             nni = ssg.out_adj_list[ni][nnIT];
-
-                            weights[nni][1] += o_query_e_weights[n][nIT];
+                            update_weights(queue, nni, 0, o_query_e_weights[n][nIT]);
                             nnIT++;
                         }
                     }
@@ -286,25 +263,18 @@ class MaMaConstrFirstEDs : public MatchingMachine {
             while (nIT < ssg.in_adj_sizes[n]) {
                 ni = ssg.in_adj_list[n][nIT];
                 if (ni != n) {
-
-                    weights[ni][0] += i_query_e_weights[n][nIT];
-                    weights[ni][1] -= i_query_e_weights[n][nIT];
+                    update_weights(queue, ni, i_query_e_weights[n][nIT], -i_query_e_weights[n][nIT]);
 
                     if (node_flags[ni] == NS_UNV) {
                         node_flags[ni] = NS_CNEIGH;
                         t_parent_node[ni] = n;
-
                         t_parent_type[ni] = PARENTTYPE_IN;
-
-                        // add to queue
-                        map_state_to_node[nqueueR] = ni;
-                        map_node_to_state[ni] = nqueueR;
-                        nqueueR++;
+                        queue.insert(ni);
 
                         nnIT = 0;
                         while (nnIT < ssg.in_adj_sizes[ni]) {
                             nni = ssg.in_adj_list[ni][nnIT];
-                            weights[nni][1] += i_query_e_weights[n][nIT];
+                            update_weights(queue, nni, 0, i_query_e_weights[n][nIT]);
                             nnIT++;
                         }
                     }
@@ -382,21 +352,51 @@ class MaMaConstrFirstEDs : public MatchingMachine {
         }
 
         delete[] node_flags;
-        for (int i = 0; i < nof_sn; i++)
-            delete[] weights[i];
         delete[] weights;
+        for (int i = 0; i < nof_sn; i++) {
+            delete[] o_query_e_weights[i];
+            delete[] i_query_e_weights[i];
+        }
+        delete[] o_query_e_weights;
+        delete[] i_query_e_weights;
         free(t_parent_node);
         delete[] t_parent_type;
     }
 
   private:
-    int wcompare(int i, int j, int **weights) {
-        for (int w = 0; w < 3; w++) {
-            if (weights[i][w] != weights[j][w]) {
-                return weights[j][w] - weights[i][w];
+    enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
+
+    NodeFlag *node_flags; // indexed by node_id, only during build
+    int *weights;         // indexed by node_id * 3, only during build
+
+    // decreasing weights, then increasing node id
+    struct WeightOrder {
+        int *weights;
+        WeightOrder(int *_weights) : weights(_weights) {}
+        bool operator()(int i, int j) const {
+            for (int w = 0; w < 3; w++) {
+                if (weights[i * 3 + w] != weights[j * 3 + w])
+                    return weights[i * 3 + w] > weights[j * 3 + w];
             }
+            return i < j;
         }
-        return i - j;
+    };
+
+    struct DegreeOrder {
+        int *weights;
+        DegreeOrder(int *_weights) : weights(_weights) {}
+        bool operator()(int i, int j) const { return weights[i * 3 + 2] > weights[j * 3 + 2]; }
+    };
+
+    // a queued node is taken out while its weights change, to keep the queue sorted
+    void update_weights(std::set<int, WeightOrder> &queue, int n, double d0, double d1) {
+        bool queued = (node_flags[n] == NS_CNEIGH);
+        if (queued)
+            queue.erase(n);
+        weights[n * 3] += d0;
+        weights[n * 3 + 1] += d1;
+        if (queued)
+            queue.insert(n);
     }
 };
 
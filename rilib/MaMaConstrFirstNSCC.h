@@ -35,6 +35,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "AttributeComparator.h"
 #include "Graph.h"
+#include "MaMaNodeSetQueue.h"
 #include "MatchingMachine.h"
 #include "sbitset.h"
 #include <algorithm>
@@ -44,8 +45,6 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 namespace rilib {
 
 class MaMaConstrFirstNSCC : public MatchingMachine {
-    enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
-
     sbitset *domains;
     int *domains_size;
 
@@ -55,10 +54,9 @@ class MaMaConstrFirstNSCC : public MatchingMachine {
   public:
     MaMaConstrFirstNSCC(Graph &query, sbitset *_domains, int *_domains_size, AttributeComparator &_nodeComparator, AttributeComparator &_edgeComparator) : MatchingMachine(query), domains(_domains), domains_size(_domains_size), nodeComparator(_nodeComparator), edgeComparator(_edgeComparator) {}
     virtual void build(Graph &ssg) {
-        NodeFlag *node_flags = new NodeFlag[nof_sn]; // indexed by node_id
+        NodeSetQueue queue(ssg, domains_size);
+        NodeSetQueue::NodeFlag *node_flags = queue.node_flags;
         for (int i = 0; i < nof_sn; i++) {
-            node_flags[i] = NS_UNV;
-
             // used for recognizing core compatibility parents
             parent_state[i] = -1;
         }
@@ -66,74 +64,30 @@ class MaMaConstrFirstNSCC : public MatchingMachine {
         int si = 0;
         for (int i = 0; i < nof_sn; i++) {
             if (domains_size[i] == 1) {
+#ifdef MDEBUG
                 std::cout << "ssi[" << si << "] = " << i << "\n";
-                push_node_to_core(i, si, node_flags, ssg, map_state_to_node, map_node_to_state);
+#endif
+                push_node_to_core(i, si, queue);
                 si++;
             }
         }
 
-        for (int i = 0; i < nof_sn; i++) {
-            std::cout << i << "[" << node_flags[i] << "] ";
-        }
-        std::cout << "\n";
-
         for (; si < nof_sn; si++) {
-            std::cout << "SI[" << si << "]\n";
-            int best_nid = -1;
-            int best_nid_score[] = {0, 0, 0, 0, 0};
-            int current_nid_score[] = {0, 0, 0, 0, 0};
-
-            for (int nid = 0; nid < nof_sn; nid++) {
-                std::cout << nid << "(" << node_flags[nid] << ") ";
-                get_scores(nid, current_nid_score, node_flags, ssg);
-                std::cout << "[";
-                for (int i = 0; i < 5; i++) {
-                    std::cout << current_nid_score[i] << " ";
-                }
-                std::cout << "]\n";
-            }
-
-            for (int nid = 0; nid < nof_sn; nid++) {
-                if (node_flags[nid] == NS_CNEIGH) {
-                    if (best_nid == -1) {
-                        best_nid = nid;
-                        get_scores(nid, best_nid_score, node_flags, ssg);
-                    } else {
-                        get_scores(nid, current_nid_score, node_flags, ssg);
-                        if (compare_scores(current_nid_score, best_nid_score, nid, best_nid) > 0) {
-                            best_nid = nid;
-                            for (int i = 0; i < 5; i++) {
-                                best_nid_score[i] = current_nid_score[i];
-                            }
-                        }
-                    }
-                }
-            }
-
-            if (best_nid == -1) { // firs node without singletons or disconnected query
-                for (int nid = 0; nid < nof_sn; nid++) {
-                    if (node_flags[nid] == NS_UNV) {
-                        if (best_nid == -1) {
-                            best_nid = nid;
-                            get_scores(nid, best_nid_score, node_flags, ssg);
-                        } else {
-                            get_scores(nid, current_nid_score, node_flags, ssg);
-                            if (compare_scores(current_nid_score, best_nid_score, nid, best_nid) > 0) {
-                                best_nid = nid;
-                                for (int i = 0; i < 5; i++) {
-                                    best_nid_score[i] = current_nid_score[i];
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+            // best core neighbour, or the first node without singletons or of a disconnected query
+            int best_nid = queue.best();
+#ifdef MDEBUG
             std::cout << "si[" << si << "] = " << best_nid << "\n";
+#endif
 
+            // a core compatible node shares the core edges of best_nid, so it is a neighbour of any of its core neighbours
             std::set<int> cascade;
-            if (best_nid_score[0] > 0) {
-                for (int i = 0; i < nof_sn; i++) {
-                    if ((i != best_nid) && (node_flags[i] == NS_CNEIGH)) {
+            if (queue.scores_of(best_nid)[0] > 0) {
+                int *cands;
+                int nof_cands;
+                get_cascade_candidates(best_nid, node_flags, ssg, cands, nof_cands);
+                for (int c = 0; c < nof_cands; c++) {
+                    int i = cands[c];
+                    if ((i != best_nid) && (node_flags[i] == NodeSetQueue::NS_CNEIGH) && (cascade.find(i) == cascade.end())) {
                         if (are_core_compatible(best_nid, i, node_flags, ssg)) {
                             cascade.insert(i);
                         }
@@ -141,24 +95,21 @@ class MaMaConstrFirstNSCC : public MatchingMachine {
                 }
             }
 
-            push_node_to_core(best_nid, si, node_flags, ssg, map_state_to_node, map_node_to_state);
+            push_node_to_core(best_nid, si, queue);
 
+#ifdef MDEBUG
             std::cout << "core compatible: ";
             for (auto &i : cascade) {
                 std::cout << i << " ";
             }
             std::cout << "\n";
+#endif
             int osi = si;
             for (auto &i : cascade) {
                 si++;
-                push_node_to_core(i, si, node_flags, ssg, map_state_to_node, map_node_to_state);
+                push_node_to_core(i, si, queue);
                 parent_state[si] = osi;
             }
-
-            for (int i = 0; i < nof_sn; i++) {
-                std::cout << i << "[" << node_flags[i] << "] ";
-            }
-            std::cout << "\n";
         }
 
         int e_count, o_e_count, i_e_count, n, nn;
@@ -207,81 +158,43 @@ class MaMaConstrFirstNSCC : public MatchingMachine {
                 }
             }
         }
+
     }
 
   private:
-    void push_node_to_core(int nid, int si, NodeFlag *node_flags, Graph &qg, int *map_state_to_node, int *map_node_to_state) {
-        node_flags[nid] = NS_CORE;
-
-        for (int i = 0; i < qg.out_adj_sizes[nid]; i++) {
-            if (node_flags[qg.out_adj_list[nid][i]] == NS_UNV) {
-                node_flags[qg.out_adj_list[nid][i]] = NS_CNEIGH;
-            }
-        }
-        for (int i = 0; i < qg.in_adj_sizes[nid]; i++) {
-            if (node_flags[qg.in_adj_list[nid][i]] == NS_UNV) {
-                node_flags[qg.in_adj_list[nid][i]] = NS_CNEIGH;
-            }
-        }
+    void push_node_to_core(int nid, int si, NodeSetQueue &queue) {
+        queue.push(nid);
         map_state_to_node[si] = nid;
         map_node_to_state[nid] = si;
     }
 
-    void get_scores(int nid, int *scores, NodeFlag *node_flags, Graph &qg) {
-        std::set<int> all;
-
-        std::set<int> cores;
-        std::set<int> neighs;
-        std::set<int> unvs;
-
+    void get_cascade_candidates(int nid, NodeSetQueue::NodeFlag *node_flags, Graph &qg, int *&cands, int &nof_cands) {
         for (int i = 0; i < qg.out_adj_sizes[nid]; i++) {
-            if (node_flags[qg.out_adj_list[nid][i]] == NS_CORE) {
-                cores.insert(qg.out_adj_list[nid][i]);
-            } else if (node_flags[qg.out_adj_list[nid][i]] == NS_CNEIGH) {
-                neighs.insert(qg.out_adj_list[nid][i]);
-            } else {
-                unvs.insert(qg.out_adj_list[nid][i]);
+            int x = qg.out_adj_list[nid][i];
+            if (node_flags[x] == NodeSetQueue::NS_CORE) {
+                cands = qg.in_adj_list[x];
+                nof_cands = qg.in_adj_sizes[x];
+                return;
             }
-            all.insert(qg.out_adj_list[nid][i]);
         }
-
         for (int i = 0; i < qg.in_adj_sizes[nid]; i++) {
-            if (node_flags[qg.in_adj_list[nid][i]] == NS_CORE) {
-                cores.insert(qg.in_adj_list[nid][i]);
-            } else if (node_flags[qg.in_adj_list[nid][i]] == NS_CNEIGH) {
-                neighs.insert(qg.in_adj_list[nid][i]);
-            } else {
-                unvs.insert(qg.in_adj_list[nid][i]);
-            }
-            all.insert(qg.in_adj_list[nid][i]);
-        }
-
-        scores[0] = cores.size();
-        scores[1] = neighs.size();
-        scores[2] = unvs.size();
-        scores[3] = all.size();
-        scores[4] = domains_size[nid];
-    }
-
-    int compare_scores(int *s1, int *s2, int n1, int n2) {
-        for (int i = 0; i < 4; i++) {
-            if (s1[i] != s2[i]) {
-                return s1[i] - s2[i];
+            int c = qg.in_adj_list[nid][i];
+            if (node_flags[c] == NodeSetQueue::NS_CORE) {
+                cands = qg.out_adj_list[c];
+                nof_cands = qg.out_adj_sizes[c];
+                return;
             }
         }
-        if (s1[4] != s2[4]) {
-            return s2[4] - s1[4];
-        }
-
-        return n2 - n1;
+        cands = NULL;
+        nof_cands = 0;
     }
 
-    bool are_core_compatible(int nid1, int nid2, NodeFlag *node_flags, Graph &qg) {
+    bool are_core_compatible(int nid1, int nid2, NodeSetQueue::NodeFlag *node_flags, Graph &qg) {
         if (nodeComparator.compare(qg.nodes_attrs[nid1], qg.nodes_attrs[nid2])) {
             bool found;
 
             for (int i = 0; i < qg.out_adj_sizes[nid1]; i++) {
-                if (node_flags[qg.out_adj_list[nid1][i]] == NS_CORE) {
+                if (node_flags[qg.out_adj_list[nid1][i]] == NodeSetQueue::NS_CORE) {
                     found = false;
                     for (int j = 0; j < qg.out_adj_sizes[nid2]; j++) {
                         if (qg.out_adj_list[nid2][j] == qg.out_adj_list[nid1][i]) {
@@ -297,8 +210,9 @@ class MaMaConstrFirstNSCC : public MatchingMachine {
                 }
             }
 
-            for (int c = 0; c < qg.nof_nodes; c++) {
-                if (node_flags[c] == NS_CORE) {
+            for (int ci = 0; ci < qg.in_adj_sizes[nid1]; ci++) {
+                int c = qg.in_adj_list[nid1][ci];
+                if (node_flags[c] == NodeSetQueue::NS_CORE) {
                     for (int i = 0; i < qg.out_adj_sizes[c]; i++) {
                         if (qg.out_adj_list[c][i] == nid1) {
 
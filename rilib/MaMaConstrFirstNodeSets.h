@@ -35,15 +35,13 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 // #define MAMACONSTRFIRSTNODESETS_H_MDEBUG 1
 
 #include "Graph.h"
+#include "MaMaNodeSetQueue.h"
 #include "MatchingMachine.h"
 #include "sbitset.h"
-#include <set>
 
 namespace rilib {
 
 class MaMaConstrFirstNodeSets : public MatchingMachine {
-    enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
-
     sbitset *domains;
     int *domains_size;
 
@@ -51,10 +49,7 @@ class MaMaConstrFirstNodeSets : public MatchingMachine {
     MaMaConstrFirstNodeSets(Graph &query, sbitset *_domains, int *_domains_size) : MatchingMachine(query), domains(_domains), domains_size(_domains_size) {}
 
     virtual void build(Graph &ssg) {
-        NodeFlag *node_flags = new NodeFlag[nof_sn]; // indexed by node_id
-        for (int i = 0; i < nof_sn; i++) {
-            node_flags[i] = NS_UNV;
-        }
+        NodeSetQueue queue(ssg, domains_size);
 
         int si = 0;
         for (int i = 0; i < nof_sn; i++) {
@@ -62,85 +57,18 @@ class MaMaConstrFirstNodeSets : public MatchingMachine {
 #ifdef MAMACONSTRFIRSTNODESETS_H_MDEBUG
                 std::cout << "ssi[" << si << "] = " << i << "\n";
 #endif
-                push_node_to_core(i, si, node_flags, ssg, map_state_to_node, map_node_to_state);
+                push_node_to_core(i, si, queue);
                 si++;
             }
         }
 
-#ifdef MAMACONSTRFIRSTNODESETS_H_MDEBUG
-        for (int i = 0; i < nof_sn; i++) {
-            std::cout << i << "[" << node_flags[i] << "] ";
-        }
-        std::cout << "\n";
-#endif
-
         for (; si < nof_sn; si++) {
-
-#ifdef MAMACONSTRFIRSTNODESETS_H_MDEBUG
-            std::cout << "SI[" << si << "]\n";
-#endif
-            int best_nid = -1;
-            int best_nid_score[] = {0, 0, 0, 0, 0};
-            int current_nid_score[] = {0, 0, 0, 0, 0};
-
-#ifdef MAMACONSTRFIRSTNODESETS_H_MDEBUG
-            for (int nid = 0; nid < nof_sn; nid++) {
-                std::cout << nid << "(" << node_flags[nid] << ") ";
-                get_scores(nid, current_nid_score, node_flags, ssg);
-                std::cout << "[";
-                for (int i = 0; i < 5; i++) {
-                    std::cout << current_nid_score[i] << " ";
-                }
-                std::cout << "]\n";
-            }
-#endif
-
-            for (int nid = 0; nid < nof_sn; nid++) {
-                if (node_flags[nid] == NS_CNEIGH) {
-                    if (best_nid == -1) {
-                        best_nid = nid;
-                        get_scores(nid, best_nid_score, node_flags, ssg);
-                    } else {
-                        get_scores(nid, current_nid_score, node_flags, ssg);
-                        if (compare_scores(current_nid_score, best_nid_score, nid, best_nid) > 0) {
-                            best_nid = nid;
-                            for (int i = 0; i < 5; i++) {
-                                best_nid_score[i] = current_nid_score[i];
-                            }
-                        }
-                    }
-                }
-            }
-
-            if (best_nid == -1) { // firs node without singletons or disconnected query
-                for (int nid = 0; nid < nof_sn; nid++) {
-                    if (node_flags[nid] == NS_UNV) {
-                        if (best_nid == -1) {
-                            best_nid = nid;
-                            get_scores(nid, best_nid_score, node_flags, ssg);
-                        } else {
-                            get_scores(nid, current_nid_score, node_flags, ssg);
-                            if (compare_scores(current_nid_score, best_nid_score, nid, best_nid) > 0) {
-                                best_nid = nid;
-                                for (int i = 0; i < 5; i++) {
-                                    best_nid_score[i] = current_nid_score[i];
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+            // best core neighbour, or the first node without singletons or of a disconnected query
+            int best_nid = queue.best();
 #ifdef MAMACONSTRFIRSTNODESETS_H_MDEBUG
             std::cout << "si[" << si << "] = " << best_nid << "\n";
 #endif
-            push_node_to_core(best_nid, si, node_flags, ssg, map_state_to_node, map_node_to_state);
-
-#ifdef MAMACONSTRFIRSTNODESETS_H_MDEBUG
-            for (int i = 0; i < nof_sn; i++) {
-                std::cout << i << "[" << node_flags[i] << "] ";
-            }
-            std::cout << "\n";
-#endif
+            push_node_to_core(best_nid, si, queue);
         }
 
         int e_count, o_e_count, i_e_count, n, nn;
@@ -192,73 +120,11 @@ class MaMaConstrFirstNodeSets : public MatchingMachine {
     }
 
   private:
-    void push_node_to_core(int nid, int si, NodeFlag *node_flags, Graph &qg, int *map_state_to_node, int *map_node_to_state) {
-        node_flags[nid] = NS_CORE;
-
-        for (int i = 0; i < qg.out_adj_sizes[nid]; i++) {
-            if (node_flags[qg.out_adj_list[nid][i]] == NS_UNV) {
-                node_flags[qg.out_adj_list[nid][i]] = NS_CNEIGH;
-            }
-        }
-        for (int i = 0; i < qg.in_adj_sizes[nid]; i++) {
-            if (node_flags[qg.in_adj_list[nid][i]] == NS_UNV) {
-                node_flags[qg.in_adj_list[nid][i]] = NS_CNEIGH;
-            }
-        }
+    void push_node_to_core(int nid, int si, NodeSetQueue &queue) {
+        queue.push(nid);
         map_state_to_node[si] = nid;
         map_node_to_state[nid] = si;
     }
-
-    void get_scores(int nid, int *scores, NodeFlag *node_flags, Graph &qg) {
-        std::set<int> all;
-
-        std::set<int> cores;
-        std::set<int> neighs;
-        std::set<int> unvs;
-
-        for (int i = 0; i < qg.out_adj_sizes[nid]; i++) {
-            if (node_flags[qg.out_adj_list[nid][i]] == NS_CORE) {
-                cores.insert(qg.out_adj_list[nid][i]);
-            } else if (node_flags[qg.out_adj_list[nid][i]] == NS_CNEIGH) {
-                neighs.insert(qg.out_adj_list[nid][i]);
-            } else {
-                unvs.insert(qg.out_adj_list[nid][i]);
-            }
-            all.insert(qg.out_adj_list[nid][i]);
-        }
-        for (int i = 0; i < qg.in_adj_sizes[nid]; i++) {
-            if (node_flags[qg.in_adj_list[nid][i]] == NS_CORE) {
-                cores.insert(qg.in_adj_list[nid][i]);
-            } else if (node_flags[qg.in_adj_list[nid][i]] == NS_CNEIGH) {
-                neighs.insert(qg.in_adj_list[nid][i]);
-            } else {
-                unvs.insert(qg.in_adj_list[nid][i]);
-            }
-            all.insert(qg.in_adj_list[nid][i]);
-        }
-
-        scores[0] = cores.size();
-        scores[1] = neighs.size();
-        scores[2] = unvs.size();
-        scores[3] = all.size();
-        scores[4] = domains_size[nid];
-    }
-
-    int compare_scores(int *s1, int *s2, int n1, int n2) {
-        for (int i = 0; i < 4; i++) {
-            if (s1[i] != s2[i]) {
-                return s1[i] - s2[i];
-            }
-        }
-
-        if (s1[4] != s2[4]) {
-#ifdef MAMACONSTRFIRSTNODESETS_H_MDEBUG
-            std::cout << "dcomp " << n1 << "-" << n2 << " " << s1[4] << "-" << s2[4] << " \n";
-#endif
-            return s2[4] - s1[4];
-        }
-        return n2 - n1;
-    }
 };
 
 } // namespace rilib
@@ -36,15 +36,16 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 // #define MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG 1
 
 #include "Graph.h"
+#include "MaMaNodeSetQueue.h"
 #include "MatchingMachine.h"
 #include "sbitset.h"
+#include <algorithm>
 #include <set>
+#include <vector>
 
 namespace rilib {
 
 class MaMaConstrFirstNodeSetsLeafs : public MatchingMachine {
-    enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
-
     sbitset *domains;
     int *domains_size;
 
@@ -57,28 +58,12 @@ class MaMaConstrFirstNodeSetsLeafs : public MatchingMachine {
         ssg.print();
 #endif
 
-        NodeFlag *node_flags = new NodeFlag[nof_sn]; // indexed by node_id
-        for (int i = 0; i < nof_sn; i++) {
-            node_flags[i] = NS_UNV;
-        }
-
-        int si = 0;
-        for (int i = 0; i < nof_sn; i++) {
-            if (domains_size[i] == 1) {
-#ifdef MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG
-                std::cout << "ssi[" << si << "] = " << i << "\n";
-#endif
-                push_node_to_core(i, si, node_flags, ssg, map_state_to_node, map_node_to_state);
-                si++;
-            }
-        }
-
         bool *good_leafs = new bool[nof_sn];
         bool *bad_leafs = new bool[nof_sn];
         for (int i = 0; i < nof_sn; i++) {
             good_leafs[i] = false;
             bad_leafs[i] = false;
-            if (node_flags[i] != NS_CORE) {
+            if (domains_size[i] != 1) { // singletons go to the core
                 std::set<int> neighs;
                 for (int j = 0; j < ssg.out_adj_sizes[i]; j++) {
                     neighs.insert(ssg.out_adj_list[i][j]);
@@ -89,7 +74,8 @@ class MaMaConstrFirstNodeSetsLeafs : public MatchingMachine {
 #ifdef MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG
                 std::cout << i << " nof neighs " << neighs.size() << "\n";
 #endif
-                if (neighs.size() == 1) {
+                // of two leafs joined to each other only the first one is kept, the other one is its parent
+                if (neighs.size() == 1 && !(*neighs.begin() < i && good_leafs[*neighs.begin()])) {
                     good_leafs[i] = true;
                 }
             }
@@ -104,9 +90,15 @@ class MaMaConstrFirstNodeSetsLeafs : public MatchingMachine {
         }
         std::cout << "\n";
 #endif
+        // leafs with disjoint domains never remove each other, so each leaf is compared only with its group
+        std::vector<std::vector<int> > groups;
+        int *leaf_group = get_leaf_groups(good_leafs, groups);
+
         for (int i = 0; i < nof_sn; i++) {
             if (good_leafs[i] && (!bad_leafs[i])) {
-                for (int j = 0; j < nof_sn; j++) {
+                std::vector<int> &group = groups[leaf_group[i]];
+                for (size_t g = 0; g < group.size(); g++) {
+                    int j = group[g];
                     if (i != j) {
                         if (good_leafs[j] && (!bad_leafs[j])) {
                             if (!domains[i].emptyAND(domains[j])) {
@@ -131,6 +123,8 @@ class MaMaConstrFirstNodeSetsLeafs : public MatchingMachine {
             }
         }
 
+        delete[] leaf_group;
+
         int leafi = nof_sn - 1;
         nof_leafs = 0;
 
@@ -151,80 +145,27 @@ class MaMaConstrFirstNodeSetsLeafs : public MatchingMachine {
         std::cout << "nof leafs = " << nof_leafs << " \n";
 #endif
 
-#ifdef MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG
-        for (int i = 0; i < nof_sn; i++) {
-            std::cout << i << "[" << node_flags[i] << "] ";
-        }
-        std::cout << "\n";
-#endif
-
-        for (; si < leafi + 1; si++) {
-
-#ifdef MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG
-            std::cout << "SI[" << si << "]\n";
-#endif
-            int best_nid = -1;
-            int best_nid_score[] = {0, 0, 0, 0, 0};
-            int current_nid_score[] = {0, 0, 0, 0, 0};
+        // leafs are never candidates, they stay as core neighbours at the end of the ordering
+        NodeSetQueue queue(ssg, domains_size, good_leafs);
 
+        int si = 0;
+        for (int i = 0; i < nof_sn; i++) {
+            if (domains_size[i] == 1) {
 #ifdef MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG
-            for (int nid = 0; nid < nof_sn; nid++) {
-                std::cout << nid << "(" << node_flags[nid] << ") ";
-                get_scores(nid, current_nid_score, node_flags, ssg);
-                std::cout << "[";
-                for (int i = 0; i < 5; i++) {
-                    std::cout << current_nid_score[i] << " ";
-                }
-                std::cout << "]\n";
-            }
+                std::cout << "ssi[" << si << "] = " << i << "\n";
 #endif
-
-            for (int nid = 0; nid < nof_sn; nid++) {
-                if ((node_flags[nid] == NS_CNEIGH) && (!good_leafs[nid])) {
-                    if (best_nid == -1) {
-                        best_nid = nid;
-                        get_scores(nid, best_nid_score, node_flags, ssg);
-                    } else {
-                        get_scores(nid, current_nid_score, node_flags, ssg);
-                        if (compare_scores(current_nid_score, best_nid_score, nid, best_nid) > 0) {
-                            best_nid = nid;
-                            for (int i = 0; i < 5; i++) {
-                                best_nid_score[i] = current_nid_score[i];
-                            }
-                        }
-                    }
-                }
+                push_node_to_core(i, si, queue);
+                si++;
             }
+        }
 
-            if (best_nid == -1) { // firs node without singletons or disconnected query
-                for (int nid = 0; nid < nof_sn; nid++) {
-                    if ((node_flags[nid] == NS_UNV) && (!good_leafs[nid])) {
-                        if (best_nid == -1) {
-                            best_nid = nid;
-                            get_scores(nid, best_nid_score, node_flags, ssg);
-                        } else {
-                            get_scores(nid, current_nid_score, node_flags, ssg);
-                            if (compare_scores(current_nid_score, best_nid_score, nid, best_nid) > 0) {
-                                best_nid = nid;
-                                for (int i = 0; i < 5; i++) {
-                                    best_nid_score[i] = current_nid_score[i];
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+        for (; si < leafi + 1; si++) {
+            // best core neighbour, or the first node without singletons or of a disconnected query
+            int best_nid = queue.best();
 #ifdef MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG
             std::cout << "si[" << si << "] = " << best_nid << "\n";
 #endif
-            push_node_to_core(best_nid, si, node_flags, ssg, map_state_to_node, map_node_to_state);
-
-#ifdef MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG
-            for (int i = 0; i < nof_sn; i++) {
-                std::cout << i << "[" << node_flags[i] << "] ";
-            }
-            std::cout << "\n";
-#endif
+            push_node_to_core(best_nid, si, queue);
         }
 
 #ifdef MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG
@@ -290,75 +231,69 @@ class MaMaConstrFirstNodeSetsLeafs : public MatchingMachine {
                 }
             }
         }
+
+        delete[] good_leafs;
+        delete[] bad_leafs;
     }
 
   private:
-    void push_node_to_core(int nid, int si, NodeFlag *node_flags, Graph &qg, int *map_state_to_node, int *map_node_to_state) {
-        node_flags[nid] = NS_CORE;
-
-        for (int i = 0; i < qg.out_adj_sizes[nid]; i++) {
-            if (node_flags[qg.out_adj_list[nid][i]] == NS_UNV) {
-                node_flags[qg.out_adj_list[nid][i]] = NS_CNEIGH;
-            }
-        }
-        for (int i = 0; i < qg.in_adj_sizes[nid]; i++) {
-            if (node_flags[qg.in_adj_list[nid][i]] == NS_UNV) {
-                node_flags[qg.in_adj_list[nid][i]] = NS_CNEIGH;
-            }
+    // groups of leafs joined by shared domain elements, the leafs of each group are sorted by id
+    int *get_leaf_groups(bool *good_leafs, std::vector<std::vector<int> > &groups) {
+        int *leaf_group = new int[nof_sn];
+        for (int i = 0; i < nof_sn; i++) {
+            leaf_group[i] = i;
         }
-        map_state_to_node[si] = nid;
-        map_node_to_state[nid] = si;
-    }
-
-    void get_scores(int nid, int *scores, NodeFlag *node_flags, Graph &qg) {
-        std::set<int> all;
 
-        std::set<int> cores;
-        std::set<int> neighs;
-        std::set<int> unvs;
-
-        for (int i = 0; i < qg.out_adj_sizes[nid]; i++) {
-            if (node_flags[qg.out_adj_list[nid][i]] == NS_CORE) {
-                cores.insert(qg.out_adj_list[nid][i]);
-            } else if (node_flags[qg.out_adj_list[nid][i]] == NS_CNEIGH) {
-                neighs.insert(qg.out_adj_list[nid][i]);
-            } else {
-                unvs.insert(qg.out_adj_list[nid][i]);
+        std::vector<int> owner;
+        for (int i = 0; i < nof_sn; i++) {
+            if (good_leafs[i]) {
+                for (sbitset::iterator IT = domains[i].first_ones(); IT != domains[i].end(); IT.next_ones()) {
+                    if (IT.first >= owner.size()) {
+                        owner.resize(IT.first + 1, -1);
+                    }
+                    if (owner[IT.first] == -1) {
+                        owner[IT.first] = i;
+                    } else {
+                        int a = find_group(leaf_group, owner[IT.first]);
+                        int b = find_group(leaf_group, i);
+                        if (a != b) {
+                            leaf_group[std::max(a, b)] = std::min(a, b);
+                        }
+                    }
+                }
             }
-            all.insert(qg.out_adj_list[nid][i]);
         }
-        for (int i = 0; i < qg.in_adj_sizes[nid]; i++) {
-            if (node_flags[qg.in_adj_list[nid][i]] == NS_CORE) {
-                cores.insert(qg.in_adj_list[nid][i]);
-            } else if (node_flags[qg.in_adj_list[nid][i]] == NS_CNEIGH) {
-                neighs.insert(qg.in_adj_list[nid][i]);
-            } else {
-                unvs.insert(qg.in_adj_list[nid][i]);
+
+        // the roots become the indexes of the groups
+        int *group_id = new int[nof_sn];
+        for (int i = 0; i < nof_sn; i++) {
+            group_id[i] = -1;
+            if (good_leafs[i]) {
+                int r = find_group(leaf_group, i);
+                if (group_id[r] == -1) {
+                    group_id[r] = groups.size();
+                    groups.push_back(std::vector<int>());
+                }
+                groups[group_id[r]].push_back(i);
+                group_id[i] = group_id[r];
             }
-            all.insert(qg.in_adj_list[nid][i]);
         }
-
-        scores[0] = cores.size();
-        scores[1] = neighs.size();
-        scores[2] = unvs.size();
-        scores[3] = all.size();
-        scores[4] = domains_size[nid];
+        delete[] leaf_group;
+        return group_id;
     }
 
-    int compare_scores(int *s1, int *s2, int n1, int n2) {
-        for (int i = 0; i < 4; i++) {
-            if (s1[i] != s2[i]) {
-                return s1[i] - s2[i];
-            }
+    int find_group(int *parent, int n) {
+        while (parent[n] != n) {
+            parent[n] = parent[parent[n]];
+            n = parent[n];
         }
+        return n;
+    }
 
-        if (s1[4] != s2[4]) {
-#ifdef MAMACONSTRFIRSTNODESETSLEAFS_H_MDEBUG
-            std::cout << "dcomp " << n1 << "-" << n2 << " " << s1[4] << "-" << s2[4] << " \n";
-#endif
-            return s2[4] - s1[4];
-        }
-        return n2 - n1;
+    void push_node_to_core(int nid, int si, NodeSetQueue &queue) {
+        queue.push(nid);
+        map_state_to_node[si] = nid;
+        map_node_to_state[nid] = si;
     }
 };
 
@@ -0,0 +1,184 @@
+/*
+ * MaMaConstrFirstNodeSetsTrees.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef MAMACONSTRFIRSTNODESETSTREES_H_
+#define MAMACONSTRFIRSTNODESETSTREES_H_
+
+#include "Graph.h"
+#include "MaMaNodeSetQueue.h"
+#include "MatchingMachine.h"
+#include "sbitset.h"
+#include <set>
+#include <vector>
+
+namespace rilib {
+
+/*
+ * Node sets ordering of the core of the query, followed by the trees hanging
+ * from it, parents before children. The trees are the nodes removed by peeling
+ * the nodes with a single neighbour and no self loop, they are counted apart
+ * by the tree solver (see Solver::SolveTrees) for each match of the core.
+ * nof_leafs is the number of tree nodes.
+ */
+class MaMaConstrFirstNodeSetsTrees : public MatchingMachine {
+    sbitset *domains;
+    int *domains_size;
+
+  public:
+    MaMaConstrFirstNodeSetsTrees(Graph &query, sbitset *_domains, int *_domains_size) : MatchingMachine(query), domains(_domains), domains_size(_domains_size) {}
+
+    virtual void build(Graph &ssg) {
+        std::vector<bool> loop_free = get_loop_free_nodes(ssg);
+
+        std::vector<std::set<int> > neighs(nof_sn);
+        for (int i = 0; i < nof_sn; i++) {
+            for (int j = 0; j < ssg.out_adj_sizes[i]; j++) {
+                neighs[i].insert(ssg.out_adj_list[i][j]);
+            }
+            for (int j = 0; j < ssg.in_adj_sizes[i]; j++) {
+                neighs[i].insert(ssg.in_adj_list[i][j]);
+            }
+        }
+
+        // peeling, the last node of a tree component stays in the core
+        bool *tree_nodes = new bool[nof_sn];
+        std::vector<int> degree(nof_sn), peeled;
+        std::vector<int> queue;
+        for (int i = 0; i < nof_sn; i++) {
+            tree_nodes[i] = false;
+            degree[i] = (int)neighs[i].size();
+            if (degree[i] == 1 && loop_free[i])
+                queue.push_back(i);
+        }
+        for (size_t q = 0; q < queue.size(); q++) {
+            int n = queue[q];
+            if (degree[n] != 1)
+                continue;
+            tree_nodes[n] = true;
+            peeled.push_back(n);
+            degree[n] = 0;
+            for (std::set<int>::iterator it = neighs[n].begin(); it != neighs[n].end(); it++) {
+                if (!tree_nodes[*it]) {
+                    degree[*it]--;
+                    if (degree[*it] == 1 && loop_free[*it])
+                        queue.push_back(*it);
+                }
+            }
+        }
+        nof_leafs = (int)peeled.size();
+
+        NodeSetQueue nsqueue(ssg, domains_size, tree_nodes);
+
+        int si = 0;
+        for (int i = 0; i < nof_sn; i++) {
+            if (domains_size[i] == 1 && !tree_nodes[i]) {
+                push_node_to_core(i, si, nsqueue);
+                si++;
+            }
+        }
+        for (; si < nof_sn - nof_leafs; si++) {
+            push_node_to_core(nsqueue.best(), si, nsqueue);
+        }
+        // a node is peeled before its parent
+        for (int p = nof_leafs - 1; p >= 0; p--, si++) {
+            map_state_to_node[si] = peeled[p];
+            map_node_to_state[peeled[p]] = si;
+        }
+
+        int e_count, o_e_count, i_e_count, n;
+        for (int si = 0; si < nof_sn; si++) {
+
+            n = map_state_to_node[si];
+            e_count = 0;
+            o_e_count = 0;
+            for (int i = 0; i < ssg.out_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.out_adj_list[n][i]] < si) {
+                    e_count++;
+                    o_e_count++;
+                }
+            }
+            i_e_count = 0;
+            for (int i = 0; i < ssg.in_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.in_adj_list[n][i]] < si) {
+                    e_count++;
+                    i_e_count++;
+                }
+            }
+
+            edges_sizes[si] = e_count;
+            o_edges_sizes[si] = o_e_count;
+            i_edges_sizes[si] = i_e_count;
+
+            edges[si] = new MaMaEdge[e_count];
+
+            e_count = 0;
+            for (int i = 0; i < ssg.out_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.out_adj_list[n][i]] < si) {
+                    edges[si][e_count].source = si;
+                    edges[si][e_count].target = map_node_to_state[ssg.out_adj_list[n][i]];
+                    e_count++;
+                }
+            }
+            for (int i = 0; i < ssg.in_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.in_adj_list[n][i]] < si) {
+                    edges[si][e_count].target = si;
+                    edges[si][e_count].source = map_node_to_state[ssg.in_adj_list[n][i]];
+                    e_count++;
+                }
+            }
+        }
+
+        delete[] tree_nodes;
+    }
+
+  private:
+    std::vector<bool> get_loop_free_nodes(Graph &ssg) {
+        std::vector<bool> loop_free(nof_sn, true);
+        for (int i = 0; i < nof_sn; i++) {
+            for (int j = 0; j < ssg.out_adj_sizes[i]; j++) {
+                if (ssg.out_adj_list[i][j] == i)
+                    loop_free[i] = false;
+            }
+        }
+        return loop_free;
+    }
+
+    void push_node_to_core(int nid, int si, NodeSetQueue &queue) {
+        queue.push(nid);
+        map_state_to_node[si] = nid;
+        map_node_to_state[nid] = si;
+    }
+};
+
+} // namespace rilib
+
+#endif /* MAMACONSTRFIRSTNODESETSTREES_H_ */
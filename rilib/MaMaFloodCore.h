@@ -32,6 +32,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <string.h>
 
 #include <algorithm>
+#include <set>
 #include <vector>
 
 #include "Domains.h"
@@ -56,30 +57,37 @@ class MaMaFloodCore : public MatchingMachine {
 
     enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
 
+    // flood from inode with buffers of size nfs; only the nodes reached by the previous flood are reset
     void flood_centrality(Graph &query, int nfs, int inode, double *centrality, double *ccentrality, int *depth, double **o_query_e_weights, double **i_query_e_weights, NodeFlag *node_flags, int max_depth) {
 
-        int *queue = new int[nfs];
+        int *queue = flood_queue;
         int cn, n;
         int q, ql = 0, qr = 0, nqr = 0;
         node_flags[inode] = NS_CORE;
 
-        for (int cn = 0; cn < nfs; cn++) {
+        for (size_t t = 0; t < flooded.size(); t++) {
+            cn = flooded[t];
             centrality[cn] = 0.0;
             ccentrality[cn] = 0.0;
             depth[cn] = nfs;
         }
+        flooded.clear();
 
         cn = inode;
         depth[cn] = 0;
+        flooded.push_back(cn);
         for (int i = 0; i < query.out_adj_sizes[cn]; i++) {
             n = query.out_adj_list[cn][i];
             if (node_flags[n] != NS_CORE) {
                 if (depth[n] == nfs) {
                     depth[n] = 1;
+                    flooded.push_back(n);
                     queue[qr] = n;
                     qr++;
                 }
             } else {
+                if (depth[n] == nfs)
+                    flooded.push_back(n);
                 depth[n] = 0;
                 centrality[cn] += 1.0;
             }
@@ -89,32 +97,51 @@ class MaMaFloodCore : public MatchingMachine {
             if (node_flags[n] != NS_CORE) {
                 if (depth[n] == nfs) {
                     depth[n] = 1;
+                    flooded.push_back(n);
                     queue[qr] = n;
                     qr++;
                 }
             } else {
+                if (depth[n] == nfs)
+                    flooded.push_back(n);
                 depth[n] = 0;
                 centrality[cn] += 1.0;
             }
         }
 
-        for (cn = 0; cn < nfs; cn++) {
-            if (node_flags[cn] == NS_CORE) {
+        // only the core nodes adjacent to depth 1 nodes contribute, they are visited by increasing id as a scan of all nodes
+        flood_cores.clear();
+        flood_cores.push_back(inode);
+        for (q = 0; q < qr; q++) {
+            cn = queue[q];
+            for (int i = 0; i < query.out_adj_sizes[cn]; i++) {
+                if (node_flags[query.out_adj_list[cn][i]] == NS_CORE)
+                    flood_cores.push_back(query.out_adj_list[cn][i]);
+            }
+            for (int i = 0; i < query.in_adj_sizes[cn]; i++) {
+                if (node_flags[query.in_adj_list[cn][i]] == NS_CORE)
+                    flood_cores.push_back(query.in_adj_list[cn][i]);
+            }
+        }
+        std::sort(flood_cores.begin(), flood_cores.end());
+        flood_cores.erase(std::unique(flood_cores.begin(), flood_cores.end()), flood_cores.end());
 
-                for (int i = 0; i < query.out_adj_sizes[cn]; i++) {
-                    n = query.out_adj_list[cn][i];
-                    if (depth[n] == 1) {
-                        centrality[n] += o_query_e_weights[cn][i];
-                        ccentrality[n] += centrality[inode] * o_query_e_weights[cn][i];
-                    }
+        for (size_t c = 0; c < flood_cores.size(); c++) {
+            cn = flood_cores[c];
+
+            for (int i = 0; i < query.out_adj_sizes[cn]; i++) {
+                n = query.out_adj_list[cn][i];
+                if (depth[n] == 1) {
+                    centrality[n] += o_query_e_weights[cn][i];
+                    ccentrality[n] += centrality[inode] * o_query_e_weights[cn][i];
                 }
+            }
 
-                for (int i = 0; i < query.in_adj_sizes[cn]; i++) {
-                    n = query.in_adj_list[cn][i];
-                    if (depth[n] == 1) {
-                        centrality[n] += i_query_e_weights[cn][i];
-                        ccentrality[n] += centrality[inode] * i_query_e_weights[cn][i];
-                    }
+            for (int i = 0; i < query.in_adj_sizes[cn]; i++) {
+                n = query.in_adj_list[cn][i];
+                if (depth[n] == 1) {
+                    centrality[n] += i_query_e_weights[cn][i];
+                    ccentrality[n] += centrality[inode] * i_query_e_weights[cn][i];
                 }
             }
         }
@@ -130,6 +157,8 @@ class MaMaFloodCore : public MatchingMachine {
                     if (depth[n] == cdepth) {
                         centrality[n] += centrality[cn] * o_query_e_weights[cn][i];
                     } else if (depth[n] > cdepth) {
+                        if (depth[n] == nfs)
+                            flooded.push_back(n);
                         centrality[n] += centrality[cn] * o_query_e_weights[cn][i];
                         depth[n] = cdepth + 1;
                         if (depth[n] == nfs) {
@@ -149,6 +178,8 @@ class MaMaFloodCore : public MatchingMachine {
                     if (depth[n] == cdepth) {
                         centrality[n] += centrality[cn] * i_query_e_weights[cn][i];
                     } else if (depth[n] > cdepth) {
+                        if (depth[n] == nfs)
+                            flooded.push_back(n);
                         centrality[n] += centrality[cn] * i_query_e_weights[cn][i];
                         depth[n] = cdepth + 1;
                         if (depth[n] == nfs) {
@@ -171,12 +202,15 @@ class MaMaFloodCore : public MatchingMachine {
         node_flags[inode] = NS_CNEIGH;
     }
 
+    // sums over the nodes reached by the last flood, by increasing id as a scan of all nodes
     void update_score(int nfs, int inode, Graph &query, double **scores, double *centrality, double *ccentrality, int *depth) {
         for (int i = 0; i < 5; i++) {
             scores[inode][i] = 0.0;
         }
 
-        for (int i = 0; i < nfs; i++) {
+        std::sort(flooded.begin(), flooded.end());
+        for (size_t t = 0; t < flooded.size(); t++) {
+            int i = flooded[t];
             if (i != inode) {
                 if (depth[i] == 1) {
                     scores[inode][1] += ccentrality[i];
@@ -201,15 +235,80 @@ class MaMaFloodCore : public MatchingMachine {
         return ret;
     }
 
+  private:
+    int *flood_queue;
+    std::vector<int> flooded;
+    std::vector<int> flood_cores;
+
+    // decreasing scores, then increasing node id as the scan of wcompare
+    struct ScoreOrder {
+        double **scores;
+        ScoreOrder(double **_scores) : scores(_scores) {}
+        bool operator()(int n1, int n2) const {
+            for (int i = 0; i < 5; i++) {
+                if (scores[n1][i] != scores[n2][i])
+                    return scores[n1][i] > scores[n2][i];
+            }
+            return n1 < n2;
+        }
+    };
+
+    // pushes nid to the core and returns the nodes within distance 2, whose scores depend on its flag
+    void push_node_to_core(int nid, Graph &query, NodeFlag *node_flags, int *stamps, int stamp, std::vector<int> &dirty) {
+        int n;
+        node_flags[nid] = NS_CORE;
+        for (int i = 0; i < query.out_adj_sizes[nid]; i++) {
+            n = query.out_adj_list[nid][i];
+            if (node_flags[n] == NS_UNV) {
+                node_flags[n] = NS_CNEIGH;
+            }
+        }
+        for (int i = 0; i < query.in_adj_sizes[nid]; i++) {
+            n = query.in_adj_list[nid][i];
+            if (node_flags[n] == NS_UNV) {
+                node_flags[n] = NS_CNEIGH;
+            }
+        }
+
+        dirty.clear();
+        stamps[nid] = stamp;
+        dirty.push_back(nid);
+        // nid, its neighbours and the neighbours of its neighbours
+        size_t first_level = 1;
+        for (size_t d = 0; d < first_level; d++) {
+            int cn = dirty[d];
+            for (int i = 0; i < query.out_adj_sizes[cn]; i++) {
+                n = query.out_adj_list[cn][i];
+                if (stamps[n] != stamp) {
+                    stamps[n] = stamp;
+                    dirty.push_back(n);
+                }
+            }
+            for (int i = 0; i < query.in_adj_sizes[cn]; i++) {
+                n = query.in_adj_list[cn][i];
+                if (stamps[n] != stamp) {
+                    stamps[n] = stamp;
+                    dirty.push_back(n);
+                }
+            }
+            if (d == 0)
+                first_level = dirty.size();
+        }
+    }
+
+  public:
     virtual void build(Graph &query) {
         const int nfs = query.nof_nodes;
 
+        // without target edges the weights would be NaN, which the sorted selection of the nodes does not order
+        const double nof_target_edges = edge_domains.nof_target_edges > 0 ? (double)edge_domains.nof_target_edges : 1.0;
+
         double **o_query_e_weights = new double *[nfs];
         for (int i = 0; i < query.nof_nodes; i++) {
             o_query_e_weights[i] = new double[query.out_adj_sizes[i]];
             for (int j = 0; j < query.out_adj_sizes[i]; j++) {
 
-                o_query_e_weights[i][j] = 1.0 - (((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[i][j]].size()) / ((double)edge_domains.nof_target_edges));
+                o_query_e_weights[i][j] = 1.0 - (((double)edge_domains.domains[edge_domains.pattern_out_adj_eids[i][j]].size()) / nof_target_edges);
             }
         }
 
@@ -218,7 +317,7 @@ class MaMaFloodCore : public MatchingMachine {
             i_query_e_weights[i] = new double[query.in_adj_sizes[i]];
             for (int j = 0; j < query.in_adj_sizes[i]; j++) {
 
-                i_query_e_weights[i][j] = 1.0 - (((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[i][j]].size()) / ((double)edge_domains.nof_target_edges));
+                i_query_e_weights[i][j] = 1.0 - (((double)edge_domains.domains[edge_domains.pattern_in_adj_eids[i][j]].size()) / nof_target_edges);
             }
         }
 
@@ -240,7 +339,21 @@ class MaMaFloodCore : public MatchingMachine {
         double *centrality = new double[nfs];
         double *ccentrality = new double[nfs];
         int *depth = new int[nfs];
+        for (int i = 0; i < nfs; i++) {
+            centrality[i] = 0.0;
+            ccentrality[i] = 0.0;
+            depth[i] = nfs;
+        }
+        flood_queue = new int[nfs];
+        flooded.clear();
+
+        int *stamps = new int[nfs];
+        for (int i = 0; i < nfs; i++) {
+            stamps[i] = 0;
+        }
+        std::vector<int> dirty;
 
+        // the scores of core nodes are never used
         int si = 0, n, nn;
         for (int i = 0; i < nfs; i++) {
             if (node_domains_size[i] == 1) {
@@ -248,24 +361,7 @@ class MaMaFloodCore : public MatchingMachine {
                 std::cout << "SINGLETON " << i << " " << si << "\n";
 #endif
                 ordering[si] = i;
-                node_flags[i] = NS_CORE;
-                flood_centrality(query, nfs, i, centrality, ccentrality, depth, o_query_e_weights, i_query_e_weights, node_flags, 3);
-                update_score(nfs, i, query, scores, centrality, ccentrality, depth);
-
-                node_flags[i] = NS_CORE;
-
-                for (int j = 0; j < query.out_adj_sizes[i]; j++) {
-                    n = query.out_adj_list[i][j];
-                    if (node_flags[n] == NS_UNV) {
-                        node_flags[n] = NS_CNEIGH;
-                    }
-                }
-                for (int j = 0; j < query.in_adj_sizes[i]; j++) {
-                    n = query.in_adj_list[i][j];
-                    if (node_flags[n] == NS_UNV) {
-                        node_flags[n] = NS_CNEIGH;
-                    }
-                }
+                push_node_to_core(i, query, node_flags, stamps, si + 1, dirty);
                 si++;
             }
         }
@@ -275,73 +371,39 @@ class MaMaFloodCore : public MatchingMachine {
             std::cout << "si " << si << "\n";
 #endif
 
+            // a node keeps the scores of this first flood until it becomes a core neighbour
             NodeFlag oflag;
+            ScoreOrder order(scores);
+            std::set<int, ScoreOrder> queue(order);
             for (int i = 0; i < nfs; i++) {
-                oflag = node_flags[i];
-                flood_centrality(query, nfs, i, centrality, ccentrality, depth, o_query_e_weights, i_query_e_weights, node_flags, 3);
-                node_flags[i] = oflag;
-                update_score(nfs, i, query, scores, centrality, ccentrality, depth);
-            }
-
-#ifdef MDEBUG
-            for (int cn = 0; cn < nfs; cn++) {
-                std::cout << "FIRST " << cn << " ";
-                for (int k = 0; k < 5; k++) {
-                    std::cout << scores[cn][k] << " ";
+                if (node_flags[i] != NS_CORE) {
+                    oflag = node_flags[i];
+                    flood_centrality(query, nfs, i, centrality, ccentrality, depth, o_query_e_weights, i_query_e_weights, node_flags, 3);
+                    node_flags[i] = oflag;
+                    update_score(nfs, i, query, scores, centrality, ccentrality, depth);
+                    queue.insert(i);
                 }
-                std::cout << "\n";
             }
-#endif
-
-            int max_score_node = -1;
-            for (int cn = 0; cn < nfs; cn++) {
-                if (node_flags[cn] != NS_CORE) {
-                    if (max_score_node == -1) {
-                        max_score_node = cn;
-                    } else {
-                        if (wcompare(scores, cn, max_score_node) > 0.0) {
-                            max_score_node = cn;
-                        }
-                    }
-                }
-            }
-
-#ifdef MDEBUG
-            std::cout << "CHOOSEN " << max_score_node << "\n";
-#endif
-            ordering[si] = max_score_node;
-            node_flags[max_score_node] = NS_CORE;
-            for (int i = 0; i < query.out_adj_sizes[max_score_node]; i++) {
-                n = query.out_adj_list[max_score_node][i];
-                if (node_flags[n] == NS_UNV) {
-                    node_flags[n] = NS_CNEIGH;
-                }
-            }
-            for (int i = 0; i < query.in_adj_sizes[max_score_node]; i++) {
-                n = query.in_adj_list[max_score_node][i];
-                if (node_flags[n] == NS_UNV) {
-                    node_flags[n] = NS_CNEIGH;
-                }
-            }
-            si++;
 
             while (si < nfs) {
+                int max_score_node = *queue.begin();
+                queue.erase(queue.begin());
+
 #ifdef MDEBUG
-                std::cout << "\n========================================\n";
-                std::cout << "si " << si << "\n";
-                std::cout << "CORES: ";
-                for (int cn = 0; cn < nfs; cn++) {
-                    if (node_flags[cn] == NS_CORE) {
-                        std::cout << cn << " ";
-                    }
-                }
-                std::cout << "\n";
+                std::cout << "CHOOSEN " << max_score_node << "\n";
 #endif
+                ordering[si] = max_score_node;
+                push_node_to_core(max_score_node, query, node_flags, stamps, si + 1, dirty);
+                si++;
 
-                for (int cn = 0; cn < nfs; cn++) {
+                // the scores of a core neighbour depend on the core nodes within distance 2
+                for (size_t d = 0; d < dirty.size(); d++) {
+                    int cn = dirty[d];
                     if (node_flags[cn] == NS_CNEIGH) {
+                        queue.erase(cn);
                         flood_centrality(query, nfs, cn, centrality, ccentrality, depth, o_query_e_weights, i_query_e_weights, node_flags, 3);
                         update_score(nfs, cn, query, scores, centrality, ccentrality, depth);
+                        queue.insert(cn);
 
 #ifdef MDEBUG
                         std::cout << "CS_NEIGH " << cn << " ";
@@ -352,41 +414,10 @@ class MaMaFloodCore : public MatchingMachine {
 #endif
                     }
                 }
-
-                max_score_node = -1;
-                for (int cn = 0; cn < nfs; cn++) {
-                    if (node_flags[cn] != NS_CORE) {
-                        if (max_score_node == -1) {
-                            max_score_node = cn;
-                        } else if (wcompare(scores, cn, max_score_node) > 0.0) {
-                            max_score_node = cn;
-                        }
-                    }
-                }
-
-#ifdef MDEBUG
-                std::cout << "CHOOSEN " << max_score_node << "\n";
-#endif
-
-                ordering[si] = max_score_node;
-                node_flags[max_score_node] = NS_CORE;
-
-                for (int i = 0; i < query.out_adj_sizes[max_score_node]; i++) {
-                    n = query.out_adj_list[max_score_node][i];
-                    if (node_flags[n] == NS_UNV) {
-                        node_flags[n] = NS_CNEIGH;
-                    }
-                }
-                for (int i = 0; i < query.in_adj_sizes[max_score_node]; i++) {
-                    n = query.in_adj_list[max_score_node][i];
-                    if (node_flags[n] == NS_UNV) {
-                        node_flags[n] = NS_CNEIGH;
-                    }
-                }
-
-                si++;
             }
         }
+        delete[] stamps;
+        delete[] flood_queue;
 
         for (int i = 0; i < nfs; i++) {
             map_node_to_state[ordering[i]] = i;
@@ -508,6 +539,20 @@ class MaMaFloodCore : public MatchingMachine {
                 }
             }
         }
+
+        for (int i = 0; i < nfs; i++) {
+            delete[] o_query_e_weights[i];
+            delete[] i_query_e_weights[i];
+            delete[] scores[i];
+        }
+        delete[] o_query_e_weights;
+        delete[] i_query_e_weights;
+        delete[] scores;
+        delete[] ordering;
+        delete[] node_flags;
+        delete[] centrality;
+        delete[] ccentrality;
+        delete[] depth;
     }
 };
 
@@ -0,0 +1,215 @@
+/*
+ * MaMaNodeSetQueue.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef MAMANODESETQUEUE_H_
+#define MAMANODESETQUEUE_H_
+
+#include "Graph.h"
+
+#include <set>
+#include <vector>
+
+namespace rilib {
+
+/*
+ * Flags and scores of the query nodes for the orderings by node sets
+ * (MaMaConstrFirstNodeSets, MaMaConstrFirstNodeSetsLeafs, MaMaConstrFirstNSCC).
+ * The scores of a node are its distinct core, core neighbour and unvisited
+ * neighbours, all its distinct neighbours and its domain size. They only depend
+ * on the flags of the neighbours, so a push recomputes them just around the
+ * nodes whose flag changed, and the candidates stay sorted in two sets.
+ */
+class NodeSetQueue {
+  public:
+    enum NodeFlag { NS_CORE, NS_CNEIGH, NS_UNV };
+
+    NodeFlag *node_flags; // indexed by node_id
+
+  private:
+    // decreasing scores, increasing domain size, then increasing node id
+    struct ScoreOrder {
+        int *scores;
+        ScoreOrder(int *_scores) : scores(_scores) {}
+        bool operator()(int n1, int n2) const {
+            int *s1 = scores + n1 * 5;
+            int *s2 = scores + n2 * 5;
+            for (int i = 0; i < 4; i++) {
+                if (s1[i] != s2[i])
+                    return s1[i] > s2[i];
+            }
+            if (s1[4] != s2[4])
+                return s1[4] < s2[4];
+            return n1 < n2;
+        }
+    };
+
+    Graph &qg;
+    int *domains_size;
+    bool *excluded; // nodes which are never candidates, may be NULL
+
+    int *scores; // indexed by node_id * 5
+
+    int *seen; // stamps of get_scores
+    int seen_stamp;
+    int *touched; // stamps of push
+    int touched_stamp;
+
+    std::set<int, ScoreOrder> cneighs;
+    std::set<int, ScoreOrder> unvs;
+
+  public:
+    NodeSetQueue(Graph &_qg, int *_domains_size, bool *_excluded = NULL)
+        : qg(_qg), domains_size(_domains_size), excluded(_excluded), scores(new int[_qg.nof_nodes * 5]), cneighs(ScoreOrder(scores)),
+          unvs(ScoreOrder(scores)) {
+        int nof_nodes = qg.nof_nodes;
+        node_flags = new NodeFlag[nof_nodes];
+        seen = new int[nof_nodes];
+        touched = new int[nof_nodes];
+        for (int i = 0; i < nof_nodes; i++) {
+            node_flags[i] = NS_UNV;
+            seen[i] = 0;
+            touched[i] = 0;
+        }
+        seen_stamp = 0;
+        touched_stamp = 0;
+
+        for (int i = 0; i < nof_nodes; i++) {
+            if (is_candidate(i)) {
+                get_scores(i, scores + i * 5);
+                unvs.insert(i);
+            }
+        }
+    }
+
+    ~NodeSetQueue() {
+        delete[] node_flags;
+        delete[] scores;
+        delete[] seen;
+        delete[] touched;
+    }
+
+    // best core neighbour, or best unvisited node for a new connected component, -1 if none is left
+    int best() {
+        if (!cneighs.empty())
+            return *cneighs.begin();
+        if (!unvs.empty())
+            return *unvs.begin();
+        return -1;
+    }
+
+    int *scores_of(int nid) { return scores + nid * 5; }
+
+    // moves nid to the core and its unvisited neighbours to the core neighbours
+    void push(int nid) {
+        std::vector<int> changed;
+        changed.push_back(nid);
+        for (int i = 0; i < qg.out_adj_sizes[nid]; i++) {
+            if (node_flags[qg.out_adj_list[nid][i]] == NS_UNV && qg.out_adj_list[nid][i] != nid)
+                changed.push_back(qg.out_adj_list[nid][i]);
+        }
+        for (int i = 0; i < qg.in_adj_sizes[nid]; i++) {
+            if (node_flags[qg.in_adj_list[nid][i]] == NS_UNV && qg.in_adj_list[nid][i] != nid)
+                changed.push_back(qg.in_adj_list[nid][i]);
+        }
+
+        // the nodes whose scores may change are taken out before the flags change
+        touched_stamp++;
+        std::vector<int> affected;
+        for (size_t c = 0; c < changed.size(); c++) {
+            touch(changed[c], affected);
+            int n = changed[c];
+            for (int i = 0; i < qg.out_adj_sizes[n]; i++)
+                touch(qg.out_adj_list[n][i], affected);
+            for (int i = 0; i < qg.in_adj_sizes[n]; i++)
+                touch(qg.in_adj_list[n][i], affected);
+        }
+
+        node_flags[nid] = NS_CORE;
+        for (size_t c = 1; c < changed.size(); c++)
+            node_flags[changed[c]] = NS_CNEIGH;
+
+        for (size_t a = 0; a < affected.size(); a++) {
+            int n = affected[a];
+            if (node_flags[n] != NS_CORE && is_candidate(n)) {
+                get_scores(n, scores + n * 5);
+                if (node_flags[n] == NS_CNEIGH)
+                    cneighs.insert(n);
+                else
+                    unvs.insert(n);
+            }
+        }
+    }
+
+  private:
+    bool is_candidate(int n) { return excluded == NULL || !excluded[n]; }
+
+    void touch(int n, std::vector<int> &affected) {
+        if (touched[n] == touched_stamp)
+            return;
+        touched[n] = touched_stamp;
+        affected.push_back(n);
+        if (node_flags[n] != NS_CORE && is_candidate(n)) {
+            if (node_flags[n] == NS_CNEIGH)
+                cneighs.erase(n);
+            else
+                unvs.erase(n);
+        }
+    }
+
+    void get_scores(int nid, int *s) {
+        seen_stamp++;
+        for (int i = 0; i < 5; i++)
+            s[i] = 0;
+        for (int i = 0; i < qg.out_adj_sizes[nid]; i++)
+            count_neighbour(qg.out_adj_list[nid][i], s);
+        for (int i = 0; i < qg.in_adj_sizes[nid]; i++)
+            count_neighbour(qg.in_adj_list[nid][i], s);
+        s[4] = domains_size[nid];
+    }
+
+    void count_neighbour(int n, int *s) {
+        if (seen[n] == seen_stamp)
+            return;
+        seen[n] = seen_stamp;
+        if (node_flags[n] == NS_CORE)
+            s[0]++;
+        else if (node_flags[n] == NS_CNEIGH)
+            s[1]++;
+        else
+            s[2]++;
+        s[3]++;
+    }
+};
+
+} // namespace rilib
+
+#endif /* MAMANODESETQUEUE_H_ */
@@ -0,0 +1,268 @@
+/*
+ * MaMaSampled.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef MAMASAMPLED_H_
+#define MAMASAMPLED_H_
+
+#include <random>
+#include <vector>
+
+#include "Domains.h"
+#include "Graph.h"
+#include "MatchingMachine.h"
+#include "sbitset.h"
+
+/*
+ * Ordering by sampling. Candidate orders are compared by an estimate of the
+ * size of their search tree, obtained by random probes on the real domains
+ * (Knuth's estimator): a probe walks down the tree picking one consistent
+ * candidate at random per state, and the product of the numbers of consistent
+ * candidates met so far estimates the nodes of each level.
+ */
+
+namespace rilib {
+
+// matching machine over a given order of the query nodes, the parent of a state is its first ordered neighbour
+class MaMaOrder : public MatchingMachine {
+    std::vector<int> order;
+
+  public:
+    MaMaOrder(Graph &query, const std::vector<int> &_order) : MatchingMachine(query), order(_order) {}
+
+    virtual void build(Graph &ssg) {
+        for (int si = 0; si < nof_sn; si++) {
+            map_state_to_node[si] = order[si];
+            map_node_to_state[order[si]] = si;
+        }
+
+        int e_count, o_e_count, i_e_count, n;
+        for (int si = 0; si < nof_sn; si++) {
+            n = map_state_to_node[si];
+
+            for (int i = 0; i < ssg.out_adj_sizes[n]; i++) {
+                int ps = map_node_to_state[ssg.out_adj_list[n][i]];
+                if (ps < si && (parent_state[si] == -1 || ps < parent_state[si])) {
+                    parent_state[si] = ps;
+                    parent_type[si] = PARENTTYPE_IN;
+                }
+            }
+            for (int i = 0; i < ssg.in_adj_sizes[n]; i++) {
+                int ps = map_node_to_state[ssg.in_adj_list[n][i]];
+                if (ps < si && (parent_state[si] == -1 || ps < parent_state[si])) {
+                    parent_state[si] = ps;
+                    parent_type[si] = PARENTTYPE_OUT;
+                }
+            }
+
+            e_count = 0;
+            o_e_count = 0;
+            for (int i = 0; i < ssg.out_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.out_adj_list[n][i]] < si) {
+                    e_count++;
+                    o_e_count++;
+                }
+            }
+            i_e_count = 0;
+            for (int i = 0; i < ssg.in_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.in_adj_list[n][i]] < si) {
+                    e_count++;
+                    i_e_count++;
+                }
+            }
+
+            edges_sizes[si] = e_count;
+            o_edges_sizes[si] = o_e_count;
+            i_edges_sizes[si] = i_e_count;
+
+            edges[si] = new MaMaEdge[e_count];
+
+            e_count = 0;
+            for (int i = 0; i < ssg.out_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.out_adj_list[n][i]] < si) {
+                    edges[si][e_count].source = si;
+                    edges[si][e_count].target = map_node_to_state[ssg.out_adj_list[n][i]];
+                    e_count++;
+                }
+            }
+            for (int i = 0; i < ssg.in_adj_sizes[n]; i++) {
+                if (map_node_to_state[ssg.in_adj_list[n][i]] < si) {
+                    edges[si][e_count].target = si;
+                    edges[si][e_count].source = map_node_to_state[ssg.in_adj_list[n][i]];
+                    e_count++;
+                }
+            }
+        }
+    }
+};
+
+// weights of the nodes summed over a complete binary tree, to draw a node with probability proportional to its weight
+class WeightTree {
+    std::vector<double> sums;
+    int nof_leafs;
+
+  public:
+    WeightTree(int n) {
+        nof_leafs = 1;
+        while (nof_leafs < n)
+            nof_leafs <<= 1;
+        sums.assign(2 * nof_leafs, 0);
+    }
+
+    void set(int i, double w) {
+        i += nof_leafs;
+        sums[i] = w;
+        for (i >>= 1; i > 0; i >>= 1)
+            sums[i] = sums[2 * i] + sums[2 * i + 1];
+    }
+
+    double total() { return sums[1]; }
+
+    // node where the cumulative weight passes r, never a node of weight 0
+    int draw(double r) {
+        int i = 1;
+        while (i < nof_leafs) {
+            double left = sums[2 * i];
+            if (left > 0 && (r < left || sums[2 * i + 1] <= 0)) {
+                i = 2 * i;
+            } else {
+                r -= left;
+                i = 2 * i + 1;
+            }
+        }
+        return i - nof_leafs;
+    }
+};
+
+inline double order_weight(int links, int domain_size) { return (double)(1 << (links < 20 ? links : 20)) / (domain_size > 0 ? domain_size : 1); }
+
+/*
+ * Random connected order: the first node is drawn with probability inverse to
+ * its domain size, the next ones among the neighbours of the ordered nodes with
+ * weight 2^(ordered neighbours) / domain size.
+ */
+inline void random_order(Graph &query, int *domains_size, std::mt19937 &rng, std::vector<int> &order) {
+    int n = query.nof_nodes;
+    std::vector<int> links(n, 0); // ordered neighbours, -1 once ordered
+    WeightTree frontier(n);       // unordered nodes with ordered neighbours
+    WeightTree others(n);         // unordered nodes without ordered neighbours
+    int nof_frontier = 0;
+    for (int i = 0; i < n; i++)
+        others.set(i, order_weight(0, domains_size[i]));
+    order.clear();
+    for (int si = 0; si < n; si++) {
+        WeightTree &from = nof_frontier > 0 ? frontier : others;
+        double r = std::uniform_real_distribution<double>(0, from.total())(rng);
+        int next = from.draw(r);
+        order.push_back(next);
+        if (links[next] > 0)
+            nof_frontier--;
+        from.set(next, 0);
+        links[next] = -1;
+        for (int d = 0; d < 2; d++) {
+            int *adj = d == 0 ? query.out_adj_list[next] : query.in_adj_list[next];
+            int adj_size = d == 0 ? query.out_adj_sizes[next] : query.in_adj_sizes[next];
+            for (int i = 0; i < adj_size; i++) {
+                int nn = adj[i];
+                if (links[nn] < 0)
+                    continue;
+                if (links[nn] == 0) {
+                    others.set(nn, 0);
+                    nof_frontier++;
+                }
+                links[nn]++;
+                frontier.set(nn, order_weight(links[nn], domains_size[nn]));
+            }
+        }
+    }
+};
+
+// mean estimate of the number of nodes of the search tree of mama (with fixed edge ids) over nof_probes random probes
+inline double estimate_tree_size(MatchingMachine &mama, Graph &rgraph, sbitset *domains, EdgeDomains &edomains, int nof_probes, std::mt19937 &rng) {
+    int nof_sn = mama.nof_sn;
+    std::vector<int> solution(nof_sn, -1);
+    std::vector<char> matched(rgraph.nof_nodes, 0);
+    std::vector<int> children;
+    double total = 0;
+    for (int probe = 0; probe < nof_probes; probe++) {
+        double width = 1, size = 0;
+        int si = 0;
+        for (; si < nof_sn; si++) {
+            int n = mama.map_state_to_node[si];
+            children.clear();
+            if (mama.edges_sizes[si] == 0) {
+                for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones()) {
+                    if (!matched[IT.first])
+                        children.push_back(IT.first);
+                }
+            } else {
+                // candidates are the reference neighbours of the image of the first ordered neighbour
+                MaMaEdge &f = mama.edges[si][0];
+                int *adj;
+                int adj_size;
+                if (f.source == si) {
+                    adj = rgraph.in_adj_list[solution[f.target]];
+                    adj_size = rgraph.in_adj_sizes[solution[f.target]];
+                } else {
+                    adj = rgraph.out_adj_list[solution[f.source]];
+                    adj_size = rgraph.out_adj_sizes[solution[f.source]];
+                }
+                for (int i = 0; i < adj_size; i++) {
+                    int c = adj[i];
+                    if (matched[c] || !domains[n].get(c))
+                        continue;
+                    solution[si] = c;
+                    bool ok = true;
+                    for (int ei = 0; ei < mama.edges_sizes[si] && ok; ei++) {
+                        MaMaEdge &e = mama.edges[si][ei];
+                        ok = (e.id < 0) || edomains.domains[e.id].count(std::pair<int, int>(solution[e.source], solution[e.target])) > 0;
+                    }
+                    if (ok)
+                        children.push_back(c);
+                }
+            }
+            if (children.empty())
+                break;
+            width *= children.size();
+            size += width;
+            solution[si] = children[std::uniform_int_distribution<int>(0, (int)children.size() - 1)(rng)];
+            matched[solution[si]] = 1;
+        }
+        for (int sj = 0; sj < si && sj < nof_sn; sj++)
+            matched[solution[sj]] = 0;
+        total += size;
+    }
+    return nof_probes > 0 ? total / nof_probes : 0;
+};
+
+} // namespace rilib
+
+#endif /* MAMASAMPLED_H_ */
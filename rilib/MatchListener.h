@@ -34,13 +34,19 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define MATCHLISTENER_H_
 
 // #include "Graph.h"
+#include <iostream>
+#include <set>
 
 namespace rilib {
 
 class MatchListener {
   public:
     long matchcount;
-    MatchListener() { matchcount = 0; }
+    bool wants_matches; // if false, the solvers may only count the matches without reporting them
+    MatchListener(bool _wants_matches = true) {
+        matchcount = 0;
+        wants_matches = _wants_matches;
+    }
     virtual ~MatchListener(){};
     virtual void match(int n, int *qIDs, int *rIDs) = 0;
     virtual void match_multiple(int n, int *qIDs, int *rIDs, int si, std::set<int> *leaf_domains) = 0;
@@ -48,7 +54,7 @@ class MatchListener {
 
 class EmptyMatchListener : public MatchListener {
   public:
-    EmptyMatchListener() : MatchListener() {}
+    EmptyMatchListener() : MatchListener(false) {}
     virtual void match(int n, int *qIDs, int *rIDs) { matchcount++; };
 
     virtual void match_multiple(int n, int *qIDs, int *rIDs, int si, std::set<int> *leaf_domains){
@@ -56,36 +62,40 @@ class EmptyMatchListener : public MatchListener {
     };
 };
 
+// prints matches on a stream, std::cout by default
 class ConsoleMatchListener : public MatchListener {
+    std::ostream &os;
+
   public:
-    ConsoleMatchListener() : MatchListener() {}
+    ConsoleMatchListener() : MatchListener(), os(std::cout) {}
+    ConsoleMatchListener(std::ostream &_os) : MatchListener(), os(_os) {}
     virtual void match(int n, int *qIDs, int *rIDs) {
         matchcount++;
-        std::cout << "M:{";
+        os << "M:{";
         for (int i = 0; i < n; i++) {
-            std::cout << "(" << qIDs[i] << "," << rIDs[i] << ")";
+            os << "(" << qIDs[i] << "," << rIDs[i] << ")";
         }
-        std::cout << "}\n";
+        os << "}\n";
     }
     virtual void match_multiple(int n, int *qIDs, int *rIDs, int si, std::set<int> *leaf_domains) {
         matchcount++;
-        std::cout << "M:{";
+        os << "M:{";
         for (int i = 0; i < si; i++) {
-            std::cout << "(" << qIDs[i] << "," << rIDs[i] << ")";
+            os << "(" << qIDs[i] << "," << rIDs[i] << ")";
         }
         for (int i = si; i < n; i++) {
-            std::cout << "(" << qIDs[i] << ",[";
+            os << "(" << qIDs[i] << ",[";
             int nof = leaf_domains[i - si].size();
             int ci = 0;
             for (auto it = leaf_domains[i - si].begin(); it != leaf_domains[i - si].end(); it++) {
-                std::cout << (*it);
+                os << (*it);
                 if (ci < nof - 1)
-                    std::cout << ",";
+                    os << ",";
                 ci++;
             }
-            std::cout << "])";
+            os << "])";
         }
-        std::cout << "}\n";
+        os << "}\n";
     };
 };
 
@@ -33,6 +33,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef MATCHINGMACHINE_H_
 #define MATCHINGMACHINE_H_
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "Graph.h"
 
 namespace rilib {
@@ -59,6 +63,13 @@ class MaMaEdge {
     }
 };
 
+// symmetry breaking condition of a state: its candidate is lower (or greater) than the image of another state
+class MaMaSymmetry {
+  public:
+    int state;
+    bool lower;
+};
+
 enum MAMA_PARENTTYPE { PARENTTYPE_IN, PARENTTYPE_OUT, PARENTTYPE_NULL };
 
 class MatchingMachine {
@@ -79,11 +90,15 @@ class MatchingMachine {
 
     int nof_leafs;
 
+    int *sym_sizes;           // indexed by state_id
+    MaMaSymmetry **sym_conds; // indexed by state_id, checked at the later state of each pair (see Automorphisms.h)
+
     MatchingMachine(Graph &query) {
 #ifdef MDEBUG
         std::cout << "mama constructor (" << query.nof_nodes << ")...\n";
 #endif
-        nof_sn = query.nof_nodes;
+        // the readers do not check the node count, a negative one would size the arrays below beyond any object
+        nof_sn = std::max(query.nof_nodes, 0);
         nodes_attrs = new void *[nof_sn];
         edges_sizes = (int *)calloc(nof_sn, sizeof(int));
         o_edges_sizes = (int *)calloc(nof_sn, sizeof(int));
@@ -93,9 +108,20 @@ class MatchingMachine {
         map_node_to_state = (int *)calloc(nof_sn, sizeof(int));
         map_state_to_node = (int *)calloc(nof_sn, sizeof(int));
         parent_state = (int *)calloc(nof_sn, sizeof(int));
+        sym_sizes = (int *)calloc(nof_sn, sizeof(int));
         parent_type = new MAMA_PARENTTYPE[nof_sn];
+        // machines which do not compute the parents leave the whole domain to the solver
+        for (int i = 0; i < nof_sn; i++) {
+            parent_state[i] = -1;
+            parent_type[i] = PARENTTYPE_NULL;
+        }
 
         nof_leafs = 0; // only used by MaMaxxxLeafs
+
+        sym_conds = new MaMaSymmetry *[nof_sn];
+        for (int i = 0; i < nof_sn; i++) {
+            sym_conds[i] = NULL;
+        }
 #ifdef MDEBUG
         std::cout << "done...\n";
 #endif
@@ -114,19 +140,53 @@ class MatchingMachine {
         free(map_state_to_node);
         free(parent_state);
         delete[] parent_type;
+        free(sym_sizes);
+        for (int i = 0; i < nof_sn; i++) {
+            delete[] sym_conds[i];
+        }
+        delete[] sym_conds;
+    }
+
+    // the image of the first node of each pair must be lower than the image of the second one
+    void set_symmetry(std::vector<std::pair<int, int> > &conditions) {
+        for (int si = 0; si < nof_sn; si++) {
+            delete[] sym_conds[si];
+            sym_conds[si] = NULL;
+            sym_sizes[si] = 0;
+        }
+        for (size_t c = 0; c < conditions.size(); c++) {
+            sym_sizes[std::max(map_node_to_state[conditions[c].first], map_node_to_state[conditions[c].second])]++;
+        }
+        for (int si = 0; si < nof_sn; si++) {
+            if (sym_sizes[si] > 0)
+                sym_conds[si] = new MaMaSymmetry[sym_sizes[si]];
+            sym_sizes[si] = 0;
+        }
+        for (size_t c = 0; c < conditions.size(); c++) {
+            int ls = map_node_to_state[conditions[c].first];
+            int gs = map_node_to_state[conditions[c].second];
+            MaMaSymmetry &cond = (ls > gs) ? sym_conds[ls][sym_sizes[ls]++] : sym_conds[gs][sym_sizes[gs]++];
+            cond.state = (ls > gs) ? gs : ls;
+            cond.lower = (ls > gs);
+        }
     }
 
     void fix_eids(Graph &query) {
         int source, target, eid;
+
+        // id of the first out edge of each node
+        int *eid_offsets = new int[query.nof_nodes + 1];
+        eid_offsets[0] = 0;
+        for (int i = 0; i < query.nof_nodes; i++) {
+            eid_offsets[i + 1] = eid_offsets[i] + query.out_adj_sizes[i];
+        }
+
         for (int si = 0; si < nof_sn; si++) {
             for (int ei = 0; ei < edges_sizes[si]; ei++) {
                 source = map_state_to_node[edges[si][ei].source];
                 target = map_state_to_node[edges[si][ei].target];
 
-                eid = 0;
-                for (int i = 0; i < source; i++) {
-                    eid += query.out_adj_sizes[i];
-                }
+                eid = eid_offsets[source];
                 for (int i = 0; i < query.out_adj_sizes[source]; i++) {
                     if (query.out_adj_list[source][i] == target) {
                         edges[si][ei].id = eid;
@@ -136,6 +196,8 @@ class MatchingMachine {
                 }
             }
         }
+
+        delete[] eid_offsets;
     }
 
     void print() {
@@ -0,0 +1,143 @@
+/*
+ * NogoodCache.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef NOGOODCACHE_H_
+#define NOGOODCACHE_H_
+
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Counts of the subtrees of a search, kept within a memory cap and evicted
+ * least recently used first.
+ * A subtree is keyed by its first state and the images of the earlier states
+ * it depends on (the ones with arcs or symmetry conditions towards it). Its
+ * count depends on the other earlier states only through the reference nodes
+ * they hold, so each entry also lists the nodes whose matched flag the subtree
+ * read, and a hit needs the same flags. A count of zero is a nogood.
+ */
+
+namespace rilib {
+
+class NogoodCache {
+  public:
+    struct Entry {
+        std::vector<int> key;
+        std::vector<int> nodes;   // sorted
+        std::vector<bool> flags;  // indexed as nodes, matched when the subtree was searched
+        long count;
+        size_t bytes;
+    };
+
+  private:
+    struct key_hash {
+        size_t operator()(const std::vector<int> &key) const {
+            size_t h = 14695981039346656037UL;
+            for (size_t i = 0; i < key.size(); i++)
+                h = (h ^ (size_t)key[i]) * 1099511628211UL;
+            return h;
+        }
+    };
+
+    typedef std::list<Entry> entry_list;
+    entry_list entries; // most recently used first
+    std::unordered_map<std::vector<int>, entry_list::iterator, key_hash> index;
+    size_t bytes;
+    size_t capacity;
+
+  public:
+    long hits;
+    long misses;
+    long evictions;
+
+    NogoodCache(size_t _capacity) : bytes(0), capacity(_capacity), hits(0), misses(0), evictions(0) {}
+
+    // the entry of key if the nodes it read have the same matched flags, NULL otherwise
+    Entry *find(std::vector<int> &key, bool *matched) {
+        std::unordered_map<std::vector<int>, entry_list::iterator, key_hash>::iterator it = index.find(key);
+        if (it != index.end()) {
+            Entry &e = *it->second;
+            bool same = true;
+            for (size_t i = 0; i < e.nodes.size() && same; i++)
+                same = (matched[e.nodes[i]] == e.flags[i]);
+            if (same) {
+                entries.splice(entries.begin(), entries, it->second);
+                hits++;
+                return &e;
+            }
+        }
+        misses++;
+        return NULL;
+    }
+
+    // nodes may have repetitions, an older entry of the key is replaced
+    void insert(std::vector<int> &key, std::vector<int> &nodes, bool *matched, long count) {
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        size_t size = sizeof(Entry) + 2 * sizeof(void *) + (key.size() + nodes.size()) * sizeof(int) + nodes.size() / 8 + 64;
+        if (size > capacity)
+            return;
+        erase(key);
+        entries.push_front(Entry());
+        Entry &e = entries.front();
+        e.key = key;
+        e.nodes.swap(nodes);
+        e.flags.resize(e.nodes.size());
+        for (size_t i = 0; i < e.nodes.size(); i++)
+            e.flags[i] = matched[e.nodes[i]];
+        e.count = count;
+        e.bytes = size;
+        index[e.key] = entries.begin();
+        bytes += size;
+        while (bytes > capacity) {
+            erase(entries.back().key);
+            evictions++;
+        }
+    }
+
+  private:
+    void erase(const std::vector<int> &key) {
+        std::unordered_map<std::vector<int>, entry_list::iterator, key_hash>::iterator it = index.find(key);
+        if (it == index.end())
+            return;
+        entry_list::iterator eit = it->second;
+        bytes -= eit->bytes;
+        index.erase(it);
+        entries.erase(eit);
+    }
+};
+
+} // namespace rilib
+
+#endif /* NOGOODCACHE_H_ */
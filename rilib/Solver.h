@@ -35,12 +35,18 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 // #define SOLVER_H_MDEBUG
 
+#include "Arena.h"
+#include "Deadline.h"
+#include "DisjointFamilies.h"
 #include "Domains.h"
 #include "Graph.h"
 #include "MatchingMachine.h"
+#include "NogoodCache.h"
 #include "sbitset.h"
 
+#include <algorithm>
 #include <unordered_map>
+#include <vector>
 
 namespace rilib {
 
@@ -61,17 +67,51 @@ class Solver {
     long matchedcouples;
 
     long matchcount;
+    long match_limit;   // stop after this many matches, 0 to find them all
+    Deadline *deadline; // stop the search once it is over, NULL for no time limit
+    bool backjump;      // skip the states which take no part in the failure of a later state (solve_rp only)
+    bool forward;       // check the candidates of the later neighbours after each assignment (solve_rp only)
+    long cache_bytes;   // memory of the subtree counts reused by solve_rp, 0 for none (see NogoodCache.h)
+    long cache_hits;
+    long cache_misses;
+    long cache_evictions;
+
+    bool keep_neighs;       // keep the counts below on each assignment, for the solvers whose countsCheck reads them
+    int *o_matched_neighs;  // indexed by node_id, matched out neighbours of each reference node
+    int *i_matched_neighs;  // indexed by node_id, matched in neighbours of each reference node
+
+    Arena *arena; // scratch memory of the solve methods
+    bool own_arena;
 
   public:
-    Solver(MatchingMachine &_mama, Graph &_rgraph, Graph &_qgraph, AttributeComparator &_nodeComparator, AttributeComparator &_edgeComparator, MatchListener &_matchListener, sbitset *_domains, int *_domains_size, EdgeDomains &_edomains) : mama(_mama), rgraph(_rgraph), qgraph(_qgraph), nodeComparator(_nodeComparator), edgeComparator(_edgeComparator), matchListener(_matchListener), domains(_domains), domains_size(_domains_size), edomains(_edomains) {
+    // if no arena is given, the solver uses its own, released by the destructor
+    Solver(MatchingMachine &_mama, Graph &_rgraph, Graph &_qgraph, AttributeComparator &_nodeComparator, AttributeComparator &_edgeComparator, MatchListener &_matchListener, sbitset *_domains, int *_domains_size, EdgeDomains &_edomains, Arena *_arena = NULL) : mama(_mama), rgraph(_rgraph), qgraph(_qgraph), nodeComparator(_nodeComparator), edgeComparator(_edgeComparator), matchListener(_matchListener), domains(_domains), domains_size(_domains_size), edomains(_edomains) {
         steps = 0;
         triedcouples = 0;
         matchedcouples = 0;
 
         matchcount = 0;
+        match_limit = 0;
+        deadline = NULL;
+        backjump = false;
+        forward = false;
+        cache_bytes = 0;
+        cache_hits = 0;
+        cache_misses = 0;
+        cache_evictions = 0;
+
+        keep_neighs = false;
+        o_matched_neighs = NULL;
+        i_matched_neighs = NULL;
+
+        own_arena = (_arena == NULL);
+        arena = own_arena ? new Arena() : _arena;
     }
 
-    virtual ~Solver() {}
+    virtual ~Solver() {
+        if (own_arena)
+            delete arena;
+    }
 
     void solve() {
 
@@ -86,20 +126,20 @@ class Solver {
         int *parent_state = mama.parent_state;           // indexed by state_id
         MAMA_PARENTTYPE *parent_type = mama.parent_type; // indexed by state id
 
-        int **candidates = new int *[nof_sn];  // indexed by state_id
-        int *candidatesIT = new int[nof_sn];   // indexed by state_id
-        int *candidatesSize = new int[nof_sn]; // indexed by state_id
-        int *solution = new int[nof_sn];       // indexed by state_id
+        int **candidates = arena->alloc<int *>(nof_sn);  // indexed by state_id
+        int *candidatesIT = arena->alloc<int>(nof_sn);   // indexed by state_id
+        int *candidatesSize = arena->alloc<int>(nof_sn); // indexed by state_id
+        int *solution = arena->alloc<int>(nof_sn);       // indexed by state_id
         for (ii = 0; ii < nof_sn; ii++)
             solution[ii] = -1;
 
-        bool *matched = (bool *)calloc(rgraph.nof_nodes, sizeof(bool)); // indexed by node_id
+        bool *matched = alloc_matched(); // indexed by node_id
 
         for (int i = 0; i < nof_sn; i++) {
             if (parent_type[i] == PARENTTYPE_NULL) {
                 // std::cout<<"parent type null "<<i<<"\n";
                 int n = map_state_to_node[i];
-                candidates[i] = new int[domains_size[n]];
+                candidates[i] = arena->alloc<int>(domains_size[n]);
 
                 int k = 0;
                 for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones()) {
@@ -121,7 +161,7 @@ class Solver {
         while (si != -1) {
 
             if (psi >= si) {
-                matched[solution[si]] = false;
+                set_matched(matched, solution[si], false);
             }
 
             CandidateIndex = -1;
@@ -141,7 +181,7 @@ class Solver {
                 }
 #endif
 
-                if ((!matched[CandidateIndex]) && domains[map_state_to_node[si]].get(CandidateIndex) && edgesCheck(si, CandidateIndex, solution, matched)) {
+                if ((!matched[CandidateIndex]) && domains[map_state_to_node[si]].get(CandidateIndex) && edgesCheck(si, CandidateIndex, solution, matched) && symmetryCheck(si, CandidateIndex, solution)) {
                     break;
                 } else {
                     CandidateIndex = -1;
@@ -154,6 +194,10 @@ class Solver {
                 si--;
             } else {
                 matchedcouples++;
+                if (out_of_time()) {
+                    si = -1;
+                    continue;
+                }
 
                 if (si == nof_sn - 1) {
                     matchListener.match(nof_sn, map_state_to_node, solution);
@@ -161,15 +205,10 @@ class Solver {
                     matchcount++;
 
                     psi = si;
-#ifdef FIRST_MATCH_ONLY
-                    si = -1;
-#endif
-#ifdef FIRST_100k_MATCHES
-                    if (matchcount >= 100000)
+                    if (match_limit > 0 && matchcount >= match_limit)
                         si = -1;
-#endif
                 } else {
-                    matched[solution[si]] = true;
+                    set_matched(matched, solution[si], true);
                     sip1 = si + 1;
                     if (parent_type[sip1] == PARENTTYPE_NULL) {
                     } else {
@@ -200,18 +239,18 @@ class Solver {
         int *parent_state = mama.parent_state;           // indexed by state_id
         MAMA_PARENTTYPE *parent_type = mama.parent_type; // indexed by state id
 
-        int **candidates = new int *[nof_sn];         // indexed by state_id
-        int **candidates_parents = new int *[nof_sn]; // indexed by state_id
-        int *candidatesIT = new int[nof_sn];          // indexed by state_id
-        int *candidatesSize = new int[nof_sn];        // indexed by state_id
+        int **candidates = arena->alloc<int *>(nof_sn);         // indexed by state_id
+        int **candidates_parents = arena->alloc<int *>(nof_sn); // indexed by state_id
+        int *candidatesIT = arena->alloc<int>(nof_sn);          // indexed by state_id
+        int *candidatesSize = arena->alloc<int>(nof_sn);        // indexed by state_id
 
         matchcount = 0;
 
-        int *solution = new int[nof_sn]; // indexed by state_id
+        int *solution = arena->alloc<int>(nof_sn); // indexed by state_id
         for (ii = 0; ii < nof_sn; ii++)
             solution[ii] = -1;
 
-        bool *matched = (bool *)calloc(rgraph.nof_nodes, sizeof(bool)); // indexed by node_id
+        bool *matched = alloc_matched(); // indexed by node_id
 
         for (int i = 0; i < nof_sn; i++) {
 #ifdef MDEBUG
@@ -219,8 +258,8 @@ class Solver {
 #endif
             if (parent_type[i] == PARENTTYPE_NULL) {
                 int n = map_state_to_node[i];
-                candidates[i] = new int[domains_size[n]];
-                candidates_parents[i] = new int[domains_size[n]];
+                candidates[i] = arena->alloc<int>(domains_size[n]);
+                candidates_parents[i] = arena->alloc<int>(domains_size[n]);
 
                 int k = 0;
                 for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones()) {
@@ -259,8 +298,8 @@ class Solver {
 
                 candidatesSize[i] = edomains.domains[eid].size();
                 candidatesIT[i] = -1;
-                candidates[i] = new int[candidatesSize[i]];
-                candidates_parents[i] = new int[candidatesSize[i]];
+                candidates[i] = arena->alloc<int>(candidatesSize[i]);
+                candidates_parents[i] = arena->alloc<int>(candidatesSize[i]);
                 unordered_edge_set *eset = &(edomains.domains[eid]);
                 int j = 0;
                 for (unordered_edge_set::iterator eit = eset->begin(); eit != eset->end(); eit++) {
@@ -294,7 +333,7 @@ class Solver {
         while (si != -1) {
 
             if (psi >= si) {
-                matched[solution[si]] = false;
+                set_matched(matched, solution[si], false);
             }
 
             CandidateIndex = -1;
@@ -308,7 +347,7 @@ class Solver {
                 std::cout << "S: " << si << " " << CandidateIndex << "\n";
 #endif
 
-                if (((candidates_parents[si][candidatesIT[si]] == -1) || (candidates_parents[si][candidatesIT[si]] == solution[parent_state[si]])) && (!matched[candidates[si][candidatesIT[si]]] && edgesCheck(si, CandidateIndex, solution, matched))) {
+                if (((candidates_parents[si][candidatesIT[si]] == -1) || (candidates_parents[si][candidatesIT[si]] == solution[parent_state[si]])) && (!matched[candidates[si][candidatesIT[si]]] && edgesCheck(si, CandidateIndex, solution, matched) && symmetryCheck(si, CandidateIndex, solution))) {
                     break;
                 } else {
                     CandidateIndex = -1;
@@ -326,6 +365,10 @@ class Solver {
                 si--;
             } else {
                 matchedcouples++;
+                if (out_of_time()) {
+                    si = -1;
+                    continue;
+                }
 
                 if (si == nof_sn - 1) {
 
@@ -334,15 +377,10 @@ class Solver {
                     matchcount++;
 
                     psi = si;
-#ifdef FIRST_MATCH_ONLY
-                    si = -1;
-#endif
-#ifdef FIRST_100k_MATCHES
-                    if (matchcount >= 100000)
+                    if (match_limit > 0 && matchcount >= match_limit)
                         si = -1;
-#endif
                 } else {
-                    matched[solution[si]] = true;
+                    set_matched(matched, solution[si], true);
                     sip1 = si + 1;
                     candidatesIT[si + 1] = -1;
                     psi = si;
@@ -361,14 +399,39 @@ class Solver {
         }
     };
 
-    void solve_rp() {
+    typedef std::unordered_map<std::pair<int, int>, int, hash_pair> cand_ecount_t; // (tnodeid,eid) -> count
+
+    // candidates of the unassigned states allowed by their assigned neighbours, updated at each assignment
+    struct ForwardCounts {
+        int *sizes;         // indexed by state_id, arcs with later states
+        int **targets;      // indexed by state_id, the later state of each arc
+        int **eids;         // indexed by state_id, the id of each arc
+        int **trail;        // indexed by state_id, the count of the later state of each arc before the assignment
+        bool *applied;      // indexed by state_id
+        int *counts;        // indexed by state_id
+        int *nof_assigned;  // indexed by state_id, arcs with assigned states
+        int **support;      // indexed by state_id, arcs of the assigned states allowing each node, NULL if too large
+        int **runs;         // indexed by eid, as ordered_edge_domains in solve_rp
+        int *runs_sizes;    // indexed by eid
+        cand_ecount_t *positions;
+        cand_ecount_t *counter;
+    };
+
+    template <bool Backjump, bool Forward, bool Cache, bool KeepNeighs>
+    void solve_rp() { solve_rp<Backjump, Forward, Cache, KeepNeighs>(mama.nof_sn, NULL, NULL); }
+
+    // search of the first nof_core states, each match of them stands for the product of the
+    // tree counts attached to its states and of the counts of the tree units (see SolveTrees),
+    // or for a single match if they are NULL.
+    // the options are template arguments, they must agree with backjump, forward, cache_bytes and
+    // keep_neighs (see run_solver in engine.h), the loop of an option left off does not test it
+    template <bool Backjump, bool Forward, bool Cache, bool KeepNeighs>
+    void solve_rp(int nof_core, int *att_sizes, long ***att_counts, std::vector<std::vector<std::vector<int> > > *units = NULL) {
 
         int nof_sn = mama.nof_sn;
         int *map_node_to_state = mama.map_node_to_state; // indexed by node_id
         int *map_state_to_node = mama.map_state_to_node; // indexed by state_id
 
-        typedef std::unordered_map<std::pair<int, int>, int, hash_pair> cand_ecount_t; // (tnodeid,eid) -> count
-
         cand_ecount_t ce_counter;
         cand_ecount_t ce_positions;
 
@@ -380,14 +443,16 @@ class Solver {
 
         typedef std::set<std::pair<int, int>> ordered_edge_set;
 
+#ifdef MDEBUG
         std::cout << "ORDERED EDGE SETS...\n";
+#endif
 
-        int **ordered_edge_domains = new int *[edomains.nof_pattern_edges];
-        int *ordered_edge_domains_sizes = new int[edomains.nof_pattern_edges];
+        int **ordered_edge_domains = arena->alloc<int *>(edomains.nof_pattern_edges);
+        int *ordered_edge_domains_sizes = arena->alloc<int>(edomains.nof_pattern_edges);
 
         for (int eid = 0; eid < edomains.nof_pattern_edges; eid++) {
             unordered_edge_set *eset = &(edomains.domains[eid]);
-            ordered_edge_domains[eid] = new int[eset->size() * 2];
+            ordered_edge_domains[eid] = arena->alloc<int>(eset->size() * 2);
             ordered_edge_domains_sizes[eid] = eset->size();
         }
         for (int i = 0; i < nof_sn; i++) {
@@ -439,13 +504,15 @@ class Solver {
             }
         }
 
+#ifdef MDEBUG
         std::cout << "ORDERED EDGE SETS: done\n";
+#endif
 
-        int **f_domains = new int *[nof_sn];
+        int **f_domains = arena->alloc<int *>(nof_sn);
         for (int si = 0; si < nof_sn; si++) {
             if (mama.edges_sizes[si] == 0) {
                 int n = map_state_to_node[si];
-                f_domains[si] = new int[domains_size[n]];
+                f_domains[si] = arena->alloc<int>(domains_size[n]);
                 int k = 0;
                 for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones()) {
                     f_domains[si][k] = IT.first;
@@ -454,21 +521,86 @@ class Solver {
             }
         }
 
-        int *candidateIT = new int[nof_sn];
-        int *candidateITeid = new int[nof_sn];
-        int *candidateITpnode = new int[nof_sn];
-        int *candidateITpstate = new int[nof_sn];
-        int *candidateITsize = new int[nof_sn];
+        ForwardCounts fc;
+        if (Forward)
+            init_forward(fc, nof_core, ordered_edge_domains, ordered_edge_domains_sizes, ce_positions, ce_counter);
+
+        int *candidateIT = arena->alloc<int>(nof_sn);
+        int *candidateITeid = arena->alloc<int>(nof_sn);
+        int *candidateITpnode = arena->alloc<int>(nof_sn);
+        int *candidateITpstate = arena->alloc<int>(nof_sn);
+        int *candidateITsize = arena->alloc<int>(nof_sn);
 
         for (int i = 0; i < nof_sn; i++) {
             candidateIT[i] = -1;
         }
 
-        int *solution = new int[nof_sn]; // indexed by state_id
+        int *solution = arena->alloc<int>(nof_sn); // indexed by state_id
         for (int i = 0; i < nof_sn; i++)
             solution[i] = -1;
 
-        bool *matched = (bool *)calloc(rgraph.nof_nodes, sizeof(bool)); // indexed by node_id
+        bool *matched = alloc_matched(); // indexed by node_id
+        DisjointFamilies families;
+
+        // failing sets: the states whose images explain why the subtree of each state found nothing.
+        // a state missing from the failing set of its child would fail again with any other candidate
+        int fwords = (nof_sn + 63) / 64;
+        unsigned long *reasons = NULL;  // indexed by state_id, the state and its earlier neighbours
+        unsigned long *failing = NULL;  // indexed by state_id
+        bool *found = NULL;             // indexed by state_id, a match was found since the state was entered
+        int *matched_state = NULL;      // indexed by node_id
+        if (Backjump) {
+            reasons = arena->zalloc<unsigned long>(nof_sn * fwords);
+            failing = arena->zalloc<unsigned long>(nof_sn * fwords);
+            found = arena->zalloc<bool>(nof_sn);
+            matched_state = arena->alloc<int>(rgraph.nof_nodes);
+            for (int s = 0; s < nof_sn; s++) {
+                set_bit(reasons + s * fwords, s);
+                for (int me = 0; me < mama.edges_sizes[s]; me++)
+                    set_bit(reasons + s * fwords, (mama.edges[s][me].source == s) ? mama.edges[s][me].target : mama.edges[s][me].source);
+                for (int k = 0; k < mama.sym_sizes[s]; k++)
+                    set_bit(reasons + s * fwords, mama.sym_conds[s][k].state);
+            }
+        }
+
+        // subtree counts reused under other prefixes. the subtree of a state reads the images of the earlier
+        // states with arcs or conditions towards it or its followers, and the matched flags it logs in touched.
+        // a log longer than its cap is dropped together with the keys of the open states
+        NogoodCache *cache = NULL;
+        std::vector<std::vector<int> > bounds(nof_sn); // indexed by state_id
+        std::vector<std::vector<int> > keys(nof_sn);   // indexed by state_id
+        std::vector<int> touched;
+        size_t touched_cap = 4 * (size_t)rgraph.nof_nodes + 4096;
+        bool *keyed = NULL;           // indexed by state_id, a key waits for the count of the subtree
+        long *enter_count = NULL;     // indexed by state_id
+        size_t *enter_touched = NULL; // indexed by state_id
+        int *enter_generation = NULL; // indexed by state_id
+        long *enter_jumps = NULL;     // indexed by state_id
+        int generation = 0;
+        long jumps = 0;
+        if (Cache && cache_bytes > 0 && att_sizes == NULL && match_limit == 0) {
+            cache = new NogoodCache(cache_bytes);
+            std::vector<int> last(nof_sn, -1);
+            for (int t = 0; t < nof_core; t++) {
+                for (int me = 0; me < mama.edges_sizes[t]; me++) {
+                    int s = (mama.edges[t][me].source == t) ? mama.edges[t][me].target : mama.edges[t][me].source;
+                    last[s] = std::max(last[s], t);
+                }
+                for (int k = 0; k < mama.sym_sizes[t]; k++)
+                    last[mama.sym_conds[t][k].state] = std::max(last[mama.sym_conds[t][k].state], t);
+            }
+            for (int t = 0; t < nof_core; t++) {
+                for (int s = 0; s < t; s++) {
+                    if (last[s] >= t)
+                        bounds[t].push_back(s);
+                }
+            }
+            keyed = arena->zalloc<bool>(nof_sn);
+            enter_count = arena->alloc<long>(nof_sn);
+            enter_touched = arena->alloc<size_t>(nof_sn);
+            enter_generation = arena->alloc<int>(nof_sn);
+            enter_jumps = arena->alloc<long>(nof_sn);
+        }
 
         int psi = -1;
         int si = 0;
@@ -483,12 +615,63 @@ class Solver {
 #endif
 
             if (psi >= si) {
-                matched[solution[si]] = false;
+                set_matched<KeepNeighs>(matched, solution[si], false);
+                if (Forward && fc.applied[si])
+                    undo_forward(fc, si, fc.sizes[si], solution[si]);
+            }
+
+            // back from a failed child which does not depend on si: its other candidates are skipped
+            if (Backjump && psi > si) {
+                if (found[psi]) {
+                    found[si] = true;
+                } else if (!get_bit(failing + psi * fwords, si)) {
+                    std::copy(failing + psi * fwords, failing + (psi + 1) * fwords, failing + si * fwords);
+                    candidateIT[si] = -1;
+                    jumps++;
+                    psi = si;
+                    si--;
+                    continue;
+                } else {
+                    for (int w = 0; w < fwords; w++)
+                        failing[si * fwords + w] |= failing[psi * fwords + w];
+                }
             }
 
             CandidateIndex = -1;
 
             if (candidateIT[si] == -1) {
+                // a subtree counted under another prefix with the same key and flags is not searched again
+                if (Cache && cache != NULL) {
+                    keyed[si] = false;
+                    if (si > 0 && si < nof_core - 1) {
+                        std::vector<int> &key = keys[si];
+                        key.assign(1, si);
+                        for (size_t b = 0; b < bounds[si].size(); b++)
+                            key.push_back(solution[bounds[si][b]]);
+                        NogoodCache::Entry *e = cache->find(key, matched);
+                        if (e != NULL && (e->count == 0 || !matchListener.wants_matches)) {
+                            matchcount += e->count;
+                            touched.insert(touched.end(), e->nodes.begin(), e->nodes.end());
+                            if (Backjump) {
+                                std::fill(failing + si * fwords, failing + (si + 1) * fwords, ~0UL);
+                                found[si] = (e->count > 0);
+                            }
+                            psi = si;
+                            si--;
+                            continue;
+                        }
+                        keyed[si] = true;
+                        enter_count[si] = matchcount;
+                        enter_touched[si] = touched.size();
+                        enter_generation[si] = generation;
+                        enter_jumps[si] = jumps;
+                    }
+                }
+                // the candidates which are not generated or fail the edge checks depend on the neighbours of si
+                if (Backjump) {
+                    std::copy(reasons + si * fwords, reasons + (si + 1) * fwords, failing + si * fwords);
+                    found[si] = false;
+                }
                 if (mama.edges_sizes[si] == 0) {
                     candidateIT[si] = -1;
                     candidateITsize[si] = domains_size[map_state_to_node[si]];
@@ -550,16 +733,23 @@ class Solver {
             if (mama.edges_sizes[si] == 0) {
                 candidateIT[si]++;
                 while (candidateIT[si] < candidateITsize[si]) {
+                    if (Cache && cache != NULL)
+                        touch(touched, touched_cap, generation, f_domains[si][candidateIT[si]]);
                     if (!matched[f_domains[si][candidateIT[si]]]) {
 
                         CandidateIndex = f_domains[si][candidateIT[si]];
 
                         solution[si] = CandidateIndex;
-                        if (edgesCheck(si, CandidateIndex, solution, matched)) {
+                        if (edgesCheck(si, CandidateIndex, solution, matched) && symmetryCheck(si, CandidateIndex, solution) &&
+                            treesCheck(si, CandidateIndex, att_sizes, att_counts) && forwardCheck<Forward>(fc, si, CandidateIndex, failing, reasons, fwords)) {
                             break;
                         } else {
+                            if (Backjump)
+                                edgesReasons(CandidateIndex, matched, matched_state, failing + si * fwords);
                             CandidateIndex = -1;
                         }
+                    } else if (Backjump) {
+                        set_bit(failing + si * fwords, matched_state[f_domains[si][candidateIT[si]]]);
                     }
                     candidateIT[si]++;
                 }
@@ -573,6 +763,8 @@ class Solver {
                     std::cout << "pCI " << candidateIT[si] << "; size " << candidateITsize[si] << "; eid " << candidateITeid[si] << " " << ordered_edge_domains[candidateITeid[si]][candidateIT[si]] << "-" << ordered_edge_domains[candidateITeid[si]][candidateIT[si] + candidateITsize[si]] << ":" << ordered_edge_domains[candidateITeid[si]][candidateIT[si] + candidateITsize[si]] << "; pnode " << candidateITpnode[si] << "\n";
 #endif
                     if (ordered_edge_domains[candidateITeid[si]][candidateIT[si]] == candidateITpnode[si]) {
+                        if (Cache && cache != NULL)
+                            touch(touched, touched_cap, generation, ordered_edge_domains[candidateITeid[si]][candidateIT[si] + candidateITsize[si]]);
                         if (!matched[ordered_edge_domains[candidateITeid[si]][candidateIT[si] + candidateITsize[si]]]) {
                             CandidateIndex = ordered_edge_domains[candidateITeid[si]][candidateIT[si] + candidateITsize[si]];
                             solution[si] = CandidateIndex;
@@ -588,17 +780,25 @@ class Solver {
                                     }
                                 }
                                 if (checked)
-                                    checked &= edgesCheck(si, CandidateIndex, solution, matched);
+                                    checked &= edgesCheck(si, CandidateIndex, solution, matched) && symmetryCheck(si, CandidateIndex, solution) &&
+                                               treesCheck(si, CandidateIndex, att_sizes, att_counts) && forwardCheck<Forward>(fc, si, CandidateIndex, failing, reasons, fwords);
 
                                 if (checked) {
                                     break;
                                 } else {
+                                    if (Backjump)
+                                        edgesReasons(CandidateIndex, matched, matched_state, failing + si * fwords);
                                     CandidateIndex = -1;
                                 }
-                            } else {
+                            } else if (symmetryCheck(si, CandidateIndex, solution) && treesCheck(si, CandidateIndex, att_sizes, att_counts) &&
+                                       forwardCheck<Forward>(fc, si, CandidateIndex, failing, reasons, fwords)) {
                                 break;
+                            } else {
+                                CandidateIndex = -1;
                             }
 
+                        } else if (Backjump) {
+                            set_bit(failing + si * fwords, matched_state[ordered_edge_domains[candidateITeid[si]][candidateIT[si] + candidateITsize[si]]]);
                         }
 #ifdef MDEBUG
                         else {
@@ -628,37 +828,484 @@ class Solver {
 
             if (CandidateIndex == -1) {
                 candidateIT[si] = -1;
+                // subtrees which read a few flags are cheaper to search again than to store
+                if (Cache && cache != NULL && keyed[si]) {
+                    keyed[si] = false;
+                    if (enter_generation[si] == generation && enter_jumps[si] == jumps && touched.size() - enter_touched[si] >= 64) {
+                        std::vector<int> nodes(touched.begin() + enter_touched[si], touched.end());
+                        cache->insert(keys[si], nodes, matched, matchcount - enter_count[si]);
+                    }
+                }
 
                 psi = si;
                 si--;
             } else {
                 matchedcouples++;
+                if (out_of_time()) {
+                    si = -1;
+                    continue;
+                }
 
-                if (si == nof_sn - 1) {
-#ifdef PRINT_MATCHES
-                    matchListener.match(nof_sn, map_state_to_node, solution);
-#endif
-                    matchcount++;
+                if (si == nof_core - 1) {
+                    if (Backjump)
+                        found[si] = true;
+                    if (att_sizes == NULL) {
+                        if (matchListener.wants_matches)
+                            matchListener.match(nof_sn, map_state_to_node, solution);
+                        matchcount++;
+                    } else {
+                        long trees = 1;
+                        for (int s = 0; s < nof_core; s++) {
+                            for (int a = 0; a < att_sizes[s]; a++)
+                                trees *= att_counts[s][a][solution[s]];
+                        }
+                        if (trees != 0 && units != NULL) {
+                            set_matched<KeepNeighs>(matched, solution[si], true);
+                            trees *= count_units(*units, families, solution, matched);
+                            set_matched<KeepNeighs>(matched, solution[si], false);
+                        }
+                        matchcount += trees;
+                    }
 
                     psi = si;
-#ifdef FIRST_MATCH_ONLY
-                    si = -1;
-//					return IF U WANT JUST AN INSTANCE
-#endif
-#ifdef FIRST_100k_MATCHES
-                    if (matchcount >= 100000)
+                    if (match_limit > 0 && matchcount >= match_limit)
                         si = -1;
-#endif
                 } else {
-                    matched[solution[si]] = true;
+                    set_matched<KeepNeighs>(matched, solution[si], true);
+                    if (Backjump)
+                        matched_state[solution[si]] = si;
                     sip1 = si + 1;
                     psi = si;
                     si++;
                 }
             }
         }
+
+        if (Cache && cache != NULL) {
+            cache_hits += cache->hits;
+            cache_misses += cache->misses;
+            cache_evictions += cache->evictions;
+            delete cache;
+        }
+    };
+
+    // fail-first search: the order of the matching machine is not used, at each depth
+    // the unmatched query node with the fewest candidates is matched next.
+    // the candidates of a node are the shortest run of edge domain pairs reaching it
+    // from an already matched neighbour, the runs are updated at every assignment
+    // and restored from a trail when backtracking.
+    void solve_ff() {
+
+        int nof_sn = qgraph.nof_nodes;
+        int nof_edges = edomains.nof_pattern_edges;
+
+        matchcount = 0;
+
+        if (nof_sn == 0)
+            return;
+
+        // edge domains sorted by source (s_runs) and by target (t_runs),
+        // the keys are in [0, size) and the other endpoints in [size, 2 * size)
+        int **s_runs = arena->alloc<int *>(nof_edges);
+        int **t_runs = arena->alloc<int *>(nof_edges);
+        int *runs_sizes = arena->alloc<int>(nof_edges);
+        std::vector<std::pair<int, int>> pairs;
+        for (int eid = 0; eid < nof_edges; eid++) {
+            unordered_edge_set *eset = &(edomains.domains[eid]);
+            int size = (int)eset->size();
+            runs_sizes[eid] = size;
+            s_runs[eid] = arena->alloc<int>(size * 2);
+            t_runs[eid] = arena->alloc<int>(size * 2);
+
+            pairs.assign(eset->begin(), eset->end());
+            std::sort(pairs.begin(), pairs.end());
+            for (int k = 0; k < size; k++) {
+                s_runs[eid][k] = pairs[k].first;
+                s_runs[eid][k + size] = pairs[k].second;
+            }
+            for (int k = 0; k < size; k++)
+                pairs[k] = std::pair<int, int>(pairs[k].second, pairs[k].first);
+            std::sort(pairs.begin(), pairs.end());
+            for (int k = 0; k < size; k++) {
+                t_runs[eid][k] = pairs[k].first;
+                t_runs[eid][k + size] = pairs[k].second;
+            }
+        }
+
+        int **f_domains = arena->alloc<int *>(nof_sn); // indexed by node_id
+        for (int n = 0; n < nof_sn; n++) {
+            f_domains[n] = arena->alloc<int>(domains_size[n]);
+            int k = 0;
+            for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones()) {
+                f_domains[n][k] = IT.first;
+                k++;
+            }
+        }
+
+        // current best run of each query node, a NULL run stands for the whole domain
+        int **best_runs = arena->alloc<int *>(nof_sn);
+        int *best_begin = arena->alloc<int>(nof_sn);
+        int *best_size = arena->alloc<int>(nof_sn);
+        int *best_total = arena->alloc<int>(nof_sn);
+        for (int n = 0; n < nof_sn; n++) {
+            best_runs[n] = NULL;
+            best_begin[n] = 0;
+            best_size[n] = domains_size[n];
+            best_total[n] = 0;
+        }
+
+        // matched query neighbours of each node, used by the induced check
+        int *o_matched = arena->zalloc<int>(nof_sn);
+        int *i_matched = arena->zalloc<int>(nof_sn);
+
+        int *image = arena->alloc<int>(nof_sn); // indexed by node_id
+        for (int n = 0; n < nof_sn; n++)
+            image[n] = -1;
+        bool *selected = arena->zalloc<bool>(nof_sn);
+
+        // every assignment changes at most one run per query arc
+        int trail_capacity = 2 * nof_edges + 1;
+        int *trail_node = arena->alloc<int>(trail_capacity);
+        int **trail_runs = arena->alloc<int *>(trail_capacity);
+        int *trail_begin = arena->alloc<int>(trail_capacity);
+        int *trail_size = arena->alloc<int>(trail_capacity);
+        int *trail_total = arena->alloc<int>(trail_capacity);
+        int trail_top = 0;
+
+        int *order = arena->alloc<int>(nof_sn);    // indexed by depth
+        int *solution = arena->alloc<int>(nof_sn); // indexed by depth
+        int *trail_mark = arena->alloc<int>(nof_sn);
+        int **it_runs = arena->alloc<int *>(nof_sn);
+        int *it_pos = arena->alloc<int>(nof_sn);
+        int *it_end = arena->alloc<int>(nof_sn);
+        int *it_total = arena->alloc<int>(nof_sn);
+
+        bool *matched = alloc_matched(); // indexed by node_id
+
+        // symmetry breaking conditions of the mama on node ids, on both nodes of each pair
+        int *sym_sizes = arena->zalloc<int>(nof_sn);
+        MaMaSymmetry **sym_conds = arena->alloc<MaMaSymmetry *>(nof_sn);
+        for (int si = 0; si < nof_sn; si++) {
+            sym_sizes[mama.map_state_to_node[si]] += mama.sym_sizes[si];
+            for (int k = 0; k < mama.sym_sizes[si]; k++)
+                sym_sizes[mama.map_state_to_node[mama.sym_conds[si][k].state]]++;
+        }
+        for (int m = 0; m < nof_sn; m++) {
+            sym_conds[m] = arena->alloc<MaMaSymmetry>(sym_sizes[m]);
+            sym_sizes[m] = 0;
+        }
+        for (int si = 0; si < nof_sn; si++) {
+            for (int k = 0; k < mama.sym_sizes[si]; k++) {
+                int a = mama.map_state_to_node[si];
+                int b = mama.map_state_to_node[mama.sym_conds[si][k].state];
+                MaMaSymmetry &ca = sym_conds[a][sym_sizes[a]++];
+                MaMaSymmetry &cb = sym_conds[b][sym_sizes[b]++];
+                ca.state = b;
+                ca.lower = mama.sym_conds[si][k].lower;
+                cb.state = a;
+                cb.lower = !mama.sym_conds[si][k].lower;
+            }
+        }
+
+        int d = 0;
+        bool back = false;
+        bool select = true;
+        while (d >= 0) {
+
+            if (select) {
+                // fail-first: fewest candidates, then most matched neighbours
+                int n = -1;
+                for (int m = 0; m < nof_sn; m++) {
+                    if (!selected[m]) {
+                        if ((n == -1) || (best_size[m] < best_size[n]) || ((best_size[m] == best_size[n]) && (o_matched[m] + i_matched[m] > o_matched[n] + i_matched[n])))
+                            n = m;
+                    }
+                }
+                selected[n] = true;
+                order[d] = n;
+                if (best_runs[n] == NULL) {
+                    it_runs[d] = f_domains[n];
+                    it_pos[d] = 0;
+                    it_end[d] = domains_size[n];
+                    it_total[d] = 0;
+                } else {
+                    it_runs[d] = best_runs[n];
+                    it_pos[d] = best_begin[n];
+                    it_end[d] = best_begin[n] + best_size[n];
+                    it_total[d] = best_total[n];
+                }
+                select = false;
+            }
+
+            int n = order[d];
+
+            if (back) {
+                // undo the assignment of depth d
+                for (int k = 0; k < qgraph.out_adj_sizes[n]; k++) {
+                    if (qgraph.out_adj_list[n][k] != n)
+                        i_matched[qgraph.out_adj_list[n][k]]--;
+                }
+                for (int k = 0; k < qgraph.in_adj_sizes[n]; k++) {
+                    if (qgraph.in_adj_list[n][k] != n)
+                        o_matched[qgraph.in_adj_list[n][k]]--;
+                }
+                while (trail_top > trail_mark[d]) {
+                    trail_top--;
+                    int m = trail_node[trail_top];
+                    best_runs[m] = trail_runs[trail_top];
+                    best_begin[m] = trail_begin[trail_top];
+                    best_size[m] = trail_size[trail_top];
+                    best_total[m] = trail_total[trail_top];
+                }
+                set_matched(matched, solution[d], false);
+                image[n] = -1;
+                back = false;
+            }
+
+            int CandidateIndex = -1;
+            while (it_pos[d] < it_end[d]) {
+                int ci = it_runs[d][it_pos[d] + it_total[d]];
+                it_pos[d]++;
+
+                if (matched[ci] || !domains[n].get(ci))
+                    continue;
+
+                bool checked = true;
+                for (int k = 0; checked && k < qgraph.out_adj_sizes[n]; k++) {
+                    int m = qgraph.out_adj_list[n][k];
+                    int mi = (m == n) ? ci : image[m];
+                    if ((mi != -1) && (edomains.domains[edomains.pattern_out_adj_eids[n][k]].count(std::pair<int, int>(ci, mi)) == 0))
+                        checked = false;
+                }
+                for (int k = 0; checked && k < qgraph.in_adj_sizes[n]; k++) {
+                    int m = qgraph.in_adj_list[n][k];
+                    if ((m != n) && (image[m] != -1) && (edomains.domains[edomains.pattern_in_adj_eids[n][k]].count(std::pair<int, int>(image[m], ci)) == 0))
+                        checked = false;
+                }
+                for (int k = 0; checked && k < sym_sizes[n]; k++) {
+                    int mi = image[sym_conds[n][k].state];
+                    if ((mi != -1) && (sym_conds[n][k].lower ? (ci > mi) : (ci < mi)))
+                        checked = false;
+                }
+                if (checked && countsCheck(ci, o_matched[n], i_matched[n], matched)) {
+                    CandidateIndex = ci;
+                    break;
+                }
+            }
+
+            if (CandidateIndex == -1) {
+                selected[n] = false;
+                d--;
+                back = true;
+                continue;
+            }
+
+            matchedcouples++;
+            if (out_of_time())
+                break;
+            solution[d] = CandidateIndex;
+
+            if (d == nof_sn - 1) {
+                if (matchListener.wants_matches)
+                    matchListener.match(nof_sn, order, solution);
+                matchcount++;
+
+                if (match_limit > 0 && matchcount >= match_limit)
+                    break;
+                continue;
+            }
+
+            // assign and shorten the runs of the unselected neighbours
+            image[n] = CandidateIndex;
+            set_matched(matched, CandidateIndex, true);
+            trail_mark[d] = trail_top;
+            for (int dir = 0; dir < 2; dir++) {
+                int size = (dir == 0) ? qgraph.out_adj_sizes[n] : qgraph.in_adj_sizes[n];
+                for (int k = 0; k < size; k++) {
+                    int m, eid;
+                    int **runs;
+                    if (dir == 0) {
+                        m = qgraph.out_adj_list[n][k];
+                        eid = edomains.pattern_out_adj_eids[n][k];
+                        runs = s_runs;
+                        if (m != n)
+                            i_matched[m]++;
+                    } else {
+                        m = qgraph.in_adj_list[n][k];
+                        eid = edomains.pattern_in_adj_eids[n][k];
+                        runs = t_runs;
+                        if (m != n)
+                            o_matched[m]++;
+                    }
+                    if ((m == n) || selected[m])
+                        continue;
+
+                    int total = runs_sizes[eid];
+                    int *first = std::lower_bound(runs[eid], runs[eid] + total, CandidateIndex);
+                    int *last = std::upper_bound(first, runs[eid] + total, CandidateIndex);
+                    if (last - first < best_size[m]) {
+                        trail_node[trail_top] = m;
+                        trail_runs[trail_top] = best_runs[m];
+                        trail_begin[trail_top] = best_begin[m];
+                        trail_size[trail_top] = best_size[m];
+                        trail_total[trail_top] = best_total[m];
+                        trail_top++;
+
+                        best_runs[m] = runs[eid];
+                        best_begin[m] = (int)(first - runs[eid]);
+                        best_size[m] = (int)(last - first);
+                        best_total[m] = total;
+                    }
+                }
+            }
+            d++;
+            select = true;
+        }
+    };
+
+    /*
+     * Monomorphisms with the last mama.nof_leafs states as trees hanging from the
+     * core (see MaMaConstrFirstNodeSetsTrees.h). A tree whose domains share no
+     * element with any other node is counted bottom-up over the edge domains, for
+     * each image of its nodes, and each match of the core is weighted by the
+     * counts of its trees. The other trees could use the images of the core or of
+     * each other: for each match of the core they are searched as the parts of
+     * SolveComponents, the trees sharing domain elements are combined by inclusion
+     * exclusion over their collisions (see DisjointFamilies.h).
+     * Falls back to solve_rp if the matches must be reported.
+     */
+    template <bool Backjump, bool Forward, bool Cache, bool KeepNeighs>
+    void SolveTrees() {
+        int nof_sn = mama.nof_sn;
+        int nof_core = nof_sn - mama.nof_leafs;
+
+        if (matchListener.wants_matches || mama.nof_leafs == 0) {
+            solve_rp<Backjump, Forward, Cache, KeepNeighs>();
+            return;
+        }
+
+        // each tree is numbered by the state of its root
+        std::vector<int> tree(nof_sn, -1);
+        for (int si = nof_core; si < nof_sn; si++) {
+            int ps = tree_parent(si);
+            tree[si] = (ps < nof_core) ? si : tree[ps];
+        }
+        std::vector<bool> counted(nof_sn, true);
+        countable_trees(nof_core, tree, counted);
+
+        // subtree counts of each tree state for each image of its node
+        long **counts = arena->alloc<long *>(nof_sn);
+        for (int si = nof_core; si < nof_sn; si++) {
+            if (!counted[tree[si]])
+                continue;
+            int n = mama.map_state_to_node[si];
+            counts[si] = arena->zalloc<long>(rgraph.nof_nodes);
+            for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones())
+                counts[si][IT.first] = 1;
+        }
+
+        // children are after their parent, each tree state sums its counts for each image of the parent
+        long **sums = arena->alloc<long *>(nof_sn);
+        int *att_sizes = arena->zalloc<int>(nof_sn);
+        for (int si = nof_sn - 1; si >= nof_core; si--) {
+            if (!counted[tree[si]])
+                continue;
+            long *sum = arena->zalloc<long>(rgraph.nof_nodes);
+            MaMaEdge &pe = mama.edges[si][0];
+            int ps = tree_parent(si);
+            unordered_edge_set *eset = &(edomains.domains[pe.id]);
+            for (unordered_edge_set::iterator eit = eset->begin(); eit != eset->end(); eit++) {
+                int ci = (pe.source == si) ? eit->first : eit->second;
+                int pi = (pe.source == si) ? eit->second : eit->first;
+                if (counts[si][ci] == 0)
+                    continue;
+                // the other arcs with the parent
+                bool checked = true;
+                for (int me = 1; checked && me < mama.edges_sizes[si]; me++) {
+                    MaMaEdge &e = mama.edges[si][me];
+                    std::pair<int, int> arc = (e.source == si) ? std::pair<int, int>(ci, pi) : std::pair<int, int>(pi, ci);
+                    checked = edomains.domains[e.id].count(arc) > 0;
+                }
+                if (checked)
+                    sum[pi] += counts[si][ci];
+            }
+            sums[si] = sum;
+
+            if (ps >= nof_core) {
+                int pn = mama.map_state_to_node[ps];
+                for (sbitset::iterator IT = domains[pn].first_ones(); IT != domains[pn].end(); IT.next_ones())
+                    counts[ps][IT.first] *= sum[IT.first];
+            } else {
+                att_sizes[ps]++;
+            }
+        }
+
+        long ***att_counts = arena->alloc<long **>(nof_core);
+        for (int si = 0; si < nof_core; si++) {
+            att_counts[si] = arena->alloc<long *>(att_sizes[si]);
+            att_sizes[si] = 0;
+        }
+        for (int si = nof_core; si < nof_sn; si++) {
+            int ps = tree_parent(si);
+            if (counted[tree[si]] && ps < nof_core)
+                att_counts[ps][att_sizes[ps]++] = sums[si];
+        }
+
+        // the other trees are the parts of the units searched for each match of the core
+        std::vector<int> part(nof_sn, -1), part_of_tree(nof_sn, -1);
+        int nof_parts = 0;
+        for (int si = nof_core; si < nof_sn; si++) {
+            if (counted[tree[si]])
+                continue;
+            if (part_of_tree[tree[si]] == -1)
+                part_of_tree[tree[si]] = nof_parts++;
+            part[si] = part_of_tree[tree[si]];
+        }
+        std::vector<std::vector<std::vector<int> > > units;
+        group_parts(nof_core, part, nof_parts, units);
+
+        solve_rp<Backjump, Forward, Cache, KeepNeighs>(nof_core, att_sizes, att_counts, units.empty() ? NULL : &units);
     };
 
+    // monomorphisms counted by components: the first states of the mama after which the unmatched
+    // states fall apart are matched as usual, then each component is counted on its own and the
+    // counts are multiplied. components whose domains overlap could use the same reference nodes,
+    // up to DisjointFamilies::MAX_FAMILIES of them are combined by inclusion exclusion, more are
+    // searched together
+    template <bool Backjump, bool Forward, bool Cache, bool KeepNeighs>
+    void SolveComponents() {
+        int nof_sn = mama.nof_sn;
+
+        std::vector<int> component(nof_sn, -1);
+        int split = -1, nof_components = 0;
+        for (int p = 0; p < nof_sn - 1 && split == -1; p++) {
+            nof_components = split_components(p, component);
+            if (nof_components > 1)
+                split = p;
+        }
+        if (matchListener.wants_matches || split == -1) {
+            solve_rp<Backjump, Forward, Cache, KeepNeighs>();
+            return;
+        }
+
+        std::vector<std::vector<std::vector<int> > > units;
+        group_parts(split, component, nof_components, units);
+
+        std::vector<int> prefix;
+        for (int si = 0; si < split; si++)
+            prefix.push_back(si);
+
+        int *solution = arena->alloc<int>(nof_sn); // indexed by state_id
+        for (int i = 0; i < nof_sn; i++)
+            solution[i] = -1;
+        bool *matched = alloc_matched(); // indexed by node_id
+
+        DisjointFamilies families;
+        matchcount = 0;
+        count_prefix(prefix, 0, units, families, solution, matched);
+    };
+
+    template <bool KeepNeighs>
     void SolveLeafs()
     {
 
@@ -677,15 +1324,17 @@ class Solver {
 
         using ordered_edge_set = std::set<std::pair<int, int>>;
 
+#ifdef MDEBUG
         std::cout << "ORDERED EDGE SETS...\n";
+#endif
 
-        auto ordered_edge_domains = new int*[edomains.nof_pattern_edges];
-        auto ordered_edge_domains_sizes = new int[edomains.nof_pattern_edges];
+        auto ordered_edge_domains = arena->alloc<int *>(edomains.nof_pattern_edges);
+        auto ordered_edge_domains_sizes = arena->alloc<int>(edomains.nof_pattern_edges);
 
         for (int eid = 0; eid < edomains.nof_pattern_edges; eid++)
         {
             unordered_edge_set* eset = &(edomains.domains[eid]);
-            ordered_edge_domains[eid] = new int[eset->size() * 2];
+            ordered_edge_domains[eid] = arena->alloc<int>(eset->size() * 2);
             ordered_edge_domains_sizes[eid] = eset->size();
         }
         
@@ -747,15 +1396,17 @@ class Solver {
             }
         }
 
+#ifdef MDEBUG
         std::cout << "ORDERED EDGE SETS: done\n";
+#endif
 
-        auto f_domains = new int*[NumOfQueryVertex];
+        auto f_domains = arena->alloc<int *>(NumOfQueryVertex);
         for (int si = 0; si < NumOfQueryVertex; si++)
         {
             if (mama.edges_sizes[si] == 0)
             {
                 int n = map_state_to_node[si];
-                f_domains[si] = new int[domains_size[n]];
+                f_domains[si] = arena->alloc<int>(domains_size[n]);
                 int k = 0;
                 for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones())
                 {
@@ -765,25 +1416,25 @@ class Solver {
             }
         }
 
-        auto candidateIT = new int[NumOfQueryVertex];
+        auto candidateIT = arena->alloc<int>(NumOfQueryVertex);
 
-        auto candidateITeid = new int[NumOfQueryVertex];
-        auto candidateITpnode = new int[NumOfQueryVertex];
-        auto candidateITpstate = new int[NumOfQueryVertex];
-        auto candidateITsize = new int[NumOfQueryVertex];
+        auto candidateITeid = arena->alloc<int>(NumOfQueryVertex);
+        auto candidateITpnode = arena->alloc<int>(NumOfQueryVertex);
+        auto candidateITpstate = arena->alloc<int>(NumOfQueryVertex);
+        auto candidateITsize = arena->alloc<int>(NumOfQueryVertex);
 
         for (int i = 0; i < NumOfQueryVertex; i++)
         {
             candidateIT[i] = -1;
         }
 
-        auto solution = new int[NumOfQueryVertex]; // indexed by state_id
+        auto solution = arena->alloc<int>(NumOfQueryVertex); // indexed by state_id
         for (int i = 0; i < NumOfQueryVertex; i++)
         {
             solution[i] = -1;
         }
 
-        auto matched = (bool*)calloc(rgraph.nof_nodes, sizeof(bool)); // indexed by node_id
+        auto matched = alloc_matched(); // indexed by node_id
 
         int psi = -1;
         int StateIndex = 0;
@@ -840,7 +1491,16 @@ class Solver {
                             if (!matched[ordered_edge_domains[candidateITeid[StateIndex + l]][candidateIT[StateIndex + l] + candidateITsize[StateIndex + l]]])
                             {
                                 CandidateIndex = ordered_edge_domains[candidateITeid[StateIndex + l]][candidateIT[StateIndex + l] + candidateITsize[StateIndex + l]];
-                                leaf_domains[l].insert(CandidateIndex);
+                                // the other arcs with the parent, e.g. the reciprocal one of a directed leaf
+                                bool checked = true;
+                                for (int me = 1; checked && me < mama.edges_sizes[StateIndex + l]; me++)
+                                {
+                                    MaMaEdge &e = mama.edges[StateIndex + l][me];
+                                    std::pair<int, int> arc = (e.source == StateIndex + l) ? std::pair<int, int>(CandidateIndex, pnode) : std::pair<int, int>(pnode, CandidateIndex);
+                                    checked = edomains.domains[e.id].count(arc) > 0;
+                                }
+                                if (checked)
+                                    leaf_domains[l].insert(CandidateIndex);
                             }
                         }
                         else
@@ -855,30 +1515,23 @@ class Solver {
 
                 matchcount += nof_leaf_solutions;
 
-#ifdef PRINT_MATCHES
-                matchListener.match_multiple(NumOfQueryVertex, map_state_to_node, solution, StateIndex, leaf_domains);
-#endif
+                if (matchListener.wants_matches)
+                    matchListener.match_multiple(NumOfQueryVertex, map_state_to_node, solution, StateIndex, leaf_domains);
 
                 delete[] leaf_domains;
 
                 psi = StateIndex;
                 StateIndex--;
 
-#ifdef FIRST_MATCH_ONLY
-                StateIndex = -1;
-                //					return IF U WANT JUST AN INSTANCE
-#endif
-#ifdef FIRST_100k_MATCHES
-                if (matchcount >= 100000)
+                if (match_limit > 0 && matchcount >= match_limit)
                     StateIndex = -1;
-#endif
             }
             else
             {
 
                 if (psi >= StateIndex)
                 {
-                    matched[solution[StateIndex]] = false;
+                    set_matched<KeepNeighs>(matched, solution[StateIndex], false);
                 }
 
                 CandidateIndex = -1;
@@ -970,7 +1623,7 @@ class Solver {
                             CandidateIndex = f_domains[StateIndex][candidateIT[StateIndex]];
 
                             solution[StateIndex] = CandidateIndex;
-                            if (edgesCheck(StateIndex, CandidateIndex, solution, matched))
+                            if (edgesCheck(StateIndex, CandidateIndex, solution, matched) && symmetryCheck(StateIndex, CandidateIndex, solution))
                             {
                                 break;
                             }
@@ -1018,7 +1671,7 @@ class Solver {
                                     }
                                     if (checked)
                                     {
-                                        checked &= edgesCheck(StateIndex, CandidateIndex, solution, matched);
+                                        checked &= edgesCheck(StateIndex, CandidateIndex, solution, matched) && symmetryCheck(StateIndex, CandidateIndex, solution);
                                     }
 
                                     if (checked)
@@ -1030,10 +1683,14 @@ class Solver {
                                         CandidateIndex = -1;
                                     }
                                 }
-                                else
+                                else if (symmetryCheck(StateIndex, CandidateIndex, solution))
                                 {
                                     break;
                                 }
+                                else
+                                {
+                                    CandidateIndex = -1;
+                                }
 
                             }
 #ifdef SOLVER_H_MDEBUG
@@ -1077,28 +1734,26 @@ class Solver {
                 {
                     //Hyaniner:matched pair found.
                     matchedcouples++;
+                    if (out_of_time()) {
+                        StateIndex = -1;
+                        continue;
+                    }
 
                     if (StateIndex == NumOfQueryVertex - 1)
                     {
                         // there are no leafs
-#ifdef PRINT_MATCHES
-                        matchListener.match(NumOfQueryVertex, map_state_to_node, solution);
-#endif
+                        if (matchListener.wants_matches)
+                            matchListener.match(NumOfQueryVertex, map_state_to_node, solution);
                         matchcount++;
                         psi = StateIndex;
 
-#ifdef FIRST_MATCH_ONLY
-                        StateIndex = -1;
-#endif
-#ifdef FIRST_100k_MATCHES
-                        if (matchcount >= 100000)
+                        if (match_limit > 0 && matchcount >= match_limit)
                             StateIndex = -1;
-#endif
 
                     }
                     else
                     {
-                        matched[solution[StateIndex]] = true;
+                        set_matched<KeepNeighs>(matched, solution[StateIndex], true);
                         StateIndexPlusOne = StateIndex + 1;
                         psi = StateIndex;
                         StateIndex++;
@@ -1109,6 +1764,389 @@ class Solver {
     };
 
     virtual bool edgesCheck(int si, int ci, int *solution, bool *matched) = 0;
+
+    // the trees attached to state si have an image for the candidate ci
+    bool treesCheck(int si, int ci, int *att_sizes, long ***att_counts) {
+        for (int a = 0; att_sizes != NULL && a < att_sizes[si]; a++) {
+            if (att_counts[si][a][ci] == 0)
+                return false;
+        }
+        return true;
+    }
+
+    // the earlier state of a tree state, -1 if it has none
+    int tree_parent(int si) {
+        if (mama.edges_sizes[si] == 0)
+            return -1;
+        MaMaEdge &pe = mama.edges[si][0];
+        return (pe.source == si) ? pe.target : pe.source;
+    }
+
+    // a tree is counted over the edge domains if its states are linked to a single earlier state, their
+    // domains are not shared and they have no self loops, so their images are never used by another node.
+    // counted is indexed by the tree of each state
+    void countable_trees(int nof_core, std::vector<int> &tree, std::vector<bool> &counted) {
+        std::vector<int> owners(rgraph.nof_nodes, 0);
+        for (int n = 0; n < qgraph.nof_nodes; n++) {
+            for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones())
+                owners[IT.first]++;
+        }
+        for (int si = nof_core; si < mama.nof_sn; si++) {
+            int n = mama.map_state_to_node[si];
+            int ps = tree_parent(si);
+            bool countable = (ps != -1);
+            for (int me = 1; countable && me < mama.edges_sizes[si]; me++) {
+                MaMaEdge &e = mama.edges[si][me];
+                countable = ((e.source == si) ? e.target : e.source) == ps;
+            }
+            for (int k = 0; countable && k < qgraph.out_adj_sizes[n]; k++)
+                countable = qgraph.out_adj_list[n][k] != n;
+            for (sbitset::iterator IT = domains[n].first_ones(); countable && IT != domains[n].end(); IT.next_ones())
+                countable = owners[IT.first] == 1;
+            if (!countable)
+                counted[tree[si]] = false;
+        }
+    }
+
+    // parts whose domains share elements are joined in a unit, a unit with too many parts for the inclusion
+    // exclusion is a single part. part is indexed by state_id, -1 for the states from first on out of any part
+    void group_parts(int first, std::vector<int> &part, int nof_parts, std::vector<std::vector<std::vector<int> > > &units) {
+        int nof_sn = mama.nof_sn;
+        std::vector<int> unit(nof_parts);
+        for (int c = 0; c < nof_parts; c++)
+            unit[c] = c;
+        std::vector<int> owner(rgraph.nof_nodes, -1);
+        for (int si = first; si < nof_sn; si++) {
+            if (part[si] == -1)
+                continue;
+            int n = mama.map_state_to_node[si];
+            for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones()) {
+                if (owner[IT.first] == -1) {
+                    owner[IT.first] = part[si];
+                } else {
+                    int a = find_unit(unit, owner[IT.first]);
+                    int b = find_unit(unit, part[si]);
+                    if (a != b)
+                        unit[std::max(a, b)] = std::min(a, b);
+                }
+            }
+        }
+
+        // states of the parts of each unit in mama order
+        std::vector<int> unit_id(nof_parts, -1), part_id(nof_parts, -1);
+        for (int c = 0; c < nof_parts; c++) {
+            int u = find_unit(unit, c);
+            if (unit_id[u] == -1) {
+                unit_id[u] = units.size();
+                units.push_back(std::vector<std::vector<int> >());
+            }
+            part_id[c] = units[unit_id[u]].size();
+            units[unit_id[u]].push_back(std::vector<int>());
+        }
+        for (int si = first; si < nof_sn; si++) {
+            int c = part[si];
+            if (c != -1)
+                units[unit_id[find_unit(unit, c)]][part_id[c]].push_back(si);
+        }
+        for (size_t u = 0; u < units.size(); u++) {
+            if (units[u].size() > (size_t)DisjointFamilies::MAX_FAMILIES) {
+                std::vector<int> states;
+                for (size_t q = 0; q < units[u].size(); q++)
+                    states.insert(states.end(), units[u][q].begin(), units[u][q].end());
+                std::sort(states.begin(), states.end());
+                units[u].assign(1, states);
+            }
+        }
+    }
+
+    // components of the states from p on, joined by the arcs between them, returns their number
+    int split_components(int p, std::vector<int> &component) {
+        int nof_sn = mama.nof_sn;
+        std::vector<int> parent(nof_sn);
+        for (int si = 0; si < nof_sn; si++)
+            parent[si] = si;
+        for (int si = p; si < nof_sn; si++) {
+            for (int me = 0; me < mama.edges_sizes[si]; me++) {
+                MaMaEdge &e = mama.edges[si][me];
+                int o = (e.source == si) ? e.target : e.source;
+                if (o >= p) {
+                    int a = find_unit(parent, o);
+                    int b = find_unit(parent, si);
+                    if (a != b)
+                        parent[std::max(a, b)] = std::min(a, b);
+                }
+            }
+        }
+        int nof_components = 0;
+        for (int si = p; si < nof_sn; si++) {
+            int r = find_unit(parent, si);
+            component[si] = (r == si) ? nof_components++ : component[r];
+        }
+        return nof_components;
+    }
+
+    int find_unit(std::vector<int> &parent, int n) {
+        while (parent[n] != n) {
+            parent[n] = parent[parent[n]];
+            n = parent[n];
+        }
+        return n;
+    }
+
+    // each match of the states before the split adds the product of the counts of the units
+    void count_prefix(std::vector<int> &prefix, size_t k, std::vector<std::vector<std::vector<int> > > &units, DisjointFamilies &families,
+                      int *solution, bool *matched) {
+        if (match_limit > 0 && matchcount >= match_limit)
+            return;
+        if (k < prefix.size()) {
+            extend_states(prefix, k, solution, matched, &units, &families, NULL);
+            return;
+        }
+        matchcount += count_units(units, families, solution, matched);
+    }
+
+    // product of the counts of the units, under the states already matched
+    long count_units(std::vector<std::vector<std::vector<int> > > &units, DisjointFamilies &families, int *solution, bool *matched) {
+        long product = 1;
+        for (size_t u = 0; u < units.size() && product != 0; u++) {
+            std::vector<std::vector<int> > &parts = units[u];
+            if (parts.size() == 1) {
+                product *= count_states(parts[0], 0, solution, matched, NULL);
+            } else {
+                families.reset(parts.size());
+                for (size_t q = 0; q < parts.size(); q++)
+                    count_states(parts[q], 0, solution, matched, &families.family(q, parts[q].size()));
+                product *= families.count();
+            }
+        }
+        return product;
+    }
+
+    // matches of the states of a part after the already matched ones, appended to found if not NULL
+    long count_states(std::vector<int> &states, size_t k, int *solution, bool *matched, std::vector<int> *found) {
+        if (k == states.size()) {
+            for (size_t i = 0; found != NULL && i < states.size(); i++)
+                found->push_back(solution[states[i]]);
+            return 1;
+        }
+        return extend_states(states, k, solution, matched, NULL, NULL, found);
+    }
+
+    // candidates of the k-th state, by the arcs of the image of its first earlier neighbour or by its domain.
+    // the states are the ones before the split if units is not NULL, the ones of a part otherwise
+    long extend_states(std::vector<int> &states, size_t k, int *solution, bool *matched, std::vector<std::vector<std::vector<int> > > *units,
+                       DisjointFamilies *families, std::vector<int> *found) {
+        int si = states[k];
+        int n = mama.map_state_to_node[si];
+        long total = 0;
+        steps++;
+
+        std::vector<int> candidates;
+        if (mama.edges_sizes[si] == 0) {
+            for (sbitset::iterator IT = domains[n].first_ones(); IT != domains[n].end(); IT.next_ones())
+                candidates.push_back(IT.first);
+        } else {
+            MaMaEdge &pe = mama.edges[si][0];
+            int pi = solution[(pe.source == si) ? pe.target : pe.source];
+            int *adj = (pe.source == si) ? rgraph.in_adj_list[pi] : rgraph.out_adj_list[pi];
+            int adj_size = (pe.source == si) ? rgraph.in_adj_sizes[pi] : rgraph.out_adj_sizes[pi];
+            // parallel arcs give the same candidate
+            candidates.assign(adj, adj + adj_size);
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        }
+
+        for (size_t c = 0; c < candidates.size(); c++) {
+            int ci = candidates[c];
+            triedcouples++;
+            if (matched[ci] || !domains[n].get(ci))
+                continue;
+            solution[si] = ci;
+            bool checked = true;
+            for (int me = 0; checked && me < mama.edges_sizes[si]; me++) {
+                MaMaEdge &e = mama.edges[si][me];
+                checked = edomains.domains[e.id].count(std::pair<int, int>(solution[e.source], solution[e.target])) > 0;
+            }
+            if (!checked || !edgesCheck(si, ci, solution, matched) || !symmetryCheck(si, ci, solution))
+                continue;
+            matchedcouples++;
+            set_matched(matched, ci, true);
+            if (units != NULL) {
+                count_prefix(states, k + 1, *units, *families, solution, matched);
+            } else {
+                total += count_states(states, k + 1, solution, matched, found);
+            }
+            set_matched(matched, ci, false);
+            if ((match_limit > 0 && matchcount >= match_limit) || out_of_time())
+                break;
+        }
+        solution[si] = -1;
+        return total;
+    }
+
+    // arcs from each state of the first nof_core to the later ones, with the support of the candidates
+    // of the states with several arcs when the scratch fits (about 256 MB)
+    void init_forward(ForwardCounts &fc, int nof_core, int **runs, int *runs_sizes, cand_ecount_t &positions, cand_ecount_t &counter) {
+        int nof_sn = mama.nof_sn;
+        fc.sizes = arena->zalloc<int>(nof_sn);
+        fc.targets = arena->alloc<int *>(nof_sn);
+        fc.eids = arena->alloc<int *>(nof_sn);
+        fc.trail = arena->alloc<int *>(nof_sn);
+        fc.applied = arena->zalloc<bool>(nof_sn);
+        fc.counts = arena->zalloc<int>(nof_sn);
+        fc.nof_assigned = arena->zalloc<int>(nof_sn);
+        fc.support = arena->alloc<int *>(nof_sn);
+        fc.runs = runs;
+        fc.runs_sizes = runs_sizes;
+        fc.positions = &positions;
+        fc.counter = &counter;
+
+        long nof_supported = 0;
+        for (int t = 1; t < nof_core; t++) {
+            for (int me = 0; me < mama.edges_sizes[t]; me++)
+                fc.sizes[(mama.edges[t][me].source == t) ? mama.edges[t][me].target : mama.edges[t][me].source]++;
+            if (mama.edges_sizes[t] > 1)
+                nof_supported += rgraph.nof_nodes;
+        }
+        for (int s = 0; s < nof_sn; s++) {
+            fc.targets[s] = arena->alloc<int>(fc.sizes[s]);
+            fc.eids[s] = arena->alloc<int>(fc.sizes[s]);
+            fc.trail[s] = arena->alloc<int>(fc.sizes[s]);
+            fc.sizes[s] = 0;
+        }
+        for (int t = 1; t < nof_core; t++) {
+            for (int me = 0; me < mama.edges_sizes[t]; me++) {
+                int s = (mama.edges[t][me].source == t) ? mama.edges[t][me].target : mama.edges[t][me].source;
+                fc.targets[s][fc.sizes[s]] = t;
+                fc.eids[s][fc.sizes[s]] = mama.edges[t][me].id;
+                fc.sizes[s]++;
+            }
+        }
+        // the candidates of a state with a single arc are its run
+        bool supported = nof_supported <= (1L << 26);
+        for (int t = 0; t < nof_sn; t++)
+            fc.support[t] = (supported && t < nof_core && mama.edges_sizes[t] > 1) ? arena->zalloc<int>(rgraph.nof_nodes) : NULL;
+    }
+
+    // candidates of the later neighbours of si for its candidate ci: with the support of each node, a node
+    // is still a candidate if all the arcs of the assigned neighbours allow it, otherwise only the run of
+    // the arc is checked. a later state without candidates rejects ci
+    template <bool Forward>
+    bool forwardCheck(ForwardCounts &fc, int si, int ci, unsigned long *failing, unsigned long *reasons, int fwords) {
+        if (!Forward)
+            return true;
+        for (int k = 0; k < fc.sizes[si]; k++) {
+            int t = fc.targets[si][k];
+            int eid = fc.eids[si][k];
+            cand_ecount_t::iterator cit = fc.counter->find(std::make_pair(ci, eid));
+            int count = (cit == fc.counter->end()) ? 0 : cit->second;
+            fc.trail[si][k] = fc.counts[t];
+            if (count > 0 && fc.support[t] != NULL) {
+                int *run = fc.runs[eid] + (*fc.positions)[std::make_pair(ci, eid)];
+                int *run_images = run + fc.runs_sizes[eid];
+                count = 0;
+                for (int r = 0; r < cit->second; r++) {
+                    if (++fc.support[t][run_images[r]] == fc.nof_assigned[t] + 1)
+                        count++;
+                }
+                fc.nof_assigned[t]++;
+            }
+            fc.counts[t] = count;
+            if (count == 0) {
+                if (failing != NULL) {
+                    for (int w = 0; w < fwords; w++)
+                        failing[si * fwords + w] |= reasons[t * fwords + w];
+                }
+                undo_forward(fc, si, k + 1, ci);
+                return false;
+            }
+        }
+        fc.applied[si] = true;
+        return true;
+    }
+
+    // restores the counts of the first size arcs of si, in reverse order
+    void undo_forward(ForwardCounts &fc, int si, int size, int ci) {
+        for (int k = size - 1; k >= 0; k--) {
+            int t = fc.targets[si][k];
+            int eid = fc.eids[si][k];
+            if (fc.support[t] != NULL) {
+                cand_ecount_t::iterator cit = fc.counter->find(std::make_pair(ci, eid));
+                if (cit != fc.counter->end()) {
+                    int *run_images = fc.runs[eid] + (*fc.positions)[std::make_pair(ci, eid)] + fc.runs_sizes[eid];
+                    for (int r = 0; r < cit->second; r++)
+                        fc.support[t][run_images[r]]--;
+                    fc.nof_assigned[t]--;
+                }
+            }
+            fc.counts[t] = fc.trail[si][k];
+        }
+        fc.applied[si] = false;
+    }
+
+    // logs a node whose matched flag is read, see the cache of solve_rp
+    static void touch(std::vector<int> &touched, size_t cap, int &generation, int node) {
+        if (touched.size() >= cap) {
+            touched.clear();
+            generation++;
+        }
+        touched.push_back(node);
+    }
+
+    // matched flags of the reference nodes, with the neighbour counts if they are kept
+    // the deadline is over, the search stops with partial counts
+    bool out_of_time() { return deadline != NULL && deadline->over(); }
+
+    bool *alloc_matched() {
+        o_matched_neighs = keep_neighs ? arena->zalloc<int>(rgraph.nof_nodes) : NULL;
+        i_matched_neighs = keep_neighs ? arena->zalloc<int>(rgraph.nof_nodes) : NULL;
+        return arena->zalloc<bool>(rgraph.nof_nodes);
+    }
+
+    // the solvers also clear the flag of the last state, which was never set
+    template <bool KeepNeighs>
+    void set_matched(bool *matched, int ci, bool value) {
+        if (!KeepNeighs) {
+            matched[ci] = value;
+            return;
+        }
+        if (matched[ci] == value)
+            return;
+        matched[ci] = value;
+        int d = value ? 1 : -1;
+        for (int ii = 0; ii < rgraph.in_adj_sizes[ci]; ii++)
+            o_matched_neighs[rgraph.in_adj_list[ci][ii]] += d;
+        for (int ii = 0; ii < rgraph.out_adj_sizes[ci]; ii++)
+            i_matched_neighs[rgraph.out_adj_list[ci][ii]] += d;
+    }
+
+    // for the solvers which are not instantiated per option
+    void set_matched(bool *matched, int ci, bool value) {
+        if (keep_neighs)
+            set_matched<true>(matched, ci, value);
+        else
+            set_matched<false>(matched, ci, value);
+    }
+
+    static void set_bit(unsigned long *bits, int i) { bits[i / 64] |= 1UL << (i % 64); }
+
+    static bool get_bit(unsigned long *bits, int i) { return (bits[i / 64] >> (i % 64)) & 1UL; }
+
+    // symmetry breaking conditions of state si against the earlier states, see Automorphisms.h
+    bool symmetryCheck(int si, int ci, int *solution) {
+        for (int k = 0; k < mama.sym_sizes[si]; k++) {
+            MaMaSymmetry &cond = mama.sym_conds[si][k];
+            if (cond.lower ? (ci > solution[cond.state]) : (ci < solution[cond.state]))
+                return false;
+        }
+        return true;
+    }
+
+    // checks the matched reference neighbours of ci against the matched query neighbours
+    virtual bool countsCheck(int ci, int o_edges, int i_edges, bool *matched) = 0;
+
+    // adds to the failing set the states which edgesCheck looked at besides the neighbours of the state
+    virtual void edgesReasons(int ci, bool *matched, int *matched_state, unsigned long *failing) {}
 };
 
 } // namespace rilib
@@ -0,0 +1,239 @@
+/*
+ * Strategy.h
+ *
+ */
+/*
+Copyright (c) 2023
+
+This library contains portions of other open source products covered by separate
+licenses. Please see the corresponding source files for specific terms.
+
+ArcMatch is provided under the terms of The MIT License (MIT):
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#ifndef STRATEGY_H_
+#define STRATEGY_H_
+
+#include <string>
+
+#include "PreprocessorControl.h"
+
+namespace rilib {
+
+// matching machines, see the MaMa* headers
+enum MAMA_KIND {
+    MK_1,   // original order
+    MK_0,   // simple matching machine with edge weigths set to 1
+    MK_FC,  // centrality flooding
+    MK_AC,  // angular coefficient
+    MK_NS,  // original order with node sets for flags
+    MK_NSL, // node sets, with disjoint leafs at the end of the ordering
+    MK_CC,  // ordering by taking into account core compatibility
+    MK_CE,  // ordering by the estimated size of the search tree
+    MK_NST  // node sets, with the trees hanging from the core at the end of the ordering
+};
+
+// search methods of Solver
+enum SOLVER_KIND {
+    SK_0,  // simple solver with edge domains
+    SK_ED, // simple solver which exploits edge domains
+    SK_DP, // solver with dynamic parent selection
+    SK_LF, // solver with dynamic parent selection and leafs
+    SK_FF, // solver with dynamic fail-first node selection, ignores the order of the mama
+    SK_TD, // solver with dynamic parent selection and trees counted by dynamic programming, monomorphism only
+    SK_CS  // solver counting the components left by the first states separately, monomorphism only
+};
+
+// symmetries of the query, see Automorphisms.h
+enum SYMMETRY_MODE {
+    SY_OFF,     // every embedding is enumerated
+    SY_EMB,     // one embedding per orbit is enumerated, the counts are the ones of all the embeddings
+    SY_DISTINCT // one embedding per orbit is enumerated and counted, one match for each distinct subgraph
+};
+
+/*
+ * Stages and algorithms of the matching, chosen at run time.
+ * The defaults are the ones selected at compile time by the macros of
+ * PreprocessorControl.h, so existing builds keep their behaviour.
+ */
+struct Strategy {
+    MAMA_KIND mama;
+    SOLVER_KIND solver;
+    bool nlf;               // filter the node domains by the labels of the neighbours (see Domains.h)
+    bool node_d_conv;       // refine node domains until convergence
+    int neighbour_rounds;   // rounds of the neighbour dominance filter of the node domains, 0 to skip (see Domains.h)
+    bool edge_d_conv;       // refine edge domains until convergence, during the edge domain reduction
+    int reduce_path_length; // reduce edge domains by paths up to this length, 0 to skip the reduction
+    long match_limit;       // stop each reference graph after this many matches, 0 to find them all
+    bool auto_select;       // choose mama and solver for each reference graph by a cost estimate (see CostModel.h)
+    int probes;             // random probes per candidate order to choose the order by sampling (see MaMaSampled.h), 0 to skip
+    SYMMETRY_MODE symmetry; // break the symmetries of the query
+    bool backjump;          // jump back over the states which do not cause a failure (dp, td and the fallbacks to dp)
+    bool forward;           // check the candidates of the later neighbours after each assignment (dp, td and the fallbacks to dp)
+    int cache_mb;           // MB of subtree counts reused by the dp solver and the fallbacks to it, 0 for none (see NogoodCache.h)
+
+    Strategy() {
+#if defined(MAMA_1)
+        mama = MK_1;
+#elif defined(MAMA_0)
+        mama = MK_0;
+#elif defined(MAMA_FC)
+        mama = MK_FC;
+#elif defined(MAMA_AC)
+        mama = MK_AC;
+#elif defined(MAMA_NS)
+        mama = MK_NS;
+#elif defined(MAMA_CC)
+        mama = MK_CC;
+#elif defined(MAMA_CE)
+        mama = MK_CE;
+#elif defined(MAMA_NST)
+        mama = MK_NST;
+#else
+        mama = MK_NSL;
+#endif
+
+#if defined(SOLVER_0)
+        solver = SK_0;
+#elif defined(SOLVER_ED)
+        solver = SK_ED;
+#elif defined(SOLVER_DP)
+        solver = SK_DP;
+#elif defined(SOLVER_FF)
+        solver = SK_FF;
+#elif defined(SOLVER_TD)
+        solver = SK_TD;
+#elif defined(SOLVER_CS)
+        solver = SK_CS;
+#else
+        solver = SK_LF;
+#endif
+
+#ifdef NODE_D_CONV
+        node_d_conv = true;
+#else
+        node_d_conv = false;
+#endif
+        nlf = false;
+        neighbour_rounds = 0;
+#ifdef EDGE_D_CONV
+        edge_d_conv = true;
+#else
+        edge_d_conv = false;
+#endif
+#ifdef REDUCE_EDGES
+        reduce_path_length = PATH_LENGTH;
+#else
+        reduce_path_length = 0;
+#endif
+
+#if defined(FIRST_MATCH_ONLY)
+        match_limit = 1;
+#elif defined(FIRST_100k_MATCHES)
+        match_limit = 100000;
+#else
+        match_limit = 0;
+#endif
+        auto_select = false;
+        probes = 0;
+        symmetry = SY_OFF;
+        backjump = false;
+        forward = false;
+        cache_mb = 0;
+    }
+
+    /*
+     * The numbered configurations of compile.sh and PreprocessorControl.h (1..16).
+     * The match limit, the label and neighbour filters, the probes, the symmetry mode, backjumping, forward checking and the cache are kept, automatic selection is turned off. Returns false for an unknown configuration.
+     */
+    bool set_config(int config) {
+        static const struct {
+            MAMA_KIND mama;
+            SOLVER_KIND solver;
+            bool node_d_conv, edge_d_conv;
+            int reduce_path_length;
+        } configs[16] = {
+            {MK_1, SK_0, false, false, 0},   {MK_1, SK_ED, false, false, 0},  {MK_1, SK_DP, false, false, 0},  {MK_NS, SK_DP, false, false, 0},
+            {MK_NS, SK_DP, false, false, 6}, {MK_NSL, SK_LF, false, false, 0}, {MK_NSL, SK_LF, false, false, 6}, {MK_1, SK_0, true, false, 0},
+            {MK_1, SK_ED, true, false, 0},   {MK_1, SK_DP, true, false, 0},   {MK_NS, SK_DP, true, false, 0},  {MK_1, SK_0, true, false, 6},
+            {MK_NSL, SK_LF, true, false, 0}, {MK_NSL, SK_LF, true, false, 6}, {MK_NS, SK_DP, true, true, 0},  {MK_NSL, SK_LF, true, true, 0},
+        };
+        if (config < 1 || config > 16)
+            return false;
+        mama = configs[config - 1].mama;
+        solver = configs[config - 1].solver;
+        node_d_conv = configs[config - 1].node_d_conv;
+        edge_d_conv = configs[config - 1].edge_d_conv;
+        reduce_path_length = configs[config - 1].reduce_path_length;
+        auto_select = false;
+        return true;
+    }
+};
+
+inline const char *mama_kind_name(MAMA_KIND k) {
+    static const char *names[] = {"1", "0", "fc", "ac", "ns", "nsl", "cc", "ce", "nst"};
+    return names[k];
+};
+
+inline const char *solver_kind_name(SOLVER_KIND k) {
+    static const char *names[] = {"0", "ed", "dp", "lf", "ff", "td", "cs"};
+    return names[k];
+};
+
+inline const char *symmetry_mode_name(SYMMETRY_MODE m) {
+    static const char *names[] = {"off", "emb", "distinct"};
+    return names[m];
+};
+
+inline bool parse_mama_kind(const std::string &name, MAMA_KIND &k) {
+    for (int i = MK_1; i <= MK_NST; i++) {
+        if (name == mama_kind_name((MAMA_KIND)i)) {
+            k = (MAMA_KIND)i;
+            return true;
+        }
+    }
+    return false;
+};
+
+inline bool parse_solver_kind(const std::string &name, SOLVER_KIND &k) {
+    for (int i = SK_0; i <= SK_CS; i++) {
+        if (name == solver_kind_name((SOLVER_KIND)i)) {
+            k = (SOLVER_KIND)i;
+            return true;
+        }
+    }
+    return false;
+};
+
+inline bool parse_symmetry_mode(const std::string &name, SYMMETRY_MODE &m) {
+    for (int i = SY_OFF; i <= SY_DISTINCT; i++) {
+        if (name == symmetry_mode_name((SYMMETRY_MODE)i)) {
+            m = (SYMMETRY_MODE)i;
+            return true;
+        }
+    }
+    return false;
+};
+
+} // namespace rilib
+
+#endif /* STRATEGY_H_ */
@@ -38,9 +38,11 @@ namespace rilib {
 
 class SubGISolver : public Solver {
   public:
-    SubGISolver(MatchingMachine &_mama, Graph &_rgraph, Graph &_qgraph, AttributeComparator &_nodeComparator, AttributeComparator &_edgeComparator, MatchListener &_matchListener, sbitset *_domains, int *_domains_size, EdgeDomains &_edomains) : Solver(_mama, _rgraph, _qgraph, _nodeComparator, _edgeComparator, _matchListener, _domains, _domains_size, _edomains) {}
+    SubGISolver(MatchingMachine &_mama, Graph &_rgraph, Graph &_qgraph, AttributeComparator &_nodeComparator, AttributeComparator &_edgeComparator, MatchListener &_matchListener, sbitset *_domains, int *_domains_size, EdgeDomains &_edomains, Arena *_arena = NULL) : Solver(_mama, _rgraph, _qgraph, _nodeComparator, _edgeComparator, _matchListener, _domains, _domains_size, _edomains, _arena) {}
 
     virtual bool edgesCheck(int si, int ci, int *solution, bool *matched) { return true; }
+
+    virtual bool countsCheck(int ci, int o_edges, int i_edges, bool *matched) { return true; }
 };
 
 } // namespace rilib